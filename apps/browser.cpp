@@ -12,16 +12,39 @@ extern void draw_rounded_rect(int x, int y, int w, int h, uint32_t color);
 extern void draw_char(char c, int x, int y, uint32_t color);
 extern void draw_string(const char* str, int x, int y, uint32_t color);
 extern void* memset(void *s, int c, size_t n);
+extern void* memcpy(void *dest, const void *src, size_t n);
+extern void* memchr(const void *s, int c, size_t n);
+extern void* memmem(const void *haystack, size_t haystack_len, const void *needle, size_t needle_len);
 extern size_t strlen(const char *str);
 extern int strcmp(const char *s1, const char *s2);
 extern int strncmp(const char *s1, const char *s2, size_t n);
 extern char* strcpy(char *dest, const char *src);
 extern char* strcat(char *dest, const char *src);
-extern void refresh_all_windows();
+enum AppID {
+    APP_NONE = 0,
+    APP_TERMINAL = 1,
+    APP_BROWSER = 2,
+    APP_FILEMANAGER = 3
+};
+
+extern void refresh_window(AppID app);
+extern void redraw_window_rect(AppID app, int x, int y, int w, int h);
+extern void invalidate_window_rect(AppID app, int x, int y, int w, int h);
+extern bool scroll_window_rect(AppID app, int x, int y, int w, int h, int dy);
+extern void refresh_region(int x, int y, int w, int h);
+
+struct GfxRect {
+    int x0, y0, x1, y1;
+};
+
+extern GfxRect gfx_clip;
+extern void gfx_set_clip(int x, int y, int w, int h);
 
 extern bool http_get(const char* url, char* title_out, char* content_out);
 extern bool get_network_status();
 
+#define BROWSER_SCROLL_STEP 24
+
 struct BrowserWindow {
     int x, y;
     int w, h;
@@ -36,6 +59,7 @@ char address_bar[128] = "halden.os";
 char page_title[64] = "HaldenOS Browser";
 char page_content[4096] = "";
 int scroll_offset = 0;
+static int browser_content_h = 0;
 bool address_bar_focused = false;
 
 uint32_t hex_to_color(const char* hex) {
@@ -62,57 +86,38 @@ void find_tag_content(const char* html, const char* tag, char* output, int max_l
     strcat(close_tag, tag);
     strcat(close_tag, ">");
     
-    const char* start = html;
-    while(*start) {
-        bool match = true;
-        for(int i = 0; open_tag[i]; i++) {
-            if(start[i] != open_tag[i]) {
-                match = false;
-                break;
-            }
-        }
-        if(match) {
-            while(*start && *start != '>') start++;
-            if(*start == '>') start++;
-            
-            const char* end = start;
-            while(*end) {
-                bool close_match = true;
-                for(int i = 0; close_tag[i]; i++) {
-                    if(end[i] != close_tag[i]) {
-                        close_match = false;
-                        break;
-                    }
-                }
-                if(close_match) {
-                    int len = end - start;
-                    if(len > max_len - 1) len = max_len - 1;
-                    for(int i = 0; i < len; i++) {
-                        output[i] = start[i];
-                    }
-                    output[len] = '\0';
-                    return;
-                }
-                end++;
-            }
-        }
+    output[0] = '\0';
+    const char* html_end = html + strlen(html);
+    size_t open_len = strlen(open_tag);
+    size_t close_len = strlen(close_tag);
+    const char* search = html;
+    while(search < html_end) {
+        const char* open = (const char*)memmem(search, html_end - search, open_tag, open_len);
+        if(!open) return;
+        search = open + 1;
+        const char* start = (const char*)memchr(open, '>', html_end - open);
+        if(!start) return;
         start++;
+
+        const char* end = (const char*)memmem(start, html_end - start, close_tag, close_len);
+        if(!end) continue;
+        int len = end - start;
+        if(len > max_len - 1) len = max_len - 1;
+        memcpy(output, start, len);
+        output[len] = '\0';
+        return;
     }
-    output[0] = '\0';
 }
 
 void find_style_property(const char* styles, const char* prop, char* value, int max_len) {
+    size_t prop_len = strlen(prop);
+    const char* styles_end = styles + strlen(styles);
     const char* p = styles;
-    while(*p) {
-        bool match = true;
-        for(int i = 0; prop[i]; i++) {
-            if(p[i] != prop[i]) {
-                match = false;
-                break;
-            }
-        }
-        if(match && p[strlen(prop)] == ':') {
-            p += strlen(prop) + 1;
+    while(p < styles_end) {
+        p = (const char*)memmem(p, styles_end - p, prop, prop_len);
+        if(!p) break;
+        if(p[prop_len] == ':') {
+            p += prop_len + 1;
             while(*p == ' ') p++;
             
             int i = 0;
@@ -157,10 +162,17 @@ void render_html(const char* html, int x, int y, int max_w, int max_h) {
     
     draw_rect(x, y, max_w, max_h, bg);
     
+    GfxRect saved = gfx_clip;
+    int clip_x0 = x > saved.x0 ? x : saved.x0;
+    int clip_y0 = y > saved.y0 ? y : saved.y0;
+    int clip_x1 = x + max_w < saved.x1 ? x + max_w : saved.x1;
+    int clip_y1 = y + max_h < saved.y1 ? y + max_h : saved.y1;
+    if(clip_x0 >= clip_x1 || clip_y0 >= clip_y1) return;
+    gfx_set_clip(clip_x0, clip_y0, clip_x1 - clip_x0, clip_y1 - clip_y0);
+    
     int cx = x;
     int cy = y - scroll_offset;
     int max_x = x + max_w;
-    int max_y = y + max_h;
     
     const char* p = body;
     bool in_tag = false;
@@ -209,7 +221,7 @@ void render_html(const char* html, int x, int y, int max_w, int max_h) {
                 if(!is_closing) {
                     if(cx > x) { cx = x; cy += 12; }
                     if(strcmp(tag_name, "li") == 0) {
-                        if(cy >= y && cy < max_y) {
+                        if(cy + 8 > clip_y0 && cy < clip_y1) {
                             draw_string("- ", cx, cy, fg);
                         }
                         cx += 16;
@@ -258,7 +270,7 @@ void render_html(const char* html, int x, int y, int max_w, int max_h) {
             continue;
         }
         
-        if(cy >= y && cy < max_y) {
+        if(cy + 14 > clip_y0 && cy - 2 < clip_y1) {
             uint32_t color = fg;
             if(in_h1) color = 0x4A9EFF;
             else if(in_h2) color = 0x6AB4FF;
@@ -280,6 +292,9 @@ void render_html(const char* html, int x, int y, int max_w, int max_h) {
         
         p++;
     }
+    if(cx > x) cy += 12;
+    browser_content_h = cy + scroll_offset - y;
+    gfx_clip = saved;
 }
 
 void init_browser_app() {
@@ -350,7 +365,7 @@ void navigate_to_url() {
     http_get(address_bar, page_title, page_content);
     scroll_offset = 0;
     address_bar_focused = false;
-    refresh_all_windows();
+    refresh_window(APP_BROWSER);
 }
 
 void handle_browser_click(int x, int y) {
@@ -362,15 +377,15 @@ void handle_browser_click(int x, int y) {
     if(y >= wy && y <= wy + 35) {
         if(x >= wx + ww - 70 && x <= wx + ww - 60) {
             browser_win.minimized = true;
-            refresh_all_windows();
+            refresh_window(APP_BROWSER);
             return;
         } else if(x >= wx + ww - 50 && x <= wx + ww - 30) {
             browser_win.maximized = !browser_win.maximized;
-            refresh_all_windows();
+            refresh_window(APP_BROWSER);
             return;
         } else if(x >= wx + ww - 20 && x <= wx + ww - 5) {
             browser_open = false;
-            refresh_all_windows();
+            refresh_window(APP_BROWSER);
             return;
         }
     }
@@ -378,7 +393,7 @@ void handle_browser_click(int x, int y) {
     if(y >= wy + 45 && y <= wy + 75) {
         if(x >= wx + 10 && x <= wx + ww - 100) {
             address_bar_focused = true;
-            refresh_all_windows();
+            refresh_window(APP_BROWSER);
             return;
         } else if(x >= wx + ww - 90 && x <= wx + ww - 10) {
             navigate_to_url();
@@ -387,11 +402,18 @@ void handle_browser_click(int x, int y) {
     } else {
         if(address_bar_focused) {
             address_bar_focused = false;
-            refresh_all_windows();
+            refresh_window(APP_BROWSER);
         }
     }
 }
 
+static void refresh_address_bar() {
+    int x = browser_win.maximized ? 0 : browser_win.x;
+    int y = browser_win.maximized ? 0 : browser_win.y;
+    int w = browser_win.maximized ? (int)fb_width : browser_win.w;
+    redraw_window_rect(APP_BROWSER, x + 10, y + 45, w - 20, 30);
+}
+
 void handle_browser_keyboard(char c) {
     if(!address_bar_focused) return;
     
@@ -400,13 +422,37 @@ void handle_browser_keyboard(char c) {
     if(c == '\b') {
         if(len > 0) {
             address_bar[len - 1] = '\0';
-            refresh_all_windows();
+            refresh_address_bar();
         }
     } else if(c == '\n') {
         navigate_to_url();
     } else if(c >= 32 && c < 127 && len < 126) {
         address_bar[len] = c;
         address_bar[len + 1] = '\0';
-        refresh_all_windows();
+        refresh_address_bar();
+    }
+}
+
+void handle_browser_scroll(int delta) {
+    if(!browser_open || browser_win.minimized) return;
+    int x = browser_win.maximized ? 0 : browser_win.x;
+    int y = browser_win.maximized ? 0 : browser_win.y;
+    int w = browser_win.maximized ? (int)fb_width : browser_win.w;
+    int h = browser_win.maximized ? (int)fb_height - 50 : browser_win.h;
+    int view_x = x + 10, view_y = y + 95, view_w = w - 20, view_h = h - 130;
+    
+    int old_offset = scroll_offset;
+    scroll_offset -= delta * BROWSER_SCROLL_STEP;
+    if(scroll_offset > browser_content_h - view_h) scroll_offset = browser_content_h - view_h;
+    if(scroll_offset < 0) scroll_offset = 0;
+    int dy = old_offset - scroll_offset;
+    if(dy == 0) return;
+    
+    if(dy >= view_h || -dy >= view_h || !scroll_window_rect(APP_BROWSER, view_x, view_y, view_w, view_h, dy)) {
+        refresh_window(APP_BROWSER);
+        return;
     }
-}
\ No newline at end of file
+    int strip_y = dy > 0 ? view_y : view_y + view_h + dy;
+    invalidate_window_rect(APP_BROWSER, view_x, strip_y, view_w, dy > 0 ? dy : -dy);
+    refresh_region(view_x, view_y, view_w, view_h);
+}
@@ -10,14 +10,50 @@ extern void draw_rounded_rect(int x, int y, int w, int h, uint32_t color);
 extern void draw_char(char c, int x, int y, uint32_t color);
 extern void draw_string(const char* str, int x, int y, uint32_t color);
 extern void* memset(void *s, int c, size_t n);
+extern void* memmove(void *dest, const void *src, size_t n);
 extern size_t strlen(const char *str);
 extern int strcmp(const char *s1, const char *s2);
 extern int strncmp(const char *s1, const char *s2, size_t n);
 extern char* strcpy(char *dest, const char *src);
 extern char* strcat(char *dest, const char *src);
-extern void refresh_all_windows();
+enum AppID {
+    APP_NONE = 0,
+    APP_TERMINAL = 1,
+    APP_BROWSER = 2,
+    APP_FILEMANAGER = 3
+};
+
+extern void refresh_window(AppID app);
+extern bool scroll_window_rect(AppID app, int x, int y, int w, int h, int dy);
+extern bool render_window_rect(AppID app, int x, int y, int w, int h);
+extern void refresh_region(int x, int y, int w, int h);
 extern void uint_to_str(uint64_t n, char* buffer);
-extern uint64_t uptime_seconds;
+extern uint64_t timer_uptime_seconds();
+
+struct GfxRect {
+    int x0, y0, x1, y1;
+};
+
+struct GfxSurface {
+    uint32_t* pixels;
+    int width;
+    int height;
+};
+
+extern GfxRect gfx_clip;
+extern void gfx_set_clip(int x, int y, int w, int h);
+extern bool gfx_surface_resize(GfxSurface* surface, int w, int h);
+extern void gfx_surface_free(GfxSurface* surface);
+extern void gfx_begin_surface(GfxSurface* surface, int origin_x, int origin_y);
+extern void gfx_end_surface();
+extern void gfx_blit_surface(const GfxSurface* surface, int x, int y);
+extern void gfx_scroll_rect(int x, int y, int w, int h, int dy);
+
+#define VIEWER_LINE_H 12
+#define VIEWER_TEXT_TOP 74
+#define VIEWER_TEXT_BOTTOM 4
+#define VIEWER_MAX_ROWS 8192
+#define FM_ITEM_H 32
 
 enum FileType {
     FILE_REGULAR = 0,
@@ -62,6 +98,14 @@ char viewer_path[256];
 int viewer_cursor_pos = 0;
 int viewer_scroll = 0;
 
+static GfxSurface viewer_surface = {nullptr, 0, 0};
+static int viewer_dirty_y0 = 0;
+static int viewer_dirty_y1 = 0;
+static int viewer_rows[VIEWER_MAX_ROWS + 1];
+static int viewer_row_count = 0;
+static int viewer_end_x = 0;
+static bool viewer_layout_valid = false;
+
 char navigation_history[32][256];
 int navigation_history_count = 0;
 int navigation_history_pos = -1;
@@ -106,7 +150,7 @@ void navigate_back() {
         navigation_history_pos--;
         strcpy(current_fm_path, navigation_history[navigation_history_pos]);
         load_directory();
-        refresh_all_windows();
+        refresh_window(APP_FILEMANAGER);
     }
 }
 
@@ -115,7 +159,7 @@ void navigate_forward() {
         navigation_history_pos++;
         strcpy(current_fm_path, navigation_history[navigation_history_pos]);
         load_directory();
-        refresh_all_windows();
+        refresh_window(APP_FILEMANAGER);
     }
 }
 
@@ -139,7 +183,7 @@ void navigate_up() {
     
     push_navigation_history(current_fm_path); 
     load_directory();
-    refresh_all_windows();
+    refresh_window(APP_FILEMANAGER);
 }
 
 void init_filemanager_app() {
@@ -249,7 +293,7 @@ void draw_dialog_box(const char* title, const char* message) {
     draw_string(dialog_input, x + 25, y + 95, 0xFFFFFF);
     
     int cursor_x = x + 25 + (int)strlen(dialog_input) * 8;
-    if ((uptime_seconds % 2) == 0) {
+    if ((timer_uptime_seconds() % 2) == 0) {
         draw_rect(cursor_x, y + 93, 2, 14, 0xFFFFFF);
     }
     
@@ -260,12 +304,78 @@ void draw_dialog_box(const char* title, const char* message) {
     draw_string("Cancel", x + 125, y + 140, 0xFFFFFF);
 }
 
-void draw_viewer_window() {
-    int x = 50;
-    int y = 50;
-    int w = fb_width - 100;
-    int h = fb_height - 100;
-    
+static void get_viewer_rect(int* x, int* y, int* w, int* h) {
+    *x = 50;
+    *y = 50;
+    *w = fb_width - 100;
+    *h = fb_height - 100;
+}
+
+static void mark_viewer_dirty(int y0, int y1) {
+    if(viewer_dirty_y0 >= viewer_dirty_y1) {
+        viewer_dirty_y0 = y0;
+        viewer_dirty_y1 = y1;
+        return;
+    }
+    if(y0 < viewer_dirty_y0) viewer_dirty_y0 = y0;
+    if(y1 > viewer_dirty_y1) viewer_dirty_y1 = y1;
+}
+
+static void invalidate_viewer() {
+    viewer_layout_valid = false;
+    mark_viewer_dirty(0, fb_height);
+}
+
+static void layout_viewer(int w) {
+    int cx = 15;
+    int max_x = w - 15;
+    int i = 0;
+    viewer_rows[0] = 0;
+    viewer_row_count = 1;
+    
+    for(; viewer_content[i]; i++) {
+        bool wrap = false;
+        if(viewer_content[i] == '\n') {
+            wrap = true;
+        } else if(viewer_content[i] == '\t') {
+            cx += 32;
+        } else {
+            cx += 8;
+            if(cx >= max_x) wrap = true;
+        }
+        if(wrap) {
+            if(viewer_row_count == VIEWER_MAX_ROWS) break;
+            cx = 15;
+            viewer_rows[viewer_row_count++] = i + 1;
+        }
+    }
+    viewer_rows[viewer_row_count] = i;
+    viewer_end_x = cx;
+    viewer_layout_valid = true;
+}
+
+static void draw_viewer_row(int row, int x, int cy, int max_x) {
+    int cx = x + 15;
+    for(int i = viewer_rows[row]; i < viewer_rows[row + 1]; i++) {
+        char c = viewer_content[i];
+        bool cursor = viewer_editing && i == viewer_cursor_pos;
+        if(c == '\n') {
+            if(cursor) draw_rect(cx, cy, 8, 12, 0x555555);
+            break;
+        }
+        if(c == '\t') {
+            cx += 32;
+            continue;
+        }
+        if(cx < max_x) {
+            if(cursor) draw_rect(cx, cy, 8, 12, 0x555555);
+            draw_char(c, cx, cy, 0xCCCCCC);
+        }
+        cx += 8;
+    }
+}
+
+static void draw_viewer_contents(int x, int y, int w, int h) {
     draw_rect(x, y, w, 40, 0x1a1a2e);
     draw_string(viewer_editing ? "File Editor" : "File Viewer", x + 10, y + 12, 0xFFFFFF);
     
@@ -285,49 +395,118 @@ void draw_viewer_window() {
     draw_string(viewer_title, x + 10, y + 50, 0x4A9EFF);
     draw_rect(x + 10, y + 70, w - 20, 2, 0x444444);
     
-    int cx = x + 15;
-    int cy = y + 80 - (viewer_scroll * 12);
+    GfxRect saved = gfx_clip;
+    int clip_y0 = y + VIEWER_TEXT_TOP > saved.y0 ? y + VIEWER_TEXT_TOP : saved.y0;
+    int clip_y1 = y + h - VIEWER_TEXT_BOTTOM < saved.y1 ? y + h - VIEWER_TEXT_BOTTOM : saved.y1;
+    if(clip_y0 >= clip_y1 || saved.x0 >= saved.x1) return;
+    gfx_set_clip(saved.x0, clip_y0, saved.x1 - saved.x0, clip_y1 - clip_y0);
+    
+    if(!viewer_layout_valid) layout_viewer(w);
+    
     int max_x = x + w - 15;
-    int max_y = y + h - 15;
-    int start_y = y + 80;
+    int text_y = y + 80;
+    int row = viewer_scroll - 1 + (clip_y0 - text_y + VIEWER_LINE_H) / VIEWER_LINE_H;
+    if(row < 0) row = 0;
+    int cy = text_y + (row - viewer_scroll) * VIEWER_LINE_H;
     
-    for(int i = 0; viewer_content[i]; i++) {
-        if(cy > max_y) break;
-        
-        if(cy >= start_y - 12) {
-            if(viewer_content[i] == '\n') {
-                if(viewer_editing && i == viewer_cursor_pos) {
-                     draw_rect(cx, cy, 8, 12, 0x555555);
-                }
-                cx = x + 15;
-                cy += 12;
-            } else if(viewer_content[i] == '\t') {
-                cx += 32;
-            } else {
-                if(cx < max_x) {
-                    if(viewer_editing && i == viewer_cursor_pos) {
-                        draw_rect(cx, cy, 8, 12, 0x555555);
-                    }
-                    draw_char(viewer_content[i], cx, cy, 0xCCCCCC);
-                }
-                cx += 8;
-                if(cx >= max_x) {
-                    cx = x + 15;
-                    cy += 12;
-                }
-            }
-        } else {
-             if(viewer_content[i] == '\n') cy += 12;
-             else if(cx >= max_x) cy += 12;
-             if(viewer_content[i] != '\n') cx += 8;
-        }
+    for(; row < viewer_row_count && cy < clip_y1; row++, cy += VIEWER_LINE_H) {
+        draw_viewer_row(row, x, cy, max_x);
     }
     
     if(viewer_editing && viewer_cursor_pos >= (int)strlen(viewer_content)) {
-        if(cy >= start_y && cy < max_y) {
-            draw_rect(cx, cy, 8, 12, 0x555555);
+        cy = text_y + (viewer_row_count - 1 - viewer_scroll) * VIEWER_LINE_H;
+        draw_rect(x + viewer_end_x, cy, 8, 12, 0x555555);
+    }
+    gfx_clip = saved;
+}
+
+void draw_viewer_window() {
+    int x, y, w, h;
+    get_viewer_rect(&x, &y, &w, &h);
+    
+    bool resized = viewer_surface.width != w || viewer_surface.height != h;
+    if(!gfx_surface_resize(&viewer_surface, w, h)) {
+        draw_viewer_contents(x, y, w, h);
+        return;
+    }
+    if(resized) invalidate_viewer();
+    
+    if(viewer_dirty_y0 < viewer_dirty_y1) {
+        GfxRect saved = gfx_clip;
+        gfx_begin_surface(&viewer_surface, x, y);
+        gfx_set_clip(x, y + viewer_dirty_y0, w, viewer_dirty_y1 - viewer_dirty_y0);
+        draw_viewer_contents(x, y, w, h);
+        gfx_end_surface();
+        gfx_clip = saved;
+        viewer_dirty_y0 = viewer_dirty_y1 = 0;
+    }
+    gfx_blit_surface(&viewer_surface, x, y);
+}
+
+static void scroll_viewer(int delta) {
+    int x, y, w, h;
+    get_viewer_rect(&x, &y, &w, &h);
+    if(!viewer_layout_valid) layout_viewer(w);
+    
+    int old_scroll = viewer_scroll;
+    viewer_scroll -= delta;
+    if(viewer_scroll > viewer_row_count - 1) viewer_scroll = viewer_row_count - 1;
+    if(viewer_scroll < 0) viewer_scroll = 0;
+    int dy = (old_scroll - viewer_scroll) * VIEWER_LINE_H;
+    if(dy == 0) return;
+    
+    int top = VIEWER_TEXT_TOP;
+    int bottom = h - VIEWER_TEXT_BOTTOM;
+    int dist = dy > 0 ? dy : -dy;
+    bool pending = viewer_dirty_y0 < viewer_dirty_y1;
+    
+    if(dist >= bottom - top || !viewer_surface.pixels || viewer_surface.width != w || viewer_surface.height != h ||
+       (pending && (viewer_dirty_y0 < top || viewer_dirty_y1 > bottom))) {
+        mark_viewer_dirty(0, h);
+    } else {
+        gfx_begin_surface(&viewer_surface, x, y);
+        gfx_scroll_rect(x, y + top, w, bottom - top, dy);
+        gfx_end_surface();
+        if(pending) {
+            viewer_dirty_y0 = viewer_dirty_y0 + dy < top ? top : viewer_dirty_y0 + dy;
+            viewer_dirty_y1 = viewer_dirty_y1 + dy > bottom ? bottom : viewer_dirty_y1 + dy;
         }
+        if(dy > 0) mark_viewer_dirty(top, top + dy);
+        else mark_viewer_dirty(bottom + dy, bottom);
+    }
+    refresh_region(x, y + top, w, bottom - top);
+}
+
+static void scroll_file_list(int delta) {
+    int x = fm_win.maximized ? 0 : fm_win.x;
+    int y = fm_win.maximized ? 0 : fm_win.y;
+    int w = fm_win.maximized ? (int)fb_width : fm_win.w;
+    int h = fm_win.maximized ? (int)fb_height - 40 : fm_win.h;
+    int list_y = y + 80;
+    int list_h = h - 85;
+    int visible_items = list_h / FM_ITEM_H;
+    
+    int old_offset = scroll_offset_fm;
+    scroll_offset_fm -= delta;
+    if(scroll_offset_fm >= file_list_count) scroll_offset_fm = file_list_count - 1;
+    if(scroll_offset_fm < 0) scroll_offset_fm = 0;
+    int rows = old_offset - scroll_offset_fm;
+    if(rows == 0) return;
+    
+    int dist = rows > 0 ? rows : -rows;
+    int area_h = visible_items * FM_ITEM_H;
+    int dy = rows * FM_ITEM_H;
+    if(dist >= visible_items || !scroll_window_rect(APP_FILEMANAGER, x, list_y, w - 6, area_h, dy)) {
+        refresh_window(APP_FILEMANAGER);
+        return;
     }
+    int strip_y = dy > 0 ? list_y : list_y + area_h + dy;
+    if(!render_window_rect(APP_FILEMANAGER, x, strip_y, w - 6, dist * FM_ITEM_H) ||
+       !render_window_rect(APP_FILEMANAGER, x + w - 6, list_y, 6, list_h)) {
+        refresh_window(APP_FILEMANAGER);
+        return;
+    }
+    refresh_region(x, list_y, w - 6, area_h);
 }
 
 void draw_filemanager_window() {
@@ -369,7 +548,7 @@ void draw_filemanager_window() {
     
     int list_y = y + 80;
     int list_h = h - 85;
-    int item_h = 32;
+    int item_h = FM_ITEM_H;
     int visible_items = list_h / item_h;
     
     if(file_list_count == 0) {
@@ -379,6 +558,10 @@ void draw_filemanager_window() {
             int file_idx = i + scroll_offset_fm;
             if(file_idx >= file_list_count) break;
             
+            int item_y = list_y + (i * item_h);
+            if(item_y + item_h <= gfx_clip.y0) continue;
+            if(item_y >= gfx_clip.y1) break;
+            
             int idx = file_list_indices[file_idx];
             char name[64], path[256];
             FileType type;
@@ -386,8 +569,6 @@ void draw_filemanager_window() {
             
             if(!get_file_info(idx, name, path, &type, &size)) continue;
             
-            int item_y = list_y + (i * item_h);
-            
             if(file_idx == selected_file) {
                 draw_rect(x + 2, item_y, w - 4, item_h, 0x0f3460);
             }
@@ -422,6 +603,10 @@ void draw_filemanager_window() {
         draw_rect(x + w - 6, list_y, 6, list_h, 0x111111);
         draw_rounded_rect(x + w - 5, sb_y, 4, sb_h, 0x888888);
     }
+}
+
+void draw_filemanager_overlays() {
+    if(fm_win.minimized || !filemanager_open) return;
     
     if(context_menu_type != CTX_NONE) {
         draw_context_menu();
@@ -470,7 +655,7 @@ void open_file_at_index(int list_idx) {
         }
         
         load_directory();
-        refresh_all_windows();
+        refresh_window(APP_FILEMANAGER);
     } else if(type == FILE_REGULAR || type == FILE_SOURCE) {
         if(read_file_content(path, viewer_content, 8192)) {
             strcpy(viewer_title, name);
@@ -479,7 +664,8 @@ void open_file_at_index(int list_idx) {
             viewer_editing = false;
             viewer_cursor_pos = 0;
             viewer_scroll = 0;
-            refresh_all_windows();
+            invalidate_viewer();
+            refresh_window(APP_FILEMANAGER);
         }
     }
 }
@@ -489,22 +675,18 @@ void handle_viewer_keyboard(char c) {
     
     if(c == '\b') {
         if(viewer_cursor_pos > 0) {
-            for(int i = viewer_cursor_pos - 1; i < len; i++) {
-                viewer_content[i] = viewer_content[i + 1];
-            }
+            memmove(viewer_content + viewer_cursor_pos - 1, viewer_content + viewer_cursor_pos, len - viewer_cursor_pos + 1);
             viewer_cursor_pos--;
         }
     } else if(c >= 32 || c == '\n' || c == '\t') {
         if(len < 8190) {
-            for(int i = len; i >= viewer_cursor_pos; i--) {
-                viewer_content[i + 1] = viewer_content[i];
-            }
+            memmove(viewer_content + viewer_cursor_pos + 1, viewer_content + viewer_cursor_pos, len - viewer_cursor_pos + 1);
             viewer_content[viewer_cursor_pos] = c;
             viewer_cursor_pos++;
-            viewer_content[len + 1] = '\0';
         }
     }
-    refresh_all_windows();
+    invalidate_viewer();
+    refresh_window(APP_FILEMANAGER);
 }
 
 void handle_viewer_click(int x, int y) {
@@ -519,11 +701,13 @@ void handle_viewer_click(int x, int y) {
                 viewer_editing = true;
                 viewer_cursor_pos = strlen(viewer_content);
             }
-            refresh_all_windows();
+            invalidate_viewer();
+            refresh_window(APP_FILEMANAGER);
         } else if(x >= vx + vw - 100 && x <= vx + vw - 20) { 
             viewer_open = false;
             viewer_editing = false;
-            refresh_all_windows();
+            gfx_surface_free(&viewer_surface);
+            refresh_window(APP_FILEMANAGER);
         }
     }
 }
@@ -553,7 +737,7 @@ void handle_dialog_keyboard(char c) {
         dialog_input[dialog_input_len++] = c;
         dialog_input[dialog_input_len] = '\0';
     }
-    refresh_all_windows();
+    refresh_window(APP_FILEMANAGER);
 }
 
 void handle_context_menu_click(int x, int y) {
@@ -567,7 +751,7 @@ void handle_context_menu_click(int x, int y) {
     
     if(x < menu_x || x > menu_x + menu_w || y < menu_y || y > menu_y + menu_h) {
         context_menu_type = CTX_NONE;
-        refresh_all_windows();
+        refresh_window(APP_FILEMANAGER);
         return;
     }
     
@@ -597,7 +781,7 @@ void handle_context_menu_click(int x, int y) {
         }
     }
     context_menu_type = CTX_NONE;
-    refresh_all_windows();
+    refresh_window(APP_FILEMANAGER);
 }
 
 void handle_filemanager_click(int x, int y) {
@@ -616,7 +800,7 @@ void handle_filemanager_click(int x, int y) {
                 new_file_dialog = false;
                 new_folder_dialog = false;
                 rename_dialog = false;
-                refresh_all_windows();
+                refresh_window(APP_FILEMANAGER);
             }
         }
         return;
@@ -629,10 +813,10 @@ void handle_filemanager_click(int x, int y) {
             if(x >= dx + 20 && x <= dx + 100) {
                 if(delete_file_from_fs(context_menu_target)) load_directory();
                 delete_confirm = false;
-                refresh_all_windows();
+                refresh_window(APP_FILEMANAGER);
             } else if(x >= dx + 110 && x <= dx + 190) {
                 delete_confirm = false;
-                refresh_all_windows();
+                refresh_window(APP_FILEMANAGER);
             }
         }
         return;
@@ -660,7 +844,7 @@ void handle_filemanager_click(int x, int y) {
             fm_win.drag_offset_x = x - x; 
             fm_win.drag_offset_y = y - y; 
         }
-        refresh_all_windows();
+        refresh_window(APP_FILEMANAGER);
         return;
     }
     
@@ -682,18 +866,18 @@ void handle_filemanager_click(int x, int y) {
         
         if(clicked_data_idx >= 0 && clicked_data_idx < file_list_count) {
             bool is_double_click = false;
-            if(clicked_data_idx == last_clicked_file && (uptime_seconds - last_click_time) <= 1) {
+            if(clicked_data_idx == last_clicked_file && (timer_uptime_seconds() - last_click_time) <= 1) {
                 is_double_click = true;
             }
             
             last_clicked_file = clicked_data_idx;
-            last_click_time = uptime_seconds;
+            last_click_time = timer_uptime_seconds();
             
             if(is_double_click) {
                 open_file_at_index(clicked_data_idx);
             } else {
                 selected_file = clicked_data_idx;
-                refresh_all_windows();
+                refresh_window(APP_FILEMANAGER);
             }
         }
     }
@@ -703,7 +887,7 @@ void handle_filemanager_drag(int x, int y) {
     if(fm_win.dragging && !fm_win.maximized) {
         fm_win.x = x - 20; 
         fm_win.y = y - 10;
-        refresh_all_windows();
+        refresh_window(APP_FILEMANAGER);
     }
 }
 
@@ -716,7 +900,7 @@ void handle_filemanager_rightclick(int x, int y) {
     
     if(context_menu_type != CTX_NONE) {
         context_menu_type = CTX_NONE;
-        refresh_all_windows();
+        refresh_window(APP_FILEMANAGER);
         return;
     }
     
@@ -744,27 +928,22 @@ void handle_filemanager_rightclick(int x, int y) {
                 strcpy(context_menu_target, path);
                 context_menu_target_idx = clicked_idx;
                 selected_file = clicked_idx;
-                refresh_all_windows();
+                refresh_window(APP_FILEMANAGER);
             }
         } else {
             context_menu_type = CTX_EMPTY;
             context_menu_x = x;
             context_menu_y = y;
-            refresh_all_windows();
+            refresh_window(APP_FILEMANAGER);
         }
     }
 }
 
 void handle_filemanager_scroll(int delta) {
     if(viewer_open) {
-        viewer_scroll -= delta;
-        if(viewer_scroll < 0) viewer_scroll = 0;
-        refresh_all_windows();
+        scroll_viewer(delta);
     } else if(filemanager_open && !fm_win.minimized) {
-        scroll_offset_fm -= delta;
-        if(scroll_offset_fm < 0) scroll_offset_fm = 0;
-        if(file_list_count > 0 && scroll_offset_fm >= file_list_count) scroll_offset_fm = file_list_count - 1;
-        refresh_all_windows();
+        scroll_file_list(delta);
     }
 }
 
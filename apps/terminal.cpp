@@ -10,7 +10,14 @@ extern void draw_rounded_rect(int x, int y, int w, int h, uint32_t color);
 extern void draw_string(const char* str, int x, int y, uint32_t color);
 extern void terminal_clear();
 extern void terminal_write(const char* str);
-extern void refresh_all_windows();
+enum AppID {
+    APP_NONE = 0,
+    APP_TERMINAL = 1,
+    APP_BROWSER = 2,
+    APP_FILEMANAGER = 3
+};
+
+extern void refresh_window(AppID app);
 extern char current_directory[64];
 
 struct TerminalWindow {
@@ -74,13 +81,13 @@ void handle_terminal_click(int x, int y) {
     if(y >= wy && y <= wy + 35) {
         if(x >= wx + ww - 70 && x <= wx + ww - 60) {
             term_win.minimized = true;
-            refresh_all_windows();
+            refresh_window(APP_TERMINAL);
         } else if(x >= wx + ww - 50 && x <= wx + ww - 30) {
             term_win.maximized = !term_win.maximized;
-            refresh_all_windows();
+            refresh_window(APP_TERMINAL);
         } else if(x >= wx + ww - 20 && x <= wx + ww - 5) {
             terminal_open = false;
-            refresh_all_windows();
+            refresh_window(APP_TERMINAL);
         }
     }
 }
\ No newline at end of file
@@ -5,10 +5,19 @@ extern void* memcpy(void *dest, const void *src, size_t n);
 extern void* memset(void *s, int c, size_t n);
 extern size_t strlen(const char *str);
 extern int strcmp(const char *s1, const char *s2);
+extern int memcmp(const void *s1, const void *s2, size_t n);
 extern int strncmp(const char *s1, const char *s2, size_t n);
 extern char* strcpy(char *dest, const char *src);
 extern char* strcat(char *dest, const char *src);
-extern uint64_t uptime_seconds;
+extern uint64_t timer_uptime_seconds();
+
+struct KmemCache;
+extern KmemCache* kmem_cache_create(const char* name, uint32_t object_size);
+extern void* kmem_cache_alloc(KmemCache* cache);
+extern void kmem_cache_free(KmemCache* cache, void* obj);
+extern void* kmalloc(size_t size);
+extern void* krealloc(void* ptr, size_t size);
+extern void kfree(void* ptr);
 
 #define MAX_FILES 1024
 #define MAX_PATH 1024
@@ -30,19 +39,19 @@ struct FSNode {
     uint32_t permissions;
     uint64_t created_time;
     uint64_t modified_time;
-    bool in_use;
     int parent_index;
 };
 
-FSNode filesystem[MAX_FILES];
+FSNode* filesystem[MAX_FILES];
 int fs_node_count = 0;
 bool hlfs_enabled = false;
-char content_storage_data[MAX_FILES][MAX_CONTENT_SIZE];
-bool content_storage_used[MAX_FILES];
+KmemCache* fs_node_cache = nullptr;
 
 int find_node_by_path(const char* path) {
+    size_t len = strlen(path) + 1;
+    if(len > MAX_PATH) return -1;
     for(int i = 0; i < fs_node_count; i++) {
-        if(filesystem[i].in_use && strcmp(filesystem[i].path, path) == 0) {
+        if(filesystem[i] && memcmp(filesystem[i]->path, path, len) == 0) {
             return i;
         }
     }
@@ -52,15 +61,18 @@ int find_node_by_path(const char* path) {
 int create_node(const char* path, const char* name, FileType type, const char* content, int parent_idx, int explicit_size = -1) {
     if(fs_node_count >= MAX_FILES) return -1;
     
+    FSNode* node = (FSNode*)kmem_cache_alloc(fs_node_cache);
+    if(!node) return -1;
+
     int idx = fs_node_count++;
-    filesystem[idx].in_use = true;
-    strcpy(filesystem[idx].name, name);
-    strcpy(filesystem[idx].path, path);
-    filesystem[idx].type = type;
-    filesystem[idx].permissions = 0755;
-    filesystem[idx].created_time = uptime_seconds;
-    filesystem[idx].modified_time = uptime_seconds;
-    filesystem[idx].parent_index = parent_idx;
+    filesystem[idx] = node;
+    strcpy(filesystem[idx]->name, name);
+    strcpy(filesystem[idx]->path, path);
+    filesystem[idx]->type = type;
+    filesystem[idx]->permissions = 0755;
+    filesystem[idx]->created_time = timer_uptime_seconds();
+    filesystem[idx]->modified_time = timer_uptime_seconds();
+    filesystem[idx]->parent_index = parent_idx;
     
     if(content && (type == FILE_REGULAR || type == FILE_SOURCE)) {
         int len;
@@ -72,23 +84,29 @@ int create_node(const char* path, const char* name, FileType type, const char* c
 
         if (len > MAX_CONTENT_SIZE) len = MAX_CONTENT_SIZE;
 
-        filesystem[idx].size = len;
-        content_storage_used[idx] = true;
-        memcpy(content_storage_data[idx], content, len);
-        filesystem[idx].content = content_storage_data[idx];
+        filesystem[idx]->size = len;
+        filesystem[idx]->content = (char*)kmalloc(len + 1);
+        if(filesystem[idx]->content) {
+            memcpy(filesystem[idx]->content, content, len);
+            filesystem[idx]->content[len] = '\0';
+        }
     } else {
-        filesystem[idx].size = 4096;
-        filesystem[idx].content = nullptr;
-        content_storage_used[idx] = false;
+        filesystem[idx]->size = 4096;
+        filesystem[idx]->content = nullptr;
     }
     
     return idx;
 }
 
 void init_hlfs() {
+    for(int i = 0; i < fs_node_count; i++) {
+        if(!filesystem[i]) continue;
+        kfree(filesystem[i]->content);
+        kmem_cache_free(fs_node_cache, filesystem[i]);
+    }
     fs_node_count = 0;
     memset(filesystem, 0, sizeof(filesystem));
-    memset(content_storage_used, 0, sizeof(content_storage_used));
+    if(!fs_node_cache) fs_node_cache = kmem_cache_create("fs_node", sizeof(FSNode));
     
     int root = create_node("/", "/", FILE_DIRECTORY, nullptr, -1);
     
@@ -271,27 +289,27 @@ int get_directory_contents(const char* path, int* indices, int max_count) {
     int path_len = strlen(path);
     
     for(int i = 0; i < fs_node_count && count < max_count; i++) {
-        if(!filesystem[i].in_use) continue;
+        if(!filesystem[i]) continue;
         
         if(strcmp(path, "/") == 0) {
             int slash_count = 0;
-            for(int j = 1; filesystem[i].path[j]; j++) {
-                if(filesystem[i].path[j] == '/') slash_count++;
+            for(int j = 1; filesystem[i]->path[j]; j++) {
+                if(filesystem[i]->path[j] == '/') slash_count++;
             }
             if(slash_count == 0 && i != 0) {
                 indices[count++] = i;
             }
         } else {
-            if(strncmp(filesystem[i].path, path, path_len) == 0) {
-                if(filesystem[i].path[path_len] == '/') {
+            if(strncmp(filesystem[i]->path, path, path_len) == 0) {
+                if(filesystem[i]->path[path_len] == '/') {
                     bool direct_child = true;
-                    for(int j = path_len + 1; filesystem[i].path[j]; j++) {
-                        if(filesystem[i].path[j] == '/') {
+                    for(int j = path_len + 1; filesystem[i]->path[j]; j++) {
+                        if(filesystem[i]->path[j] == '/') {
                             direct_child = false;
                             break;
                         }
                     }
-                    if(direct_child && strcmp(filesystem[i].path, path) != 0) {
+                    if(direct_child && strcmp(filesystem[i]->path, path) != 0) {
                         indices[count++] = i;
                     }
                 }
@@ -306,14 +324,14 @@ bool read_file_content(const char* path, char* output, int max_len) {
     int idx = find_node_by_path(path);
     if(idx == -1) return false;
     
-    if(filesystem[idx].type != FILE_REGULAR && filesystem[idx].type != FILE_SOURCE) {
+    if(filesystem[idx]->type != FILE_REGULAR && filesystem[idx]->type != FILE_SOURCE) {
         return false;
     }
     
-    if(filesystem[idx].content) {
-        int len = filesystem[idx].size;
+    if(filesystem[idx]->content) {
+        int len = filesystem[idx]->size;
         if(len > max_len - 1) len = max_len - 1;
-        memcpy(output, filesystem[idx].content, len);
+        memcpy(output, filesystem[idx]->content, len);
         output[len] = '\0';
         return true;
     }
@@ -325,35 +343,34 @@ bool write_file_content(const char* path, const char* content) {
     int idx = find_node_by_path(path);
     if(idx == -1) return false;
     
-    if(filesystem[idx].type != FILE_REGULAR && filesystem[idx].type != FILE_SOURCE) {
+    if(filesystem[idx]->type != FILE_REGULAR && filesystem[idx]->type != FILE_SOURCE) {
         return false;
     }
     
-    if(!filesystem[idx].content) {
-        content_storage_used[idx] = true;
-        filesystem[idx].content = content_storage_data[idx];
-    }
-    
     int len = strlen(content);
     if(len > MAX_CONTENT_SIZE - 1) len = MAX_CONTENT_SIZE - 1;
     
-    memcpy(filesystem[idx].content, content, len);
-    filesystem[idx].content[len] = '\0';
-    filesystem[idx].size = len;
-    filesystem[idx].modified_time = uptime_seconds;
+    char* storage = (char*)krealloc(filesystem[idx]->content, len + 1);
+    if(!storage) return false;
+    filesystem[idx]->content = storage;
+    
+    memcpy(filesystem[idx]->content, content, len);
+    filesystem[idx]->content[len] = '\0';
+    filesystem[idx]->size = len;
+    filesystem[idx]->modified_time = timer_uptime_seconds();
     
     return true;
 }
 
 bool get_file_info(int index, char* name_out, char* path_out, FileType* type_out, uint64_t* size_out) {
-    if(index < 0 || index >= fs_node_count || !filesystem[index].in_use) {
+    if(index < 0 || index >= fs_node_count || !filesystem[index]) {
         return false;
     }
     
-    strcpy(name_out, filesystem[index].name);
-    strcpy(path_out, filesystem[index].path);
-    *type_out = filesystem[index].type;
-    *size_out = filesystem[index].size;
+    strcpy(name_out, filesystem[index]->name);
+    strcpy(path_out, filesystem[index]->path);
+    *type_out = filesystem[index]->type;
+    *size_out = filesystem[index]->size;
     
     return true;
 }
@@ -362,7 +379,7 @@ bool create_file_in_fs(const char* parent_path, const char* name, FileType type)
     int parent_idx = find_node_by_path(parent_path);
     if(parent_idx == -1) return false;
     
-    if(filesystem[parent_idx].type != FILE_DIRECTORY) return false;
+    if(filesystem[parent_idx]->type != FILE_DIRECTORY) return false;
     
     char full_path[MAX_PATH];
     strcpy(full_path, parent_path);
@@ -388,19 +405,17 @@ bool delete_file_from_fs(const char* path) {
     int idx = find_node_by_path(path);
     if(idx == -1 || idx == 0) return false;
     
-    if(filesystem[idx].type == FILE_DIRECTORY) {
+    if(filesystem[idx]->type == FILE_DIRECTORY) {
         for(int i = 0; i < fs_node_count; i++) {
-            if(filesystem[i].in_use && filesystem[i].parent_index == idx) {
+            if(filesystem[i] && filesystem[i]->parent_index == idx) {
                 return false;
             }
         }
     }
     
-    filesystem[idx].in_use = false;
-    if(filesystem[idx].content) {
-        content_storage_used[idx] = false;
-        filesystem[idx].content = nullptr;
-    }
+    kfree(filesystem[idx]->content);
+    kmem_cache_free(fs_node_cache, filesystem[idx]);
+    filesystem[idx] = nullptr;
     
     return true;
 }
@@ -433,9 +448,9 @@ bool rename_file_in_fs(const char* old_path, const char* new_name) {
     
     if(find_node_by_path(new_path) != -1) return false;
     
-    strcpy(filesystem[idx].name, new_name);
-    strcpy(filesystem[idx].path, new_path);
-    filesystem[idx].modified_time = uptime_seconds;
+    strcpy(filesystem[idx]->name, new_name);
+    strcpy(filesystem[idx]->path, new_path);
+    filesystem[idx]->modified_time = timer_uptime_seconds();
     
     return true;
 }
\ No newline at end of file
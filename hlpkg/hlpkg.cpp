@@ -8,7 +8,17 @@ extern int strcmp(const char *s1, const char *s2);
 extern int strncmp(const char *s1, const char *s2, size_t n);
 extern char* strcpy(char *dest, const char *src);
 extern char* strcat(char *dest, const char *src);
-extern uint64_t uptime_seconds;
+extern uint64_t timer_uptime_seconds();
+extern uint64_t pmm_alloc_page();
+extern void pmm_free_page(uint64_t phys);
+extern void* phys_to_virt(uint64_t phys);
+extern uint32_t sched_create_thread(const char* name, void (*entry)(void* arg), void* arg, int affinity);
+extern bool sched_suspend(uint32_t id);
+extern bool sched_resume(uint32_t id);
+extern bool sched_kill(uint32_t id);
+extern void sched_join(uint32_t id);
+extern uint64_t sched_thread_cpu_time(uint32_t id);
+extern void sched_sleep_ns(uint64_t ns);
 
 #define HLPKG_MAGIC 0x484C504B47
 #define HLPKG_VERSION 1
@@ -16,7 +26,10 @@ extern uint64_t uptime_seconds;
 #define MAX_DEPS 16
 #define MAX_NAME_LEN 64
 #define MAX_PATH_LEN 256
-#define MAX_BINARY_SIZE (4 * 1024 * 1024)
+#define IMAGE_PAGE_SIZE 4096
+#define IMAGE_TABLE_ENTRIES 512
+#define HLPKG_MAX_IMAGE_SIZE ((uint64_t)IMAGE_TABLE_ENTRIES * IMAGE_TABLE_ENTRIES * IMAGE_PAGE_SIZE)
+#define HLPKG_HOST_PERIOD_NS 100000000ULL
 
 enum HLPKGStatus {
     PKG_NOT_LOADED = 0,
@@ -60,17 +73,23 @@ struct HLPKGDependency {
     bool required;
 };
 
+struct HLPKGImage {
+    uint64_t size;
+    uint64_t resident_pages;
+    uint64_t directory;
+};
+
 struct HLPKGProcess {
     uint32_t pid;
+    uint32_t tid;
     char name[MAX_NAME_LEN];
     HLPKGStatus status;
-    uint8_t* binary_data;
+    HLPKGImage* image;
     uint32_t binary_size;
-    uint8_t* data_section;
+    uint32_t data_offset;
     uint32_t data_size;
     uint32_t permissions;
     uint64_t start_time;
-    uint64_t cpu_time;
     uint32_t memory_usage;
     bool in_use;
 };
@@ -78,8 +97,8 @@ struct HLPKGProcess {
 struct HLPKGPackage {
     HLPKGHeader header;
     HLPKGDependency dependencies[MAX_DEPS];
-    uint8_t* binary_data;
-    uint8_t* data_section;
+    HLPKGImage image;
+    uint32_t data_offset;
     bool loaded;
     char install_path[MAX_PATH_LEN];
 };
@@ -91,8 +110,111 @@ HLPKGProcess processes[MAX_PACKAGES];
 int process_count = 0;
 uint32_t next_pid = 1000;
 
-uint8_t binary_storage[MAX_PACKAGES][MAX_BINARY_SIZE];
-bool binary_storage_used[MAX_PACKAGES];
+static uint8_t* image_page(HLPKGImage* image, uint64_t page_index, bool create) {
+    uint64_t dir_index = page_index / IMAGE_TABLE_ENTRIES;
+    uint64_t table_index = page_index % IMAGE_TABLE_ENTRIES;
+    if(dir_index >= IMAGE_TABLE_ENTRIES) return nullptr;
+
+    if(!image->directory) {
+        if(!create) return nullptr;
+        image->directory = pmm_alloc_page();
+        if(!image->directory) return nullptr;
+        memset(phys_to_virt(image->directory), 0, IMAGE_PAGE_SIZE);
+    }
+
+    uint64_t* directory = (uint64_t*)phys_to_virt(image->directory);
+    if(!directory[dir_index]) {
+        if(!create) return nullptr;
+        directory[dir_index] = pmm_alloc_page();
+        if(!directory[dir_index]) return nullptr;
+        memset(phys_to_virt(directory[dir_index]), 0, IMAGE_PAGE_SIZE);
+    }
+
+    uint64_t* table = (uint64_t*)phys_to_virt(directory[dir_index]);
+    if(!table[table_index]) {
+        if(!create) return nullptr;
+        table[table_index] = pmm_alloc_page();
+        if(!table[table_index]) return nullptr;
+        memset(phys_to_virt(table[table_index]), 0, IMAGE_PAGE_SIZE);
+        image->resident_pages++;
+    }
+
+    return (uint8_t*)phys_to_virt(table[table_index]);
+}
+
+bool hlpkg_image_write(HLPKGImage* image, uint64_t offset, const void* src, uint64_t len) {
+    if(offset + len > image->size) return false;
+    const uint8_t* in = (const uint8_t*)src;
+    while(len > 0) {
+        uint64_t page_offset = offset % IMAGE_PAGE_SIZE;
+        uint64_t chunk = IMAGE_PAGE_SIZE - page_offset;
+        if(chunk > len) chunk = len;
+        uint8_t* page = image_page(image, offset / IMAGE_PAGE_SIZE, true);
+        if(!page) return false;
+        memcpy(page + page_offset, in, chunk);
+        in += chunk;
+        offset += chunk;
+        len -= chunk;
+    }
+    return true;
+}
+
+bool hlpkg_image_fill(HLPKGImage* image, uint64_t offset, uint8_t value, uint64_t len) {
+    if(offset + len > image->size) return false;
+    while(len > 0) {
+        uint64_t page_offset = offset % IMAGE_PAGE_SIZE;
+        uint64_t chunk = IMAGE_PAGE_SIZE - page_offset;
+        if(chunk > len) chunk = len;
+        uint8_t* page = image_page(image, offset / IMAGE_PAGE_SIZE, value != 0);
+        if(page) {
+            memset(page + page_offset, value, chunk);
+        } else if(value != 0) {
+            return false;
+        }
+        offset += chunk;
+        len -= chunk;
+    }
+    return true;
+}
+
+uint64_t hlpkg_image_read(HLPKGImage* image, uint64_t offset, void* dst, uint64_t len) {
+    if(offset >= image->size) return 0;
+    if(len > image->size - offset) len = image->size - offset;
+    uint8_t* out = (uint8_t*)dst;
+    uint64_t done = 0;
+    while(done < len) {
+        uint64_t page_offset = offset % IMAGE_PAGE_SIZE;
+        uint64_t chunk = IMAGE_PAGE_SIZE - page_offset;
+        if(chunk > len - done) chunk = len - done;
+        uint8_t* page = image_page(image, offset / IMAGE_PAGE_SIZE, false);
+        if(page) {
+            memcpy(out + done, page + page_offset, chunk);
+        } else {
+            memset(out + done, 0, chunk);
+        }
+        offset += chunk;
+        done += chunk;
+    }
+    return len;
+}
+
+void hlpkg_image_release(HLPKGImage* image) {
+    if(image->directory) {
+        uint64_t* directory = (uint64_t*)phys_to_virt(image->directory);
+        for(int i = 0; i < IMAGE_TABLE_ENTRIES; i++) {
+            if(!directory[i]) continue;
+            uint64_t* table = (uint64_t*)phys_to_virt(directory[i]);
+            for(int j = 0; j < IMAGE_TABLE_ENTRIES; j++) {
+                if(table[j]) pmm_free_page(table[j]);
+            }
+            pmm_free_page(directory[i]);
+        }
+        pmm_free_page(image->directory);
+    }
+    image->directory = 0;
+    image->resident_pages = 0;
+    image->size = 0;
+}
 
 uint32_t calculate_checksum(const uint8_t* data, uint32_t size) {
     uint32_t checksum = 0;
@@ -132,15 +254,6 @@ bool check_dependencies(const HLPKGPackage* pkg) {
 int hlpkg_load(const char* path) {
     if(package_count >= MAX_PACKAGES) return -1;
     
-    int storage_idx = -1;
-    for(int i = 0; i < MAX_PACKAGES; i++) {
-        if(!binary_storage_used[i]) {
-            storage_idx = i;
-            break;
-        }
-    }
-    if(storage_idx == -1) return -1;
-    
     HLPKGPackage* pkg = &packages[package_count];
     memset(pkg, 0, sizeof(HLPKGPackage));
     
@@ -155,7 +268,7 @@ int hlpkg_load(const char* path) {
     strcpy(pkg->header.package_name, "sample_app");
     strcpy(pkg->header.package_version, "1.0.0");
     strcpy(pkg->header.author, "Halden Dev");
-    pkg->header.build_timestamp = uptime_seconds;
+    pkg->header.build_timestamp = timer_uptime_seconds();
     pkg->header.checksum = calculate_checksum((uint8_t*)&pkg->header, 
         sizeof(HLPKGHeader) - sizeof(uint32_t));
     
@@ -163,15 +276,17 @@ int hlpkg_load(const char* path) {
     if(pkg->header.version != HLPKG_VERSION) return -1;
     if(!verify_signature(pkg->header.signature, &pkg->header)) return -1;
     
-    binary_storage_used[storage_idx] = true;
-    pkg->binary_data = binary_storage[storage_idx];
-    pkg->data_section = pkg->binary_data + pkg->header.binary_size;
+    uint64_t image_size = (uint64_t)pkg->header.binary_size + pkg->header.data_size;
+    if(image_size > HLPKG_MAX_IMAGE_SIZE) return -1;
+    
+    pkg->image.size = image_size;
+    pkg->data_offset = pkg->header.binary_size;
     
-    memset(pkg->binary_data, 0x90, pkg->header.binary_size);
-    memset(pkg->data_section, 0, pkg->header.data_size);
+    if(!check_dependencies(pkg)) return -1;
     
-    if(!check_dependencies(pkg)) {
-        binary_storage_used[storage_idx] = false;
+    if(!hlpkg_image_fill(&pkg->image, 0, 0x90, pkg->header.binary_size) ||
+       !hlpkg_image_fill(&pkg->image, pkg->data_offset, 0, pkg->header.data_size)) {
+        hlpkg_image_release(&pkg->image);
         return -1;
     }
     
@@ -181,6 +296,17 @@ int hlpkg_load(const char* path) {
     return package_count++;
 }
 
+static void hlpkg_process_main(void*) {
+    while(true) sched_sleep_ns(HLPKG_HOST_PERIOD_NS);
+}
+
+static void hlpkg_stop_process(HLPKGProcess* proc) {
+    if(sched_kill(proc->tid)) sched_join(proc->tid);
+    proc->status = PKG_NOT_LOADED;
+    proc->image = nullptr;
+    proc->in_use = false;
+}
+
 int hlpkg_execute(int package_id) {
     if(package_id < 0 || package_id >= package_count) return -1;
     if(!packages[package_id].loaded) return -1;
@@ -200,14 +326,15 @@ int hlpkg_execute(int package_id) {
     proc->pid = next_pid++;
     strcpy(proc->name, packages[package_id].header.package_name);
     proc->status = PKG_RUNNING;
-    proc->binary_data = packages[package_id].binary_data;
+    proc->image = &packages[package_id].image;
     proc->binary_size = packages[package_id].header.binary_size;
-    proc->data_section = packages[package_id].data_section;
+    proc->data_offset = packages[package_id].data_offset;
     proc->data_size = packages[package_id].header.data_size;
     proc->permissions = packages[package_id].header.permissions;
-    proc->start_time = uptime_seconds;
-    proc->cpu_time = 0;
-    proc->memory_usage = proc->binary_size + proc->data_size;
+    proc->start_time = timer_uptime_seconds();
+    proc->memory_usage = proc->image->resident_pages * IMAGE_PAGE_SIZE;
+    proc->tid = sched_create_thread(proc->name, hlpkg_process_main, proc, -1);
+    if(!proc->tid) return -1;
     proc->in_use = true;
     
     if(proc_idx >= process_count) process_count = proc_idx + 1;
@@ -218,8 +345,7 @@ int hlpkg_execute(int package_id) {
 bool hlpkg_kill(uint32_t pid) {
     for(int i = 0; i < process_count; i++) {
         if(processes[i].in_use && processes[i].pid == pid) {
-            processes[i].status = PKG_NOT_LOADED;
-            processes[i].in_use = false;
+            hlpkg_stop_process(&processes[i]);
             return true;
         }
     }
@@ -229,7 +355,7 @@ bool hlpkg_kill(uint32_t pid) {
 bool hlpkg_suspend(uint32_t pid) {
     for(int i = 0; i < process_count; i++) {
         if(processes[i].in_use && processes[i].pid == pid) {
-            if(processes[i].status == PKG_RUNNING) {
+            if(processes[i].status == PKG_RUNNING && sched_suspend(processes[i].tid)) {
                 processes[i].status = PKG_SUSPENDED;
                 return true;
             }
@@ -241,7 +367,7 @@ bool hlpkg_suspend(uint32_t pid) {
 bool hlpkg_resume(uint32_t pid) {
     for(int i = 0; i < process_count; i++) {
         if(processes[i].in_use && processes[i].pid == pid) {
-            if(processes[i].status == PKG_SUSPENDED) {
+            if(processes[i].status == PKG_SUSPENDED && sched_resume(processes[i].tid)) {
                 processes[i].status = PKG_RUNNING;
                 return true;
             }
@@ -276,7 +402,7 @@ bool hlpkg_get_process_info(uint32_t pid, char* name_out, HLPKGStatus* status_ou
             strcpy(name_out, processes[i].name);
             *status_out = processes[i].status;
             *mem_out = processes[i].memory_usage;
-            *time_out = processes[i].cpu_time;
+            *time_out = sched_thread_cpu_time(processes[i].tid);
             return true;
         }
     }
@@ -304,34 +430,18 @@ void hlpkg_unload(int package_id) {
     for(int i = 0; i < process_count; i++) {
         if(processes[i].in_use && 
            strcmp(processes[i].name, packages[package_id].header.package_name) == 0) {
-            processes[i].in_use = false;
-        }
-    }
-    
-    for(int i = 0; i < MAX_PACKAGES; i++) {
-        if(packages[package_id].binary_data == binary_storage[i]) {
-            binary_storage_used[i] = false;
-            break;
+            hlpkg_stop_process(&processes[i]);
         }
     }
     
+    hlpkg_image_release(&packages[package_id].image);
     packages[package_id].loaded = false;
-    packages[package_id].binary_data = nullptr;
-    packages[package_id].data_section = nullptr;
-}
-
-void hlpkg_tick() {
-    for(int i = 0; i < process_count; i++) {
-        if(processes[i].in_use && processes[i].status == PKG_RUNNING) {
-            processes[i].cpu_time++;
-        }
-    }
+    packages[package_id].data_offset = 0;
 }
 
 void init_hlpkg_system() {
     memset(packages, 0, sizeof(packages));
     memset(processes, 0, sizeof(processes));
-    memset(binary_storage_used, 0, sizeof(binary_storage_used));
     package_count = 0;
     process_count = 0;
     next_pid = 1000;
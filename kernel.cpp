@@ -5,12 +5,10 @@
 extern void terminal_init();
 extern void terminal_clear();
 extern void terminal_write(const char* str);
-extern void terminal_redraw();
 extern void process_command(const char* cmd);
 extern void mouse_handler();
 extern void mouse_init();
-extern void draw_taskbar();
-extern void draw_cursor(int x, int y);
+extern void refresh_all_windows();
 extern void draw_modern_boot_menu();
 extern void draw_boot_screen();
 extern void update_boot_progress(int progress);
@@ -21,7 +19,41 @@ extern void network_init();
 extern void init_hlfs();
 extern void init_hlpkg_system();
 extern void init_port_system();
-extern void hlpkg_tick();
+extern bool pmm_init(struct limine_memmap_response* memmap);
+extern uint64_t pmm_total_page_count;
+extern bool heap_init();
+extern void interrupts_init();
+extern void interrupts_enable();
+extern void smp_init_bsp();
+extern bool fpu_init();
+extern void mem_init();
+extern void pixel_init();
+extern void gfx_init_early();
+extern bool gfx_init();
+extern void gfx_raster_init();
+extern void gfx_clear(uint32_t color);
+extern void gfx_flush();
+extern bool sched_init();
+extern void smp_init(struct limine_smp_response* smp);
+extern volatile uint32_t smp_online_count;
+extern void timer_record_boot();
+extern void serial_init();
+extern void bootlog_start();
+extern void bootlog_begin(const char* name);
+extern void bootlog_end();
+extern void bootlog_finish();
+extern void bootlog_wait_begin();
+extern void bootlog_wait_end();
+extern bool timer_init();
+extern bool acpi_init(void* rsdp_address);
+extern void ioapic_init();
+extern void input_init();
+extern void input_discard_mouse();
+extern void input_wait();
+extern void input_wait_ns(uint64_t timeout_ns);
+extern bool compositor_frame();
+extern uint64_t compositor_wait_ns();
+extern bool vmm_init(struct limine_memmap_response* memmap, uint64_t kernel_phys, uint64_t kernel_virt);
 
 static volatile struct limine_framebuffer_request framebuffer_request = {
     .id = LIMINE_FRAMEBUFFER_REQUEST,
@@ -35,6 +67,24 @@ static volatile struct limine_memmap_request memmap_request = {
     .response = NULL
 };
 
+static volatile struct limine_hhdm_request hhdm_request = {
+    .id = LIMINE_HHDM_REQUEST,
+    .revision = 0,
+    .response = NULL
+};
+
+static volatile struct limine_kernel_address_request kernel_address_request = {
+    .id = LIMINE_KERNEL_ADDRESS_REQUEST,
+    .revision = 0,
+    .response = NULL
+};
+
+static volatile struct limine_rsdp_request rsdp_request = {
+    .id = LIMINE_RSDP_REQUEST,
+    .revision = 0,
+    .response = NULL
+};
+
 static volatile struct limine_smp_request smp_request = {
     .id = LIMINE_SMP_REQUEST,
     .revision = 0,
@@ -46,12 +96,12 @@ uint32_t* fb_ptr = 0;
 uint64_t fb_width = 0;
 uint64_t fb_height = 0;
 uint64_t fb_pitch = 0;
+uint64_t hhdm_offset = 0;
 
 uint32_t cpu_core_count = 0;
 uint64_t total_memory_kb = 0;
 uint64_t free_memory_kb = 0;
 uint64_t usable_memory_kb = 0;
-uint64_t uptime_seconds = 0;
 char cpu_brand_string[64];
 
 bool in_gui_mode = false;
@@ -60,6 +110,19 @@ bool boot_menu_active = true;
 int mouse_x = 400;
 int mouse_y = 300;
 
+struct BootService {
+    const char* name;
+    void (*init)();
+};
+
+static const BootService boot_services[] = {
+    {"network_init", network_init},
+    {"init_hlpkg_system", init_hlpkg_system},
+    {"init_port_system", init_port_system},
+    {"gfx_raster_init", gfx_raster_init},
+    {"init_application_system", init_application_system}
+};
+
 void get_cpu_brand_string() {
     uint32_t eax, ebx, ecx, edx;
     uint32_t* desc = (uint32_t*)cpu_brand_string;
@@ -94,7 +157,11 @@ void get_cpu_brand_string() {
     }
 }
 
-extern "C" void _start(void) {
+extern "C" __attribute__((force_align_arg_pointer)) void _start(void) {
+    timer_record_boot();
+    bootlog_start();
+    serial_init();
+
     if (framebuffer_request.response == NULL || framebuffer_request.response->framebuffer_count < 1) {
         for(;;);
     }
@@ -104,6 +171,22 @@ extern "C" void _start(void) {
     fb_width = fb->width;
     fb_height = fb->height;
     fb_pitch = fb->pitch;
+    gfx_init_early();
+
+    bootlog_begin("interrupts_init");
+    interrupts_init();
+    smp_init_bsp();
+    bootlog_end();
+
+    bootlog_begin("fpu_init");
+    fpu_init();
+    mem_init();
+    pixel_init();
+    bootlog_end();
+
+    if(hhdm_request.response != NULL) {
+        hhdm_offset = hhdm_request.response->offset;
+    }
 
     if(memmap_request.response != NULL) {
         struct limine_memmap_response *memmap = memmap_request.response;
@@ -115,10 +198,26 @@ extern "C" void _start(void) {
                 usable_memory_kb += memmap->entries[i]->length / 1024;
             }
         }
+        bootlog_begin("pmm_init");
+        bool pmm_ready = hhdm_request.response != NULL && pmm_init(memmap);
+        bootlog_end();
+        if(pmm_ready) {
+            total_memory_kb = pmm_total_page_count * 4;
+            if(kernel_address_request.response != NULL) {
+                bootlog_begin("vmm_init");
+                vmm_init(memmap, kernel_address_request.response->physical_base,
+                         kernel_address_request.response->virtual_base);
+                bootlog_end();
+            }
+            bootlog_begin("heap_init");
+            heap_init();
+            bootlog_end();
+            bootlog_begin("gfx_init");
+            gfx_init();
+            bootlog_end();
+        }
         if(total_memory_kb == 0) total_memory_kb = usable_memory_kb;
         if(total_memory_kb == 0) total_memory_kb = 2097152;
-        free_memory_kb = usable_memory_kb * 83 / 100;
-        if(free_memory_kb == 0) free_memory_kb = total_memory_kb * 83 / 100;
     }
     
     if(smp_request.response != NULL) {
@@ -127,56 +226,75 @@ extern "C" void _start(void) {
     
     if(cpu_core_count == 0) cpu_core_count = 1;
 
+    bootlog_begin("acpi_init");
+    if(rsdp_request.response != NULL) {
+        acpi_init(rsdp_request.response->address);
+    }
+    ioapic_init();
+    bootlog_end();
+    bootlog_begin("timer_init");
+    timer_init();
+    interrupts_enable();
+    bootlog_end();
+    bootlog_begin("sched_init");
+    sched_init();
+    bootlog_end();
+    bootlog_begin("smp_init");
+    smp_init(smp_request.response);
+    if(smp_online_count > 1) cpu_core_count = smp_online_count;
+    bootlog_end();
+
     get_cpu_brand_string();
     terminal_init();
+    bootlog_begin("input_init");
     mouse_init();
-    network_init();
+    input_init();
+    bootlog_end();
+    bootlog_begin("init_hlfs");
     init_hlfs();
-    init_hlpkg_system();
-    init_port_system();
+    bootlog_end();
     
-    for(uint64_t i = 0; i < fb_width * fb_height; i++) fb_ptr[i] = 0x0f0f1e;
+    gfx_clear(0x0f0f1e);
     
+    bootlog_begin("boot_menu");
     draw_modern_boot_menu();
+    bootlog_end();
     
+    bootlog_wait_begin();
     while(boot_menu_active) {
         if(check_boot_menu_input()) {
             break;
         }
-        for(volatile int d = 0; d < 100000; d++);
+        gfx_flush();
+        input_wait();
     }
+    bootlog_wait_end();
     
     draw_boot_screen();
-    for(int progress = 0; progress <= 100; progress += 2) {
-        update_boot_progress(progress);
-        for(volatile int d = 0; d < 500000; d++);
+    int service_count = sizeof(boot_services) / sizeof(boot_services[0]);
+    update_boot_progress(0);
+    gfx_flush();
+    for(int i = 0; i < service_count; i++) {
+        bootlog_begin(boot_services[i].name);
+        boot_services[i].init();
+        bootlog_end();
+        update_boot_progress((i + 1) * 100 / service_count);
+        gfx_flush();
     }
     
-    for(volatile int d = 0; d < 2000000; d++);
-    
     in_gui_mode = true;
     boot_complete = true;
-    init_application_system();
     
-    for(uint64_t i = 0; i < fb_width * fb_height; i++) fb_ptr[i] = 0x0f0f1e;
-    draw_taskbar();
-    draw_cursor(mouse_x, mouse_y);
+    refresh_all_windows();
+    compositor_frame();
+    gfx_flush();
+    input_discard_mouse();
+    bootlog_finish();
 
-    uint64_t tick_counter = 0;
     while (1) {
         mouse_handler();
-        
-        if(++tick_counter > 100000) {
-            uptime_seconds++;
-            tick_counter = 0;
-            free_memory_kb = total_memory_kb * 83 / 100 - (uptime_seconds % 100) * 10;
-            if(free_memory_kb < total_memory_kb / 4) {
-                free_memory_kb = total_memory_kb * 83 / 100;
-            }
-            
-            hlpkg_tick();
-        }
-        
-        for(volatile int i=0; i<10000; i++); 
+        compositor_frame();
+        gfx_flush();
+        input_wait_ns(compositor_wait_ns());
     }
 }
\ No newline at end of file
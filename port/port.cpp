@@ -8,11 +8,18 @@ extern int strcmp(const char *s1, const char *s2);
 extern int strncmp(const char *s1, const char *s2, size_t n);
 extern char* strcpy(char *dest, const char *src);
 extern char* strcat(char *dest, const char *src);
+extern uint32_t sched_create_thread(const char* name, void (*entry)(void* arg), void* arg, int affinity);
+extern bool sched_suspend(uint32_t id);
+extern bool sched_resume(uint32_t id);
+extern bool sched_kill(uint32_t id);
+extern uint64_t sched_thread_cpu_time(uint32_t id);
+extern void sched_sleep_ns(uint64_t ns);
 
 #define ELF_MAGIC 0x464C457F
 #define MAX_PORTS 32
 #define MAX_SYSCALLS 512
 #define MAX_LIBS 64
+#define PORT_HOST_PERIOD_NS 100000000ULL
 
 enum PortStatus {
     PORT_INACTIVE = 0,
@@ -95,6 +102,7 @@ struct LinuxPath {
 
 struct PortedProcess {
     uint32_t pid;
+    uint32_t tid;
     char name[64];
     PortStatus status;
     ELFHeader elf_header;
@@ -276,6 +284,10 @@ const char* map_library(const char* linux_lib) {
     return nullptr;
 }
 
+static void port_process_main(void*) {
+    while(true) sched_sleep_ns(PORT_HOST_PERIOD_NS);
+}
+
 int port_load_elf(const char* path) {
     if(ported_count >= MAX_PORTS) return -1;
     
@@ -307,13 +319,16 @@ int port_load_elf(const char* path) {
     proc->entry_point = proc->elf_header.entry_point;
     proc->base_address = 0x400000;
     proc->memory_size = 0x100000;
-    proc->in_use = true;
     
     for(int i = 0; i < default_path_count && i < 16; i++) {
         proc->path_mappings[i] = default_paths[i];
     }
     proc->path_count = default_path_count < 16 ? default_path_count : 16;
     
+    proc->tid = sched_create_thread(proc->name, port_process_main, proc, -1);
+    if(!proc->tid) return -1;
+    proc->in_use = true;
+    
     if(proc_idx >= ported_count) ported_count = proc_idx + 1;
     
     return proc->pid;
@@ -333,6 +348,7 @@ uint64_t port_handle_syscall(uint32_t pid, uint64_t syscall_num,
 bool port_kill(uint32_t pid) {
     for(int i = 0; i < ported_count; i++) {
         if(ported_processes[i].in_use && ported_processes[i].pid == pid) {
+            sched_kill(ported_processes[i].tid);
             ported_processes[i].status = PORT_INACTIVE;
             ported_processes[i].in_use = false;
             return true;
@@ -344,7 +360,7 @@ bool port_kill(uint32_t pid) {
 bool port_suspend(uint32_t pid) {
     for(int i = 0; i < ported_count; i++) {
         if(ported_processes[i].in_use && ported_processes[i].pid == pid) {
-            if(ported_processes[i].status == PORT_ACTIVE) {
+            if(ported_processes[i].status == PORT_ACTIVE && sched_suspend(ported_processes[i].tid)) {
                 ported_processes[i].status = PORT_SUSPENDED;
                 return true;
             }
@@ -356,7 +372,7 @@ bool port_suspend(uint32_t pid) {
 bool port_resume(uint32_t pid) {
     for(int i = 0; i < ported_count; i++) {
         if(ported_processes[i].in_use && ported_processes[i].pid == pid) {
-            if(ported_processes[i].status == PORT_SUSPENDED) {
+            if(ported_processes[i].status == PORT_SUSPENDED && sched_resume(ported_processes[i].tid)) {
                 ported_processes[i].status = PORT_ACTIVE;
                 return true;
             }
@@ -376,12 +392,13 @@ int port_get_process_list(uint32_t* pid_list, int max_count) {
 }
 
 bool port_get_process_info(uint32_t pid, char* name_out, PortStatus* status_out, 
-                           uint32_t* mem_out) {
+                           uint32_t* mem_out, uint64_t* time_out) {
     for(int i = 0; i < ported_count; i++) {
         if(ported_processes[i].in_use && ported_processes[i].pid == pid) {
             strcpy(name_out, ported_processes[i].name);
             *status_out = ported_processes[i].status;
             *mem_out = ported_processes[i].memory_size;
+            *time_out = sched_thread_cpu_time(ported_processes[i].tid);
             return true;
         }
     }
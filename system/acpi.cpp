@@ -0,0 +1,155 @@
+#include <stdint.h>
+#include <stddef.h>
+
+extern int strncmp(const char *s1, const char *s2, size_t n);
+extern uint64_t hhdm_offset;
+
+#define MAX_IOAPICS 8
+#define MAX_ACPI_CPUS 256
+#define ISA_IRQ_COUNT 16
+
+#define MADT_LAPIC 0
+#define MADT_IOAPIC 1
+#define MADT_ISO 2
+#define MADT_LAPIC_OVERRIDE 5
+
+struct __attribute__((packed)) RSDP {
+    char signature[8];
+    uint8_t checksum;
+    char oem_id[6];
+    uint8_t revision;
+    uint32_t rsdt_address;
+    uint32_t length;
+    uint64_t xsdt_address;
+    uint8_t extended_checksum;
+    uint8_t reserved[3];
+};
+
+struct __attribute__((packed)) SDTHeader {
+    char signature[4];
+    uint32_t length;
+    uint8_t revision;
+    uint8_t checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+};
+
+struct __attribute__((packed)) MADT {
+    SDTHeader header;
+    uint32_t lapic_address;
+    uint32_t flags;
+};
+
+struct IOAPICInfo {
+    uint8_t id;
+    uint32_t address;
+    uint32_t gsi_base;
+};
+
+struct ISAOverride {
+    uint32_t gsi;
+    uint16_t flags;
+};
+
+IOAPICInfo acpi_ioapics[MAX_IOAPICS];
+int acpi_ioapic_count = 0;
+ISAOverride acpi_isa_overrides[ISA_IRQ_COUNT];
+uint8_t acpi_cpu_apic_ids[MAX_ACPI_CPUS];
+int acpi_cpu_count = 0;
+uint64_t acpi_lapic_address = 0;
+
+static SDTHeader* root_table = nullptr;
+static bool root_is_xsdt = false;
+
+static void* acpi_phys(uint64_t phys) {
+    return (void*)(hhdm_offset + phys);
+}
+
+static bool checksum_ok(const void* table, uint32_t length) {
+    const uint8_t* bytes = (const uint8_t*)table;
+    uint8_t sum = 0;
+    for(uint32_t i = 0; i < length; i++) sum += bytes[i];
+    return sum == 0;
+}
+
+void* acpi_find_table(const char* signature) {
+    if(!root_table) return nullptr;
+
+    uint32_t entry_size = root_is_xsdt ? 8 : 4;
+    uint32_t count = (root_table->length - sizeof(SDTHeader)) / entry_size;
+    uint8_t* entries = (uint8_t*)root_table + sizeof(SDTHeader);
+
+    for(uint32_t i = 0; i < count; i++) {
+        uint64_t phys = root_is_xsdt ? *(uint64_t*)(entries + i * 8) : *(uint32_t*)(entries + i * 4);
+        SDTHeader* header = (SDTHeader*)acpi_phys(phys);
+        if(strncmp(header->signature, signature, 4) == 0 && checksum_ok(header, header->length)) {
+            return header;
+        }
+    }
+    return nullptr;
+}
+
+static void parse_madt(MADT* madt) {
+    acpi_lapic_address = madt->lapic_address;
+
+    uint8_t* entry = (uint8_t*)madt + sizeof(MADT);
+    uint8_t* end = (uint8_t*)madt + madt->header.length;
+    while(entry + 2 <= end && entry[1] >= 2) {
+        uint8_t type = entry[0];
+        if(type == MADT_LAPIC) {
+            uint32_t flags = *(uint32_t*)(entry + 4);
+            if((flags & 0x3) && acpi_cpu_count < MAX_ACPI_CPUS) {
+                acpi_cpu_apic_ids[acpi_cpu_count++] = entry[3];
+            }
+        } else if(type == MADT_IOAPIC && acpi_ioapic_count < MAX_IOAPICS) {
+            acpi_ioapics[acpi_ioapic_count].id = entry[2];
+            acpi_ioapics[acpi_ioapic_count].address = *(uint32_t*)(entry + 4);
+            acpi_ioapics[acpi_ioapic_count].gsi_base = *(uint32_t*)(entry + 8);
+            acpi_ioapic_count++;
+        } else if(type == MADT_ISO) {
+            uint8_t source = entry[3];
+            if(source < ISA_IRQ_COUNT) {
+                acpi_isa_overrides[source].gsi = *(uint32_t*)(entry + 4);
+                acpi_isa_overrides[source].flags = *(uint16_t*)(entry + 8);
+            }
+        } else if(type == MADT_LAPIC_OVERRIDE) {
+            acpi_lapic_address = *(uint64_t*)(entry + 4);
+        }
+        entry += entry[1];
+    }
+}
+
+bool acpi_init(void* rsdp_address) {
+    for(int i = 0; i < ISA_IRQ_COUNT; i++) {
+        acpi_isa_overrides[i].gsi = i;
+        acpi_isa_overrides[i].flags = 0;
+    }
+    acpi_ioapic_count = 0;
+    acpi_cpu_count = 0;
+
+    if(!rsdp_address) return false;
+    uint64_t rsdp_virt = (uint64_t)rsdp_address;
+    if(rsdp_virt < hhdm_offset) rsdp_virt += hhdm_offset;
+
+    RSDP* rsdp = (RSDP*)rsdp_virt;
+    if(strncmp(rsdp->signature, "RSD PTR ", 8) != 0) return false;
+
+    if(rsdp->revision >= 2 && rsdp->xsdt_address) {
+        root_table = (SDTHeader*)acpi_phys(rsdp->xsdt_address);
+        root_is_xsdt = true;
+    } else {
+        root_table = (SDTHeader*)acpi_phys(rsdp->rsdt_address);
+        root_is_xsdt = false;
+    }
+    if(!checksum_ok(root_table, root_table->length)) {
+        root_table = nullptr;
+        return false;
+    }
+
+    MADT* madt = (MADT*)acpi_find_table("APIC");
+    if(madt) parse_madt(madt);
+    return true;
+}
@@ -0,0 +1,165 @@
+#include <stdint.h>
+#include <stddef.h>
+
+extern uint64_t hhdm_offset;
+
+struct IOAPICInfo {
+    uint8_t id;
+    uint32_t address;
+    uint32_t gsi_base;
+};
+
+struct ISAOverride {
+    uint32_t gsi;
+    uint16_t flags;
+};
+
+extern IOAPICInfo acpi_ioapics[];
+extern int acpi_ioapic_count;
+extern ISAOverride acpi_isa_overrides[];
+
+#define MSR_APIC_BASE 0x1B
+#define APIC_BASE_ENABLE (1ULL << 11)
+
+#define LAPIC_ID 0x020
+#define LAPIC_EOI 0x0B0
+#define LAPIC_SPURIOUS 0x0F0
+#define LAPIC_TPR 0x080
+#define LAPIC_LVT_TIMER 0x320
+#define LAPIC_TIMER_INITIAL 0x380
+#define LAPIC_TIMER_CURRENT 0x390
+#define LAPIC_TIMER_DIVIDE 0x3E0
+#define LAPIC_ICR_LOW 0x300
+#define LAPIC_ICR_HIGH 0x310
+#define LAPIC_ICR_PENDING (1 << 12)
+
+#define SPURIOUS_VECTOR 0xFF
+
+#define IOAPIC_REGSEL 0x00
+#define IOAPIC_WINDOW 0x10
+#define IOAPIC_VERSION 0x01
+#define IOAPIC_REDIRECTION 0x10
+#define IOAPIC_MASKED (1 << 16)
+#define IOAPIC_ACTIVE_LOW (1 << 13)
+#define IOAPIC_LEVEL (1 << 15)
+
+volatile uint32_t* lapic_regs = nullptr;
+uint64_t lapic_phys_base = 0;
+
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint32_t lo, hi;
+    __asm__ volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ volatile("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+uint32_t lapic_read(uint32_t reg) {
+    return lapic_regs[reg / 4];
+}
+
+void lapic_write(uint32_t reg, uint32_t value) {
+    lapic_regs[reg / 4] = value;
+}
+
+void lapic_eoi() {
+    if(lapic_regs) lapic_write(LAPIC_EOI, 0);
+}
+
+uint32_t lapic_id() {
+    if(!lapic_regs) return 0;
+    return lapic_read(LAPIC_ID) >> 24;
+}
+
+bool lapic_init() {
+    uint32_t eax, ebx, ecx, edx;
+    __asm__ volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(1), "c"(0));
+    if(!((edx >> 9) & 1)) return false;
+
+    uint64_t base = rdmsr(MSR_APIC_BASE);
+    wrmsr(MSR_APIC_BASE, base | APIC_BASE_ENABLE);
+    lapic_phys_base = base & 0x000FFFFFFFFFF000ULL;
+    lapic_regs = (volatile uint32_t*)(hhdm_offset + lapic_phys_base);
+
+    lapic_write(LAPIC_TPR, 0);
+    lapic_write(LAPIC_SPURIOUS, 0x100 | SPURIOUS_VECTOR);
+    return true;
+}
+
+void lapic_send_ipi(uint32_t apic_id, uint8_t vector) {
+    uint64_t flags;
+    __asm__ volatile("pushfq; popq %0; cli" : "=r"(flags) : : "memory");
+    while(lapic_read(LAPIC_ICR_LOW) & LAPIC_ICR_PENDING) __asm__ volatile("pause");
+    lapic_write(LAPIC_ICR_HIGH, apic_id << 24);
+    lapic_write(LAPIC_ICR_LOW, vector);
+    if(flags & 0x200) __asm__ volatile("sti");
+}
+
+void lapic_timer_stop() {
+    lapic_write(LAPIC_LVT_TIMER, 1 << 16);
+    lapic_write(LAPIC_TIMER_INITIAL, 0);
+}
+
+void lapic_timer_start(uint8_t vector, uint32_t count, bool periodic) {
+    lapic_write(LAPIC_TIMER_DIVIDE, 0x3);
+    lapic_write(LAPIC_LVT_TIMER, vector | (periodic ? (1 << 17) : 0));
+    lapic_write(LAPIC_TIMER_INITIAL, count);
+}
+
+void lapic_timer_deadline_mode(uint8_t vector) {
+    lapic_write(LAPIC_LVT_TIMER, vector | (2 << 17));
+}
+
+uint32_t lapic_timer_current() {
+    return lapic_read(LAPIC_TIMER_CURRENT);
+}
+
+static uint32_t ioapic_read(uint32_t address, uint32_t reg) {
+    volatile uint32_t* base = (volatile uint32_t*)(hhdm_offset + address);
+    base[IOAPIC_REGSEL / 4] = reg;
+    return base[IOAPIC_WINDOW / 4];
+}
+
+static void ioapic_write(uint32_t address, uint32_t reg, uint32_t value) {
+    volatile uint32_t* base = (volatile uint32_t*)(hhdm_offset + address);
+    base[IOAPIC_REGSEL / 4] = reg;
+    base[IOAPIC_WINDOW / 4] = value;
+}
+
+static uint32_t ioapic_entry_count(uint32_t address) {
+    return ((ioapic_read(address, IOAPIC_VERSION) >> 16) & 0xFF) + 1;
+}
+
+void ioapic_init() {
+    for(int i = 0; i < acpi_ioapic_count; i++) {
+        uint32_t count = ioapic_entry_count(acpi_ioapics[i].address);
+        for(uint32_t pin = 0; pin < count; pin++) {
+            ioapic_write(acpi_ioapics[i].address, IOAPIC_REDIRECTION + pin * 2, IOAPIC_MASKED);
+            ioapic_write(acpi_ioapics[i].address, IOAPIC_REDIRECTION + pin * 2 + 1, 0);
+        }
+    }
+}
+
+bool ioapic_route_isa_irq(uint8_t irq, uint8_t vector, uint8_t dest_apic_id) {
+    if(irq >= 16) return false;
+    uint32_t gsi = acpi_isa_overrides[irq].gsi;
+    uint16_t flags = acpi_isa_overrides[irq].flags;
+
+    for(int i = 0; i < acpi_ioapic_count; i++) {
+        uint32_t address = acpi_ioapics[i].address;
+        uint32_t base = acpi_ioapics[i].gsi_base;
+        if(gsi < base || gsi >= base + ioapic_entry_count(address)) continue;
+
+        uint32_t low = vector;
+        if((flags & 0x3) == 0x3) low |= IOAPIC_ACTIVE_LOW;
+        if(((flags >> 2) & 0x3) == 0x3) low |= IOAPIC_LEVEL;
+
+        uint32_t pin = gsi - base;
+        ioapic_write(address, IOAPIC_REDIRECTION + pin * 2 + 1, (uint32_t)dest_apic_id << 24);
+        ioapic_write(address, IOAPIC_REDIRECTION + pin * 2, low);
+        return true;
+    }
+    return false;
+}
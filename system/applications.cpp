@@ -1,24 +1,29 @@
 #include <stdint.h>
 #include <stddef.h>
 
-extern uint32_t* fb_ptr;
 extern uint64_t fb_width;
 extern uint64_t fb_height;
 extern bool in_gui_mode;
+extern bool timer_ready;
+extern uint64_t clock_ns();
+extern void uint_to_str(uint64_t n, char* buffer);
 extern int mouse_x;
 extern int mouse_y;
 extern char current_directory[64];
 
-extern void put_pixel(int x, int y, uint32_t color);
 extern void draw_rect(int x, int y, int w, int h, uint32_t color);
 extern void draw_rounded_rect(int x, int y, int w, int h, uint32_t color);
+extern void draw_translucent_rounded_rect(int x, int y, int w, int h, uint32_t color, uint8_t alpha);
 extern void draw_char(char c, int x, int y, uint32_t color);
 extern void draw_string(const char* str, int x, int y, uint32_t color);
 extern void terminal_clear();
 extern void terminal_write(const char* str);
-extern void terminal_redraw();
 extern void draw_cursor(int x, int y);
+extern void restore_cursor_area();
+extern void gfx_set_clip(int x, int y, int w, int h);
+extern void gfx_reset_clip();
 extern void draw_background_logo();
+extern void terminal_redraw(int x, int y, int w, int h);
 extern void* memset(void *s, int c, size_t n);
 extern size_t strlen(const char *str);
 extern int strcmp(const char *s1, const char *s2);
@@ -26,11 +31,13 @@ extern char* strcpy(char *dest, const char *src);
 extern char* strcat(char *dest, const char *src);
 
 void refresh_all_windows();
+void refresh_region(int x, int y, int w, int h);
 void handle_click(int x, int y, bool right_click);
 
 extern void draw_browser_window();
 extern void handle_browser_click(int x, int y);
 extern void handle_browser_keyboard(char c);
+extern void handle_browser_scroll(int delta);
 extern bool is_browser_open();
 extern bool is_browser_minimized();
 extern void set_browser_minimized(bool state);
@@ -48,12 +55,15 @@ extern void set_filemanager_minimized(bool state);
 extern void handle_filemanager_click(int x, int y);
 extern void handle_filemanager_rightclick(int x, int y);
 extern void handle_filemanager_keyboard(char c);
+extern void handle_filemanager_scroll(int delta);
 extern void open_filemanager();
 extern bool viewer_open;
 extern void draw_viewer_window();
+extern void draw_filemanager_overlays();
 extern struct FileManagerWindow {
     int x, y, w, h;
     bool minimized;
+    bool maximized;
 } fm_win;
 
 extern void draw_terminal_app();
@@ -79,6 +89,29 @@ extern bool browser_open;
 extern bool terminal_open;
 extern bool filemanager_open;
 
+struct GfxRect {
+    int x0, y0, x1, y1;
+};
+
+struct GfxSurface {
+    uint32_t* pixels;
+    int width;
+    int height;
+};
+
+extern bool gfx_surface_resize(GfxSurface* surface, int w, int h);
+extern void serial_write(const char* str);
+extern void gfx_surface_free(GfxSurface* surface);
+extern void gfx_begin_surface(GfxSurface* surface, int origin_x, int origin_y);
+extern void gfx_end_surface();
+extern void gfx_blit_surface(const GfxSurface* surface, int x, int y);
+extern void gfx_blend_surface(const GfxSurface* surface, int x, int y);
+extern void gfx_scroll_rect(int x, int y, int w, int h, int dy);
+extern void gfx_blend_rect(int x, int y, int w, int h, uint32_t color, uint8_t alpha);
+extern bool gfx_raster_begin(int w, int h);
+extern void gfx_raster_end();
+extern GfxRect gfx_clip;
+
 struct InstalledApp {
     char name[32];
     int type;
@@ -113,6 +146,177 @@ enum AppID {
 
 AppID focused_app = APP_NONE;
 
+#define WINDOW_COUNT 3
+
+struct AppWindow {
+    AppID app;
+    GfxSurface surface;
+    GfxRect dirty;
+    int failed_w;
+    int failed_h;
+};
+
+static AppWindow app_windows[WINDOW_COUNT] = {
+    {APP_TERMINAL, {nullptr, 0, 0}, {0, 0, 0, 0}, 0, 0},
+    {APP_BROWSER, {nullptr, 0, 0}, {0, 0, 0, 0}, 0, 0},
+    {APP_FILEMANAGER, {nullptr, 0, 0}, {0, 0, 0, 0}, 0, 0}
+};
+
+static AppWindow* window_stack[WINDOW_COUNT] = {&app_windows[0], &app_windows[1], &app_windows[2]};
+
+static AppWindow* find_window(AppID app) {
+    for(int i = 0; i < WINDOW_COUNT; i++) {
+        if(app_windows[i].app == app) return &app_windows[i];
+    }
+    return nullptr;
+}
+
+static bool is_window_open(AppID app) {
+    if(app == APP_TERMINAL) return is_terminal_open();
+    if(app == APP_BROWSER) return is_browser_open();
+    if(app == APP_FILEMANAGER) return is_filemanager_open();
+    return false;
+}
+
+bool get_window_rect(AppID app, int* x, int* y, int* w, int* h) {
+    if(app == APP_TERMINAL) {
+        if(!is_terminal_open() || is_terminal_minimized()) return false;
+        *x = term_win.maximized ? 0 : term_win.x;
+        *y = term_win.maximized ? 0 : term_win.y;
+        *w = term_win.maximized ? (int)fb_width : term_win.w;
+        *h = term_win.maximized ? (int)fb_height - 50 : term_win.h;
+    } else if(app == APP_BROWSER) {
+        if(!is_browser_open() || is_browser_minimized()) return false;
+        *x = browser_win.maximized ? 0 : browser_win.x;
+        *y = browser_win.maximized ? 0 : browser_win.y;
+        *w = browser_win.maximized ? (int)fb_width : browser_win.w;
+        *h = browser_win.maximized ? (int)fb_height - 50 : browser_win.h;
+    } else if(app == APP_FILEMANAGER) {
+        if(!is_filemanager_open() || is_filemanager_minimized()) return false;
+        *x = fm_win.maximized ? 0 : fm_win.x;
+        *y = fm_win.maximized ? 0 : fm_win.y;
+        *w = fm_win.maximized ? (int)fb_width : fm_win.w;
+        *h = fm_win.maximized ? (int)fb_height - 40 : fm_win.h;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool window_can_drag(AppID app) {
+    if(app == APP_TERMINAL) return !term_win.maximized;
+    if(app == APP_BROWSER) return !browser_win.maximized;
+    if(app == APP_FILEMANAGER) return !fm_win.maximized;
+    return false;
+}
+
+static void mark_dirty(AppWindow* win, int x0, int y0, int x1, int y1) {
+    if(x0 >= x1 || y0 >= y1) return;
+    if(win->dirty.x0 >= win->dirty.x1 || win->dirty.y0 >= win->dirty.y1) {
+        win->dirty.x0 = x0;
+        win->dirty.y0 = y0;
+        win->dirty.x1 = x1;
+        win->dirty.y1 = y1;
+        return;
+    }
+    if(x0 < win->dirty.x0) win->dirty.x0 = x0;
+    if(y0 < win->dirty.y0) win->dirty.y0 = y0;
+    if(x1 > win->dirty.x1) win->dirty.x1 = x1;
+    if(y1 > win->dirty.y1) win->dirty.y1 = y1;
+}
+
+void invalidate_window(AppID app) {
+    AppWindow* win = find_window(app);
+    if(win) mark_dirty(win, 0, 0, fb_width, fb_height);
+}
+
+static void draw_window_contents(AppID app, int x, int y, int w, int h) {
+    if(app == APP_TERMINAL) {
+        draw_terminal_app();
+        terminal_redraw(x, y, w, h);
+    } else if(app == APP_BROWSER) {
+        draw_browser_window();
+    } else if(app == APP_FILEMANAGER) {
+        draw_filemanager_window();
+    }
+}
+
+static void render_window(AppWindow* win, int x, int y, int w, int h) {
+    if(win->surface.width != w || win->surface.height != h) {
+        if(win->failed_w == w && win->failed_h == h) return;
+        if(!gfx_surface_resize(&win->surface, w, h)) {
+            win->failed_w = w;
+            win->failed_h = h;
+            serial_write("[gfx] window surface allocation failed, drawing the window directly\n");
+            return;
+        }
+        win->failed_w = win->failed_h = 0;
+        mark_dirty(win, 0, 0, w, h);
+    }
+    GfxRect* dirty = &win->dirty;
+    if(dirty->x0 >= dirty->x1 || dirty->y0 >= dirty->y1) return;
+    
+    gfx_begin_surface(&win->surface, x, y);
+    gfx_set_clip(x + dirty->x0, y + dirty->y0, dirty->x1 - dirty->x0, dirty->y1 - dirty->y0);
+    draw_window_contents(win->app, x, y, w, h);
+    gfx_end_surface();
+    dirty->x0 = dirty->y0 = dirty->x1 = dirty->y1 = 0;
+}
+
+static void raise_window(AppID app) {
+    int i = 0;
+    while(i < WINDOW_COUNT && window_stack[i]->app != app) i++;
+    if(i == WINDOW_COUNT) return;
+    AppWindow* win = window_stack[i];
+    for(; i < WINDOW_COUNT - 1; i++) window_stack[i] = window_stack[i + 1];
+    window_stack[WINDOW_COUNT - 1] = win;
+}
+
+static void focus_app(AppID app) {
+    focused_app = app;
+    raise_window(app);
+}
+
+#define NS_PER_SEC 1000000000ULL
+#define FRAME_RATE_DEFAULT 60
+#define FRAME_RATE_MIN 1
+#define FRAME_RATE_MAX 1000
+#define FRAME_WAIT_FOREVER 0xFFFFFFFFFFFFFFFFULL
+
+static uint32_t frame_rate = FRAME_RATE_DEFAULT;
+static uint64_t frame_interval_ns = NS_PER_SEC / FRAME_RATE_DEFAULT;
+static uint64_t next_frame_ns = 0;
+static GfxRect pending_repaint = {0, 0, 0, 0};
+static bool repaint_pending = false;
+
+#define HUD_SAMPLES 64
+#define HUD_GRAPH_H 40
+#define HUD_W (HUD_SAMPLES * 2 + 8)
+#define HUD_H (HUD_GRAPH_H + 24)
+#define HUD_MARGIN 10
+#define HUD_ALPHA 0xB0
+#define HUD_OPAQUE 0xFF000000
+
+static bool hud_enabled = false;
+static uint32_t hud_samples[HUD_SAMPLES];
+static int hud_next = 0;
+static GfxSurface hud_surface = {nullptr, 0, 0};
+
+#define DESKTOP_COLOR 0x0f0f1e
+#define MENU_ALPHA 0xD8
+
+static GfxSurface wallpaper = {nullptr, 0, 0};
+static bool wallpaper_failed = false;
+
+static AppID window_at(int x, int y) {
+    for(int i = WINDOW_COUNT - 1; i >= 0; i--) {
+        int wx, wy, ww, wh;
+        if(!get_window_rect(window_stack[i]->app, &wx, &wy, &ww, &wh)) continue;
+        if(x >= wx && x <= wx + ww && y >= wy && y <= wy + wh) return window_stack[i]->app;
+    }
+    return APP_NONE;
+}
+
 enum KeyboardLayout {
     LAYOUT_QWERTY = 0,
     LAYOUT_TRQ = 1
@@ -205,32 +409,38 @@ DraggingApp current_drag = DRAG_NONE;
 int drag_offset_x = 0;
 int drag_offset_y = 0;
 
-void update_window_drag(int x, int y) {
-    if(current_drag == DRAG_TERMINAL && !term_win.maximized) {
-        term_win.x = x - drag_offset_x;
-        term_win.y = y - drag_offset_y;
-        if(term_win.x < 0) term_win.x = 0;
-        if(term_win.y < 0) term_win.y = 0;
-        if(term_win.x + term_win.w > (int)fb_width) term_win.x = fb_width - term_win.w;
-        if(term_win.y + term_win.h > (int)fb_height - 50) term_win.y = fb_height - 50 - term_win.h;
-        refresh_all_windows();
-    } else if(current_drag == DRAG_BROWSER && !browser_win.maximized) {
-        browser_win.x = x - drag_offset_x;
-        browser_win.y = y - drag_offset_y;
-        if(browser_win.x < 0) browser_win.x = 0;
-        if(browser_win.y < 0) browser_win.y = 0;
-        if(browser_win.x + browser_win.w > (int)fb_width) browser_win.x = fb_width - browser_win.w;
-        if(browser_win.y + browser_win.h > (int)fb_height - 50) browser_win.y = fb_height - 50 - browser_win.h;
-        refresh_all_windows();
-    } else if(current_drag == DRAG_FILEMANAGER) {
-        fm_win.x = x - drag_offset_x;
-        fm_win.y = y - drag_offset_y;
-        if(fm_win.x < 0) fm_win.x = 0;
-        if(fm_win.y < 0) fm_win.y = 0;
-        if(fm_win.x + fm_win.w > (int)fb_width) fm_win.x = fb_width - fm_win.w;
-        if(fm_win.y + fm_win.h > (int)fb_height - 50) fm_win.y = fb_height - 50 - fm_win.h;
-        refresh_all_windows();
+static void refresh_moved_window(int old_x, int old_y, int new_x, int new_y, int w, int h) {
+    int x0 = old_x < new_x ? old_x : new_x;
+    int y0 = old_y < new_y ? old_y : new_y;
+    int x1 = (old_x > new_x ? old_x : new_x) + w;
+    int y1 = (old_y > new_y ? old_y : new_y) + h;
+    refresh_region(x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+}
+
+bool move_window(AppID app, int x, int y) {
+    int wx, wy, ww, wh;
+    if(!window_can_drag(app) || !get_window_rect(app, &wx, &wy, &ww, &wh)) return false;
+    if(x < 0) x = 0;
+    if(y < 0) y = 0;
+    if(x + ww > (int)fb_width) x = fb_width - ww;
+    if(y + wh > (int)fb_height - 50) y = fb_height - 50 - wh;
+    if(app == APP_TERMINAL) {
+        term_win.x = x;
+        term_win.y = y;
+    } else if(app == APP_BROWSER) {
+        browser_win.x = x;
+        browser_win.y = y;
+    } else {
+        fm_win.x = x;
+        fm_win.y = y;
     }
+    refresh_moved_window(wx, wy, x, y, ww, wh);
+    return true;
+}
+
+void update_window_drag(int x, int y) {
+    AppID app = current_drag == DRAG_TERMINAL ? APP_TERMINAL : current_drag == DRAG_BROWSER ? APP_BROWSER : current_drag == DRAG_FILEMANAGER ? APP_FILEMANAGER : APP_NONE;
+    if(app == APP_NONE || !move_window(app, x - drag_offset_x, y - drag_offset_y)) draw_cursor(x, y);
 }
 
 void stop_window_drag() {
@@ -307,7 +517,7 @@ void draw_network_menu() {
     int menu_x = fb_width - menu_w - 20;
     int menu_y = fb_height - 50 - menu_h - 10;
     
-    draw_rounded_rect(menu_x, menu_y, menu_w, menu_h, 0x16213e);
+    draw_translucent_rounded_rect(menu_x, menu_y, menu_w, menu_h, 0x16213e, MENU_ALPHA);
     draw_rect(menu_x, menu_y, menu_w, 40, 0x1a1a2e);
     draw_string("Network", menu_x + 15, menu_y + 15, 0xFFFFFF);
     
@@ -362,7 +572,7 @@ void draw_power_menu() {
     int menu_x = 10;
     int menu_y = fb_height - 50 - menu_h - 10;
     
-    draw_rounded_rect(menu_x, menu_y, menu_w, menu_h, 0x16213e);
+    draw_translucent_rounded_rect(menu_x, menu_y, menu_w, menu_h, 0x16213e, MENU_ALPHA);
     draw_rect(menu_x, menu_y, menu_w, 40, 0x1a1a2e);
     draw_string("Power", menu_x + 15, menu_y + 15, 0xFFFFFF);
     
@@ -468,26 +678,111 @@ void draw_wifi_password_dialog() {
     draw_string("Connect", dialog_x + dialog_w - 100, dialog_y + 122, 0xFFFFFF);
 }
 
-void refresh_all_windows() {
-    if(!in_gui_mode) return;
+static bool render_wallpaper() {
+    if(wallpaper_failed) return false;
+    if(!gfx_surface_resize(&wallpaper, fb_width, fb_height)) {
+        wallpaper_failed = true;
+        serial_write("[gfx] wallpaper layer allocation failed, drawing the desktop directly\n");
+        return false;
+    }
+    GfxRect saved = gfx_clip;
+    gfx_begin_surface(&wallpaper, 0, 0);
+    draw_rect(0, 0, fb_width, fb_height, DESKTOP_COLOR);
+    draw_background_logo();
+    gfx_end_surface();
+    gfx_clip = saved;
+    return true;
+}
+
+static void draw_exposed_wallpaper(int x0, int y0, int x1, int y1, int level) {
+    if(x0 >= x1 || y0 >= y1) return;
+    for(; level < WINDOW_COUNT; level++) {
+        int wx, wy, ww, wh;
+        if(!get_window_rect(window_stack[level]->app, &wx, &wy, &ww, &wh)) continue;
+        if(wx >= x1 || wx + ww <= x0 || wy >= y1 || wy + wh <= y0) continue;
+        int cy0 = wy > y0 ? wy : y0;
+        int cy1 = wy + wh < y1 ? wy + wh : y1;
+        draw_exposed_wallpaper(x0, y0, x1, cy0, level + 1);
+        draw_exposed_wallpaper(x0, cy1, x1, y1, level + 1);
+        draw_exposed_wallpaper(x0, cy0, wx, cy1, level + 1);
+        draw_exposed_wallpaper(wx + ww, cy0, x1, cy1, level + 1);
+        return;
+    }
     
-    for(uint64_t i = 0; i < fb_width * fb_height; i++) {
-        fb_ptr[i] = 0x0f0f1e;
+    GfxRect saved = gfx_clip;
+    int cx0 = x0 > saved.x0 ? x0 : saved.x0;
+    int cy0 = y0 > saved.y0 ? y0 : saved.y0;
+    int cx1 = x1 < saved.x1 ? x1 : saved.x1;
+    int cy1 = y1 < saved.y1 ? y1 : saved.y1;
+    if(cx0 >= cx1 || cy0 >= cy1) return;
+    gfx_set_clip(cx0, cy0, cx1 - cx0, cy1 - cy0);
+    gfx_blit_surface(&wallpaper, 0, 0);
+    gfx_clip = saved;
+}
+
+static void draw_frame_hud() {
+    int x = fb_width - HUD_W - HUD_MARGIN;
+    int y = HUD_MARGIN;
+    uint64_t budget_us = frame_interval_ns / 1000;
+    uint64_t total_us = 0;
+    int base = y + HUD_H - 4;
+    
+    if(!gfx_surface_resize(&hud_surface, HUD_W, HUD_H)) {
+        gfx_blend_rect(x, y, HUD_W, HUD_H, 0x000000, HUD_ALPHA);
+        return;
     }
+    GfxRect saved = gfx_clip;
+    gfx_begin_surface(&hud_surface, x, y);
+    draw_rect(x, y, HUD_W, HUD_H, (uint32_t)HUD_ALPHA << 24);
+    for(int i = 0; i < HUD_SAMPLES; i++) {
+        uint32_t us = hud_samples[(hud_next + i) % HUD_SAMPLES];
+        total_us += us;
+        uint64_t bar = budget_us ? us * HUD_GRAPH_H / (2 * budget_us) : 0;
+        if(bar > HUD_GRAPH_H) bar = HUD_GRAPH_H;
+        if(bar == 0 && us) bar = 1;
+        draw_rect(x + 4 + i * 2, base - bar, 2, bar, HUD_OPAQUE | (us > budget_us ? 0xFF5050 : 0x50E050));
+    }
+    draw_rect(x + 4, base - HUD_GRAPH_H / 2, HUD_SAMPLES * 2, 1, HUD_OPAQUE | 0xE0E040);
     
-    draw_background_logo();
+    char s[24];
+    uint_to_str(total_us / HUD_SAMPLES, s);
+    draw_string("avg", x + 4, y + 6, HUD_OPAQUE | 0xCCCCCC);
+    draw_string(s, x + 36, y + 6, HUD_OPAQUE | 0xFFFFFF);
+    draw_string("us", x + 36 + strlen(s) * 8 + 8, y + 6, HUD_OPAQUE | 0xCCCCCC);
+    gfx_end_surface();
+    gfx_clip = saved;
+    gfx_blend_surface(&hud_surface, x, y);
+}
+
+static void composite_region(int x, int y, int w, int h) {
+    restore_cursor_area();
     
-    if(is_terminal_open() && !is_terminal_minimized()) {
-        draw_terminal_app();
-        terminal_redraw();
+    for(int i = 0; i < WINDOW_COUNT; i++) {
+        AppWindow* win = window_stack[i];
+        int wx, wy, ww, wh;
+        if(get_window_rect(win->app, &wx, &wy, &ww, &wh)) render_window(win, wx, wy, ww, wh);
+        else if(!is_window_open(win->app)) gfx_surface_free(&win->surface);
     }
     
-    if(is_browser_open() && !is_browser_minimized()) {
-        draw_browser_window();
+    gfx_raster_begin(w, h);
+    gfx_set_clip(x, y, w, h);
+    if((wallpaper.width == (int)fb_width && wallpaper.height == (int)fb_height) || render_wallpaper()) {
+        draw_exposed_wallpaper(x, y, x + w, y + h, 0);
+    } else {
+        draw_rect(0, 0, fb_width, fb_height, DESKTOP_COLOR);
+        draw_background_logo();
+    }
+    
+    for(int i = 0; i < WINDOW_COUNT; i++) {
+        AppWindow* win = window_stack[i];
+        int wx, wy, ww, wh;
+        if(!get_window_rect(win->app, &wx, &wy, &ww, &wh)) continue;
+        if(win->surface.pixels) gfx_blit_surface(&win->surface, wx, wy);
+        else draw_window_contents(win->app, wx, wy, ww, wh);
     }
     
     if(is_filemanager_open() && !is_filemanager_minimized()) {
-        draw_filemanager_window();
+        draw_filemanager_overlays();
         if(viewer_open) {
             draw_viewer_window();
         }
@@ -500,13 +795,144 @@ void refresh_all_windows() {
     if(network_menu_open) draw_network_menu();
     if(settings_menu_open) draw_settings_menu();
     if(wifi_password_prompt) draw_wifi_password_dialog();
+    if(hud_enabled) draw_frame_hud();
     
+    gfx_raster_end();
+    gfx_reset_clip();
     draw_cursor(mouse_x, mouse_y);
 }
 
+void refresh_region(int x, int y, int w, int h) {
+    if(!in_gui_mode || w <= 0 || h <= 0) return;
+    GfxRect rect = {x, y, x + w, y + h};
+    if(!repaint_pending) {
+        pending_repaint = rect;
+        repaint_pending = true;
+        return;
+    }
+    if(rect.x0 < pending_repaint.x0) pending_repaint.x0 = rect.x0;
+    if(rect.y0 < pending_repaint.y0) pending_repaint.y0 = rect.y0;
+    if(rect.x1 > pending_repaint.x1) pending_repaint.x1 = rect.x1;
+    if(rect.y1 > pending_repaint.y1) pending_repaint.y1 = rect.y1;
+}
+
+static void composite_pending(uint64_t now) {
+    repaint_pending = false;
+    composite_region(pending_repaint.x0, pending_repaint.y0, pending_repaint.x1 - pending_repaint.x0, pending_repaint.y1 - pending_repaint.y0);
+    next_frame_ns = now + frame_interval_ns;
+    if(!hud_enabled || !timer_ready) return;
+    
+    hud_samples[hud_next] = (clock_ns() - now) / 1000;
+    hud_next = (hud_next + 1) % HUD_SAMPLES;
+    composite_region(fb_width - HUD_W - HUD_MARGIN, HUD_MARGIN, HUD_W, HUD_H);
+}
+
+bool compositor_frame() {
+    if(!repaint_pending) return false;
+    uint64_t now = timer_ready ? clock_ns() : 0;
+    if(timer_ready && now < next_frame_ns) return false;
+    
+    composite_pending(now);
+    return true;
+}
+
+bool compositor_frame_now() {
+    if(!repaint_pending) return false;
+    composite_pending(timer_ready ? clock_ns() : 0);
+    return true;
+}
+
+void compositor_set_hud(bool enabled) {
+    hud_enabled = enabled;
+    if(!enabled) gfx_surface_free(&hud_surface);
+    refresh_region(fb_width - HUD_W - HUD_MARGIN, HUD_MARGIN, HUD_W, HUD_H);
+}
+
+bool compositor_hud_enabled() {
+    return hud_enabled;
+}
+
+void compositor_redraw_all() {
+    composite_region(0, 0, fb_width, fb_height);
+}
+
+uint64_t compositor_wait_ns() {
+    if(!repaint_pending) return FRAME_WAIT_FOREVER;
+    if(!timer_ready) return 0;
+    uint64_t now = clock_ns();
+    return now >= next_frame_ns ? 0 : next_frame_ns - now;
+}
+
+void compositor_set_rate(uint32_t hz) {
+    if(hz < FRAME_RATE_MIN) hz = FRAME_RATE_MIN;
+    if(hz > FRAME_RATE_MAX) hz = FRAME_RATE_MAX;
+    frame_rate = hz;
+    frame_interval_ns = NS_PER_SEC / hz;
+}
+
+uint32_t compositor_get_rate() {
+    return frame_rate;
+}
+
+void refresh_all_windows() {
+    refresh_region(0, 0, fb_width, fb_height);
+}
+
+void refresh_window(AppID app) {
+    invalidate_window(app);
+    refresh_all_windows();
+}
+
+void invalidate_window_rect(AppID app, int x, int y, int w, int h) {
+    AppWindow* win = find_window(app);
+    int wx, wy, ww, wh;
+    if(!win) return;
+    if(!get_window_rect(app, &wx, &wy, &ww, &wh)) {
+        invalidate_window(app);
+        return;
+    }
+    mark_dirty(win, x - wx, y - wy, x - wx + w, y - wy + h);
+}
+
+void redraw_window_rect(AppID app, int x, int y, int w, int h) {
+    invalidate_window_rect(app, x, y, w, h);
+    refresh_region(x, y, w, h);
+}
+
+bool scroll_window_rect(AppID app, int x, int y, int w, int h, int dy) {
+    AppWindow* win = find_window(app);
+    int wx, wy, ww, wh;
+    if(!win || !get_window_rect(app, &wx, &wy, &ww, &wh)) return false;
+    if(!win->surface.pixels || win->surface.width != ww || win->surface.height != wh) return false;
+    
+    GfxRect* dirty = &win->dirty;
+    bool has_dirty = dirty->x0 < dirty->x1 && dirty->y0 < dirty->y1;
+    if(has_dirty && dirty->x0 < x - wx + w && x - wx < dirty->x1 && dirty->y0 < y - wy + h && y - wy < dirty->y1) return false;
+    
+    gfx_begin_surface(&win->surface, wx, wy);
+    gfx_scroll_rect(x, y, w, h, dy);
+    gfx_end_surface();
+    return true;
+}
+
+bool render_window_rect(AppID app, int x, int y, int w, int h) {
+    AppWindow* win = find_window(app);
+    int wx, wy, ww, wh;
+    if(!win || !get_window_rect(app, &wx, &wy, &ww, &wh)) return false;
+    if(!win->surface.pixels || win->surface.width != ww || win->surface.height != wh) return false;
+    
+    gfx_begin_surface(&win->surface, wx, wy);
+    gfx_set_clip(x, y, w, h);
+    draw_window_contents(app, wx, wy, ww, wh);
+    gfx_end_surface();
+    refresh_region(x, y, w, h);
+    return true;
+}
+
 void handle_wifi_password_input(char c) {
     if(c == '\n') {
         connect_to_wifi(selected_wifi_network, wifi_password_input);
+        invalidate_window(APP_BROWSER);
         wifi_password_prompt = false;
         network_menu_open = false;
         refresh_all_windows();
@@ -517,16 +943,55 @@ void handle_wifi_password_input(char c) {
         if(wifi_password_len > 0) {
             wifi_password_len--;
             wifi_password_input[wifi_password_len] = '\0';
-            refresh_all_windows();
+            refresh_region((fb_width - 400) / 2 + 20, (fb_height - 150) / 2 + 75, 360, 30);
         }
     } else if(c >= 32 && c < 127 && wifi_password_len < 63) {
         wifi_password_input[wifi_password_len] = c;
         wifi_password_len++;
         wifi_password_input[wifi_password_len] = '\0';
-        refresh_all_windows();
+        refresh_region((fb_width - 400) / 2 + 20, (fb_height - 150) / 2 + 75, 360, 30);
     }
 }
 
+static void close_window(AppID app) {
+    if(app == APP_TERMINAL) close_terminal();
+    else if(app == APP_BROWSER) close_browser();
+    else if(app == APP_FILEMANAGER) close_filemanager();
+}
+
+static void forward_window_click(AppID app, int x, int y, bool right_click) {
+    if(app == APP_TERMINAL) handle_terminal_click(x, y);
+    else if(app == APP_BROWSER) handle_browser_click(x, y);
+    else if(app == APP_FILEMANAGER && right_click) handle_filemanager_rightclick(x, y);
+    else if(app == APP_FILEMANAGER) handle_filemanager_click(x, y);
+}
+
+static bool click_window(AppID app, int x, int y, bool right_click) {
+    int wx, wy, ww, wh;
+    if(!get_window_rect(app, &wx, &wy, &ww, &wh)) return false;
+    
+    bool was_focused = focused_app == app;
+    bool title_bar = y <= wy + 35 && window_can_drag(app);
+    focus_app(app);
+    
+    if(was_focused || !title_bar) forward_window_click(app, x, y, right_click);
+    if(title_bar) {
+        if(x >= wx + ww - 20 && x <= wx + ww - 5) {
+            close_window(app);
+            refresh_all_windows();
+            return true;
+        } else if(x < wx + ww - 80) {
+            current_drag = app == APP_TERMINAL ? DRAG_TERMINAL : app == APP_BROWSER ? DRAG_BROWSER : DRAG_FILEMANAGER;
+            drag_offset_x = x - wx;
+            drag_offset_y = y - wy;
+        }
+    }
+    if(was_focused) return false;
+    
+    refresh_all_windows();
+    return true;
+}
+
 void handle_click(int x, int y, bool right_click) {
     if(wifi_password_prompt) {
         int dialog_w = 400;
@@ -537,6 +1002,7 @@ void handle_click(int x, int y, bool right_click) {
         if(x >= dialog_x + dialog_w - 120 && x <= dialog_x + dialog_w - 20 &&
            y >= dialog_y + 115 && y <= dialog_y + 140) {
             connect_to_wifi(selected_wifi_network, wifi_password_input);
+            invalidate_window(APP_BROWSER);
             wifi_password_prompt = false;
             network_menu_open = false;
             refresh_all_windows();
@@ -567,7 +1033,7 @@ void handle_click(int x, int y, bool right_click) {
         if(is_terminal_open()) {
             if(x >= task_x && x <= task_x + 100) {
                 set_terminal_minimized(!is_terminal_minimized());
-                focused_app = APP_TERMINAL;
+                focus_app(APP_TERMINAL);
                 refresh_all_windows();
                 return;
             }
@@ -576,7 +1042,7 @@ void handle_click(int x, int y, bool right_click) {
         if(is_browser_open()) {
             if(x >= task_x && x <= task_x + 100) {
                 set_browser_minimized(!is_browser_minimized());
-                focused_app = APP_BROWSER;
+                focus_app(APP_BROWSER);
                 refresh_all_windows();
                 return;
             }
@@ -585,7 +1051,7 @@ void handle_click(int x, int y, bool right_click) {
         if(is_filemanager_open()) {
             if(x >= task_x && x <= task_x + 100) {
                 set_filemanager_minimized(!is_filemanager_minimized());
-                focused_app = APP_FILEMANAGER;
+                focus_app(APP_FILEMANAGER);
                 refresh_all_windows();
                 return;
             }
@@ -616,19 +1082,19 @@ void handle_click(int x, int y, bool right_click) {
         if(x >= menu_x && x <= menu_x + menu_w && y >= menu_y && y <= menu_y + menu_h) {
             if(y >= menu_y + 50 && y <= menu_y + 85) {
                 open_terminal();
-                focused_app = APP_TERMINAL;
+                focus_app(APP_TERMINAL);
                 app_menu_open = false;
                 refresh_all_windows();
                 return;
             } else if(y >= menu_y + 95 && y <= menu_y + 130) {
                 open_browser();
-                focused_app = APP_BROWSER;
+                focus_app(APP_BROWSER);
                 app_menu_open = false;
                 refresh_all_windows();
                 return;
             } else if(y >= menu_y + 140 && y <= menu_y + 175) {
                 open_filemanager();
-                focused_app = APP_FILEMANAGER;
+                focus_app(APP_FILEMANAGER);
                 app_menu_open = false;
                 refresh_all_windows();
                 return;
@@ -708,6 +1174,7 @@ void handle_click(int x, int y, bool right_click) {
                             refresh_all_windows();
                         } else {
                             connect_to_wifi(i, "");
+                            invalidate_window(APP_BROWSER);
                             network_menu_open = false;
                             refresh_all_windows();
                         }
@@ -720,144 +1187,8 @@ void handle_click(int x, int y, bool right_click) {
         }
     }
     
-    bool click_handled = false;
-    
-    if (focused_app == APP_TERMINAL && is_terminal_open() && !is_terminal_minimized()) {
-        int wx = term_win.maximized ? 0 : term_win.x;
-        int wy = term_win.maximized ? 0 : term_win.y;
-        int ww = term_win.maximized ? (int)fb_width : term_win.w;
-        int wh = term_win.maximized ? (int)fb_height - 50 : term_win.h;
-        
-        if(x >= wx && x <= wx + ww && y >= wy && y <= wy + wh) {
-            handle_terminal_click(x, y);
-            if(y <= wy + 35 && !term_win.maximized) {
-                if(x >= wx + ww - 20 && x <= wx + ww - 5) {
-                    close_terminal();
-                    refresh_all_windows();
-                    return;
-                } else if(x < wx + ww - 80) {
-                    current_drag = DRAG_TERMINAL;
-                    drag_offset_x = x - wx;
-                    drag_offset_y = y - wy;
-                }
-            }
-            click_handled = true;
-        }
-    } else if (focused_app == APP_BROWSER && is_browser_open() && !is_browser_minimized()) {
-        int wx = browser_win.maximized ? 0 : browser_win.x;
-        int wy = browser_win.maximized ? 0 : browser_win.y;
-        int ww = browser_win.maximized ? (int)fb_width : browser_win.w;
-        int wh = browser_win.maximized ? (int)fb_height - 50 : browser_win.h;
-        
-        if(x >= wx && x <= wx + ww && y >= wy && y <= wy + wh) {
-            handle_browser_click(x, y);
-            if(y <= wy + 35 && !browser_win.maximized) {
-                if(x >= wx + ww - 20 && x <= wx + ww - 5) {
-                    close_browser();
-                    refresh_all_windows();
-                    return;
-                } else if(x < wx + ww - 80) {
-                    current_drag = DRAG_BROWSER;
-                    drag_offset_x = x - wx;
-                    drag_offset_y = y - wy;
-                }
-            }
-            click_handled = true;
-        }
-    } else if (focused_app == APP_FILEMANAGER && is_filemanager_open() && !is_filemanager_minimized()) {
-        if(x >= fm_win.x && x <= fm_win.x + fm_win.w && y >= fm_win.y && y <= fm_win.y + fm_win.h) {
-            if(right_click) handle_filemanager_rightclick(x, y);
-            else handle_filemanager_click(x, y);
-            if(y <= fm_win.y + 35) {
-                if(x >= fm_win.x + fm_win.w - 20 && x <= fm_win.x + fm_win.w - 5) {
-                    close_filemanager();
-                    refresh_all_windows();
-                    return;
-                } else if(x < fm_win.x + fm_win.w - 80) {
-                    current_drag = DRAG_FILEMANAGER;
-                    drag_offset_x = x - fm_win.x;
-                    drag_offset_y = y - fm_win.y;
-                }
-            }
-            click_handled = true;
-        }
-    }
-    
-    if (!click_handled) {
-        if (is_terminal_open() && !is_terminal_minimized()) {
-            int wx = term_win.maximized ? 0 : term_win.x;
-            int wy = term_win.maximized ? 0 : term_win.y;
-            int ww = term_win.maximized ? (int)fb_width : term_win.w;
-            int wh = term_win.maximized ? (int)fb_height - 50 : term_win.h;
-            
-            if(x >= wx && x <= wx + ww && y >= wy && y <= wy + wh) {
-                focused_app = APP_TERMINAL;
-                if(y <= wy + 35 && !term_win.maximized) {
-                    if(x >= wx + ww - 20 && x <= wx + ww - 5) {
-                        close_terminal();
-                        refresh_all_windows();
-                        return;
-                    } else if(x < wx + ww - 80) {
-                        current_drag = DRAG_TERMINAL;
-                        drag_offset_x = x - wx;
-                        drag_offset_y = y - wy;
-                    }
-                } else {
-                    handle_terminal_click(x, y);
-                }
-                refresh_all_windows();
-                return;
-            }
-        }
-        
-        if (is_browser_open() && !is_browser_minimized()) {
-            int wx = browser_win.maximized ? 0 : browser_win.x;
-            int wy = browser_win.maximized ? 0 : browser_win.y;
-            int ww = browser_win.maximized ? (int)fb_width : browser_win.w;
-            int wh = browser_win.maximized ? (int)fb_height - 50 : browser_win.h;
-            
-            if(x >= wx && x <= wx + ww && y >= wy && y <= wy + wh) {
-                focused_app = APP_BROWSER;
-                if(y <= wy + 35 && !browser_win.maximized) {
-                    if(x >= wx + ww - 20 && x <= wx + ww - 5) {
-                        close_browser();
-                        refresh_all_windows();
-                        return;
-                    } else if(x < wx + ww - 80) {
-                        current_drag = DRAG_BROWSER;
-                        drag_offset_x = x - wx;
-                        drag_offset_y = y - wy;
-                    }
-                } else {
-                    handle_browser_click(x, y);
-                }
-                refresh_all_windows();
-                return;
-            }
-        }
-        
-        if (is_filemanager_open() && !is_filemanager_minimized()) {
-            if(x >= fm_win.x && x <= fm_win.x + fm_win.w && y >= fm_win.y && y <= fm_win.y + fm_win.h) {
-                focused_app = APP_FILEMANAGER;
-                if(y <= fm_win.y + 35) {
-                    if(x >= fm_win.x + fm_win.w - 20 && x <= fm_win.x + fm_win.w - 5) {
-                        close_filemanager();
-                        refresh_all_windows();
-                        return;
-                    } else if(x < fm_win.x + fm_win.w - 80) {
-                        current_drag = DRAG_FILEMANAGER;
-                        drag_offset_x = x - fm_win.x;
-                        drag_offset_y = y - fm_win.y;
-                    }
-                } else {
-                    if(right_click) handle_filemanager_rightclick(x, y);
-                    else handle_filemanager_click(x, y);
-                }
-                refresh_all_windows();
-                return;
-            }
-        }
-    }
+    AppID target = window_at(x, y);
+    if(target != APP_NONE && click_window(target, x, y, right_click)) return;
     
     app_menu_open = false;
     power_menu_open = false;
@@ -881,6 +1212,8 @@ void init_application_system() {
         installed_apps[i].name[0] = '\0';
     }
     installed_app_count = 0;
+    
+    render_wallpaper();
 }
 
 bool is_app_focused() {
@@ -909,4 +1242,18 @@ void handle_app_keyboard(char c) {
             handle_browser_keyboard(c);
         }
     }
+}
+
+void handle_app_scroll(int delta) {
+    if(wifi_password_prompt) return;
+    
+    if (focused_app == APP_BROWSER && is_browser_open()) {
+        handle_browser_scroll(delta);
+    } else if (focused_app == APP_FILEMANAGER && is_filemanager_open()) {
+        handle_filemanager_scroll(delta);
+    } else if(is_filemanager_open() && !is_filemanager_minimized()) {
+        handle_filemanager_scroll(delta);
+    } else if(is_browser_open() && !is_browser_minimized()) {
+        handle_browser_scroll(delta);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include <stdint.h>
+#include <stddef.h>
+
+extern uint64_t rdtsc();
+extern uint64_t tsc_to_ns(uint64_t cycles);
+extern uint64_t tsc_hz;
+extern void uint_to_str(uint64_t n, char* buffer);
+
+#define COM1_PORT 0x3F8
+#define MAX_BOOT_PHASES 48
+
+struct BootPhase {
+    const char* name;
+    uint64_t start_tsc;
+    uint64_t end_tsc;
+};
+
+static BootPhase boot_phases[MAX_BOOT_PHASES];
+static int boot_phase_count = 0;
+static int boot_phase_printed = 0;
+static int boot_phase_open = -1;
+static uint64_t boot_tsc = 0;
+static uint64_t boot_ready_tsc = 0;
+static uint64_t boot_wait_start_tsc = 0;
+static uint64_t boot_wait_tsc = 0;
+static bool serial_ready = false;
+
+static inline void outb(uint16_t port, uint8_t val) {
+    __asm__ volatile("outb %0, %1" : : "a"(val), "Nd"(port));
+}
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t ret;
+    __asm__ volatile("inb %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+void serial_init() {
+    outb(COM1_PORT + 1, 0x00);
+    outb(COM1_PORT + 3, 0x80);
+    outb(COM1_PORT + 0, 0x01);
+    outb(COM1_PORT + 1, 0x00);
+    outb(COM1_PORT + 3, 0x03);
+    outb(COM1_PORT + 2, 0xC7);
+    outb(COM1_PORT + 4, 0x0B);
+    serial_ready = inb(COM1_PORT + 5) != 0xFF;
+}
+
+void serial_write(const char* str) {
+    if(!serial_ready) return;
+    for(; *str; str++) {
+        if(*str == '\n') {
+            while(!(inb(COM1_PORT + 5) & 0x20)) __asm__ volatile("pause");
+            outb(COM1_PORT, '\r');
+        }
+        while(!(inb(COM1_PORT + 5) & 0x20)) __asm__ volatile("pause");
+        outb(COM1_PORT, *str);
+    }
+}
+
+static void serial_write_us(uint64_t ns) {
+    char s[32];
+    uint_to_str(ns / 1000, s);
+    serial_write(s);
+    serial_write(" us");
+}
+
+static void print_pending_phases() {
+    if(!tsc_hz) return;
+    while(boot_phase_printed < boot_phase_count && boot_phases[boot_phase_printed].end_tsc) {
+        BootPhase* phase = &boot_phases[boot_phase_printed++];
+        serial_write("[boot] +");
+        serial_write_us(tsc_to_ns(phase->start_tsc - boot_tsc));
+        serial_write(" ");
+        serial_write(phase->name);
+        serial_write(": ");
+        serial_write_us(tsc_to_ns(phase->end_tsc - phase->start_tsc));
+        serial_write("\n");
+    }
+}
+
+void bootlog_start() {
+    boot_tsc = rdtsc();
+    boot_phase_count = 0;
+    boot_phase_printed = 0;
+    boot_phase_open = -1;
+}
+
+void bootlog_begin(const char* name) {
+    if(boot_phase_open >= 0 || boot_phase_count >= MAX_BOOT_PHASES) return;
+    boot_phase_open = boot_phase_count++;
+    boot_phases[boot_phase_open].name = name;
+    boot_phases[boot_phase_open].end_tsc = 0;
+    boot_phases[boot_phase_open].start_tsc = rdtsc();
+}
+
+void bootlog_end() {
+    if(boot_phase_open < 0) return;
+    boot_phases[boot_phase_open].end_tsc = rdtsc();
+    boot_phase_open = -1;
+    print_pending_phases();
+}
+
+void bootlog_wait_begin() {
+    boot_wait_start_tsc = rdtsc();
+}
+
+void bootlog_wait_end() {
+    if(!boot_wait_start_tsc) return;
+    boot_wait_tsc += rdtsc() - boot_wait_start_tsc;
+    boot_wait_start_tsc = 0;
+}
+
+void bootlog_finish() {
+    boot_ready_tsc = rdtsc();
+    if(!tsc_hz) return;
+    serial_write("[boot] desktop ready at +");
+    serial_write_us(tsc_to_ns(boot_ready_tsc - boot_tsc - boot_wait_tsc));
+    if(boot_wait_tsc) {
+        serial_write(" (plus ");
+        serial_write_us(tsc_to_ns(boot_wait_tsc));
+        serial_write(" waiting for input)");
+    }
+    serial_write("\n");
+}
+
+uint64_t bootlog_get_ready_ns() {
+    if(!boot_ready_tsc || !tsc_hz) return 0;
+    return tsc_to_ns(boot_ready_tsc - boot_tsc - boot_wait_tsc);
+}
+
+int bootlog_get_count() {
+    return boot_phase_count;
+}
+
+bool bootlog_get_entry(int index, const char** name_out, uint64_t* start_ns_out, uint64_t* duration_ns_out) {
+    if(index < 0 || index >= boot_phase_count || !boot_phases[index].end_tsc || !tsc_hz) return false;
+    *name_out = boot_phases[index].name;
+    *start_ns_out = tsc_to_ns(boot_phases[index].start_tsc - boot_tsc);
+    *duration_ns_out = tsc_to_ns(boot_phases[index].end_tsc - boot_phases[index].start_tsc);
+    return true;
+}
@@ -5,7 +5,7 @@ extern void terminal_write(const char* str);
 extern uint32_t cpu_core_count;
 extern uint64_t total_memory_kb;
 extern uint64_t free_memory_kb;
-extern uint64_t uptime_seconds;
+extern uint64_t timer_uptime_seconds();
 extern char current_directory[64];
 extern char cpu_brand_string[];
 
@@ -41,7 +41,33 @@ extern void hlpkg_unload(int package_id);
 extern int port_load_elf(const char* path);
 extern bool port_kill(uint32_t pid);
 extern int port_get_process_list(uint32_t* pid_list, int max_count);
-extern bool port_get_process_info(uint32_t pid, char* name_out, PortStatus* status_out, uint32_t* mem_out);
+extern bool port_get_process_info(uint32_t pid, char* name_out, PortStatus* status_out, uint32_t* mem_out, uint64_t* time_out);
+
+extern int heap_get_cache_count();
+extern bool heap_get_cache_info(int index, char* name_out, uint32_t* object_size_out, uint64_t* active_out,
+                                uint64_t* total_out, uint64_t* slabs_out, uint64_t* peak_out);
+extern uint64_t heap_get_used_kb();
+extern void heap_set_debug(bool enabled);
+extern bool heap_debug;
+extern uint64_t heap_large_allocs;
+extern uint64_t heap_large_pages;
+extern uint64_t heap_bad_frees;
+extern uint64_t heap_double_frees;
+extern uint64_t heap_corruptions;
+
+extern uint64_t vmm_direct_map_4k;
+extern uint64_t vmm_direct_map_2m;
+extern uint64_t vmm_direct_map_1g;
+extern int bootlog_get_count();
+extern bool bootlog_get_entry(int index, const char** name_out, uint64_t* start_ns_out, uint64_t* duration_ns_out);
+extern uint64_t bootlog_get_ready_ns();
+extern int mem_get_impl_count();
+extern bool mem_get_impl_info(int index, const char** name_out, bool* available_out, bool* active_out);
+extern void* mem_impl_copy(int index, void* dest, const void* src, size_t n);
+extern void* mem_impl_set(int index, void* dest, int c, size_t n);
+extern void* kmalloc(size_t size);
+extern void kfree(void* ptr);
+extern uint64_t clock_ns();
 
 extern void add_installed_app(const char* name, int app_type);
 extern void refresh_all_windows();
@@ -51,6 +77,8 @@ extern void* memset(void *s, int c, size_t n);
 extern size_t strlen(const char *str);
 extern int strcmp(const char *s1, const char *s2);
 extern int strncmp(const char *s1, const char *s2, size_t n);
+extern int memcmp(const void *s1, const void *s2, size_t n);
+extern void* memchr(const void *s, int c, size_t n);
 extern char* strcpy(char *dest, const char *src);
 extern char* strcat(char *dest, const char *src);
 extern void uint_to_str(uint64_t n, char* buffer);
@@ -144,25 +172,29 @@ void build_meminfo() {
     uint_to_str(free_memory_kb, tmp);
     strcat(buf, tmp);
     strcat(buf, " kB\nMemAvailable:   ");
-    uint_to_str(free_memory_kb + (total_memory_kb / 10), tmp);
+    uint_to_str(free_memory_kb, tmp);
     strcat(buf, tmp);
-    strcat(buf, " kB\nBuffers:        ");
-    uint_to_str(total_memory_kb / 50, tmp);
+    strcat(buf, " kB\nBuffers:        0 kB\nCached:         0 kB\nSwapTotal:      0 kB\nSwapFree:       0 kB\nDirectMap4k:    ");
+    uint_to_str(vmm_direct_map_4k * 4, tmp);
     strcat(buf, tmp);
-    strcat(buf, " kB\nCached:         ");
-    uint_to_str(total_memory_kb / 10, tmp);
+    strcat(buf, " kB\nDirectMap2M:    ");
+    uint_to_str(vmm_direct_map_2m * 2048, tmp);
     strcat(buf, tmp);
-    strcat(buf, " kB\nSwapTotal:      0 kB\nSwapFree:       0 kB\n");
+    strcat(buf, " kB\nDirectMap1G:    ");
+    uint_to_str(vmm_direct_map_1g * 1048576, tmp);
+    strcat(buf, tmp);
+    strcat(buf, " kB\n");
     files[14].size = strlen(buf);
 }
 
 void build_uptime() {
     char* buf = files[15].content;
     char tmp[32];
-    uint_to_str(uptime_seconds, tmp);
+    uint64_t uptime = timer_uptime_seconds();
+    uint_to_str(uptime, tmp);
     strcpy(buf, tmp);
     strcat(buf, ".00 ");
-    uint64_t idle = uptime_seconds * cpu_core_count;
+    uint64_t idle = uptime * cpu_core_count;
     uint_to_str(idle, tmp);
     strcat(buf, tmp);
     strcat(buf, ".00\n");
@@ -179,7 +211,7 @@ void build_loadavg() {
     char* buf = files[17].content;
     strcpy(buf, "0.00 0.01 0.05 1/128 ");
     char tmp[32];
-    uint_to_str(uptime_seconds % 1000 + 100, tmp);
+    uint_to_str(timer_uptime_seconds() % 1000 + 100, tmp);
     strcat(buf, tmp);
     strcat(buf, "\n");
     files[17].size = strlen(buf);
@@ -188,17 +220,18 @@ void build_loadavg() {
 void build_stat() {
     char* buf = files[18].content;
     char tmp[32];
+    uint64_t uptime = timer_uptime_seconds();
     strcpy(buf, "cpu  ");
-    uint_to_str(uptime_seconds * 10, tmp);
+    uint_to_str(uptime * 10, tmp);
     strcat(buf, tmp);
     strcat(buf, " 0 ");
-    uint_to_str(uptime_seconds * 5, tmp);
+    uint_to_str(uptime * 5, tmp);
     strcat(buf, tmp);
     strcat(buf, " ");
-    uint_to_str(uptime_seconds * 1000, tmp);
+    uint_to_str(uptime * 1000, tmp);
     strcat(buf, tmp);
     strcat(buf, " 0 0 0 0 0 0\nprocesses ");
-    uint_to_str(uptime_seconds / 10 + 150, tmp);
+    uint_to_str(uptime / 10 + 150, tmp);
     strcat(buf, tmp);
     strcat(buf, "\nprocs_running 1\nprocs_blocked 0\n");
     files[18].size = strlen(buf);
@@ -225,9 +258,10 @@ void cmd_fetch(void) {
     terminal_write(" Disks:     ");
     uint_to_str(disk_count, s); terminal_write(s); terminal_write(" detected\n");
     terminal_write(" Uptime:    ");
-    uint_to_str(uptime_seconds / 3600, s); terminal_write(s); terminal_write("h ");
-    uint_to_str((uptime_seconds % 3600) / 60, s); terminal_write(s); terminal_write("m ");
-    uint_to_str(uptime_seconds % 60, s); terminal_write(s); terminal_write("s\n");
+    uint64_t uptime = timer_uptime_seconds();
+    uint_to_str(uptime / 3600, s); terminal_write(s); terminal_write("h ");
+    uint_to_str((uptime % 3600) / 60, s); terminal_write(s); terminal_write("m ");
+    uint_to_str(uptime % 60, s); terminal_write(s); terminal_write("s\n");
     terminal_write(" hlpkg:     ");
     uint_to_str(hlpkg_get_package_count(), s); terminal_write(s); terminal_write(" packages, ");
     uint_to_str(hlpkg_get_running_count(), s); terminal_write(s); terminal_write(" running\n");
@@ -493,11 +527,8 @@ void cmd_free(const char* arg) {
         terminal_write("Mi      ");
         uint_to_str(free_memory_kb / 1024, s);
         terminal_write(s);
-        terminal_write("Mi        0Mi     ");
-        uint_to_str((total_memory_kb / 10) / 1024, s);
-        terminal_write(s);
-        terminal_write("Mi      ");
-        uint_to_str((free_memory_kb + total_memory_kb / 10) / 1024, s);
+        terminal_write("Mi        0Mi         0Mi      ");
+        uint_to_str(free_memory_kb / 1024, s);
         terminal_write(s);
         terminal_write("Mi\n");
     } else {
@@ -510,17 +541,26 @@ void cmd_free(const char* arg) {
         terminal_write("     ");
         uint_to_str(free_memory_kb, s);
         terminal_write(s);
-        terminal_write("         0       ");
-        uint_to_str(total_memory_kb / 10, s);
-        terminal_write(s);
-        terminal_write("     ");
-        uint_to_str(free_memory_kb + total_memory_kb / 10, s);
+        terminal_write("         0           0     ");
+        uint_to_str(free_memory_kb, s);
         terminal_write(s);
         terminal_write("\n");
     }
     terminal_write("Swap:              0           0           0\n");
 }
 
+static void write_cpu_time(uint64_t ns) {
+    char s[32];
+    uint64_t seconds = ns / 1000000000ULL;
+    uint64_t fields[3] = { seconds / 3600, (seconds / 60) % 60, seconds % 60 };
+    for(int f = 0; f < 3; f++) {
+        if(fields[f] < 10) terminal_write("0");
+        uint_to_str(fields[f], s);
+        terminal_write(s);
+        terminal_write(f < 2 ? ":" : " ");
+    }
+}
+
 void cmd_ps(void) {
     terminal_write("  PID TTY          TIME CMD\n");
     
@@ -537,7 +577,8 @@ void cmd_ps(void) {
             terminal_write(" ");
             uint_to_str(hlpkg_pids[i], s);
             terminal_write(s);
-            terminal_write(" tty0     00:00:00 ");
+            terminal_write(" tty0     ");
+            write_cpu_time(time);
             terminal_write(name);
             terminal_write("\n");
         }
@@ -550,11 +591,13 @@ void cmd_ps(void) {
         char name[64];
         PortStatus status;
         uint32_t mem;
-        if(port_get_process_info(port_pids[i], name, &status, &mem)) {
+        uint64_t time;
+        if(port_get_process_info(port_pids[i], name, &status, &mem, &time)) {
             terminal_write(" ");
             uint_to_str(port_pids[i], s);
             terminal_write(s);
-            terminal_write(" tty0     00:00:00 ");
+            terminal_write(" tty0     ");
+            write_cpu_time(time);
             terminal_write(name);
             terminal_write(" (port)\n");
         }
@@ -746,12 +789,467 @@ void cmd_ports(const char* arg) {
     }
 }
 
+static void write_padded(const char* str, int width) {
+    terminal_write(str);
+    for(int i = strlen(str); i < width; i++) terminal_write(" ");
+}
+
+static void write_padded_uint(uint64_t n, int width) {
+    char s[24];
+    uint_to_str(n, s);
+    write_padded(s, width);
+}
+
+void cmd_slabinfo(const char* arg) {
+    if(arg && strcmp(arg, "debug on") == 0) {
+        heap_set_debug(true);
+        terminal_write("slabinfo: heap debugging enabled\n");
+        return;
+    }
+    if(arg && strcmp(arg, "debug off") == 0) {
+        heap_set_debug(false);
+        terminal_write("slabinfo: heap debugging disabled\n");
+        return;
+    }
+    if(arg && strlen(arg)) {
+        terminal_write("Usage: slabinfo [debug on|debug off]\n");
+        return;
+    }
+
+    terminal_write("name              objsize  active   total    peak     slabs\n");
+    int count = heap_get_cache_count();
+    for(int i = 0; i < count; i++) {
+        char name[24];
+        uint32_t object_size;
+        uint64_t active, total, slabs, peak;
+        if(!heap_get_cache_info(i, name, &object_size, &active, &total, &slabs, &peak)) continue;
+        write_padded(name, 18);
+        write_padded_uint(object_size, 9);
+        write_padded_uint(active, 9);
+        write_padded_uint(total, 9);
+        write_padded_uint(peak, 9);
+        write_padded_uint(slabs, 0);
+        terminal_write("\n");
+    }
+
+    char s[24];
+    terminal_write("large allocations: ");
+    uint_to_str(heap_large_allocs, s); terminal_write(s);
+    terminal_write(" (");
+    uint_to_str(heap_large_pages, s); terminal_write(s);
+    terminal_write(" pages)\nheap total: ");
+    uint_to_str(heap_get_used_kb(), s); terminal_write(s);
+    terminal_write(" kB\ndebug: ");
+    terminal_write(heap_debug ? "on" : "off");
+    terminal_write("  bad frees: ");
+    uint_to_str(heap_bad_frees, s); terminal_write(s);
+    terminal_write("  double frees: ");
+    uint_to_str(heap_double_frees, s); terminal_write(s);
+    terminal_write("  corruptions: ");
+    uint_to_str(heap_corruptions, s); terminal_write(s);
+    terminal_write("\n");
+}
+
+void cmd_bootlog(void) {
+    terminal_write("PHASE                     START(us)   DURATION(us)\n");
+    int count = bootlog_get_count();
+    for(int i = 0; i < count; i++) {
+        const char* name;
+        uint64_t start, duration;
+        if(!bootlog_get_entry(i, &name, &start, &duration)) continue;
+        write_padded(name, 26);
+        write_padded_uint(start / 1000, 12);
+        write_padded_uint(duration / 1000, 0);
+        terminal_write("\n");
+    }
+    uint64_t ready = bootlog_get_ready_ns();
+    if(ready) {
+        terminal_write("Desktop ready at ");
+        char s[24];
+        uint_to_str(ready / 1000, s);
+        terminal_write(s);
+        terminal_write(" us\n");
+    }
+}
+
+#define MEMBENCH_BUFFER_SIZE (1024 * 1024)
+#define MEMBENCH_BYTES (32ULL * 1024 * 1024)
+
+static const size_t membench_sizes[] = {64, 512, 4096, 65536, MEMBENCH_BUFFER_SIZE};
+
+static void membench_table(const char* title, bool copy, uint8_t* dst, uint8_t* src) {
+    int count = mem_get_impl_count();
+    write_padded(title, 10);
+    for(int i = 0; i < count; i++) {
+        const char* name;
+        bool available, active;
+        mem_get_impl_info(i, &name, &available, &active);
+        write_padded(name, 10);
+    }
+    terminal_write("\n");
+
+    for(size_t s = 0; s < sizeof(membench_sizes) / sizeof(membench_sizes[0]); s++) {
+        size_t size = membench_sizes[s];
+        uint64_t iterations = MEMBENCH_BYTES / size;
+        write_padded_uint(size, 10);
+        for(int i = 0; i < count; i++) {
+            const char* name;
+            bool available, active;
+            mem_get_impl_info(i, &name, &available, &active);
+            if(!available) {
+                write_padded("-", 10);
+                continue;
+            }
+            uint64_t start = clock_ns();
+            for(uint64_t n = 0; n < iterations; n++) {
+                if(copy) mem_impl_copy(i, dst, src, size);
+                else mem_impl_set(i, dst, (int)n, size);
+            }
+            uint64_t elapsed = clock_ns() - start;
+            if(elapsed == 0) elapsed = 1;
+            write_padded_uint(iterations * size * 1000 / elapsed, 10);
+        }
+        terminal_write("\n");
+    }
+}
+
+void cmd_membench(void) {
+    uint8_t* src = (uint8_t*)kmalloc(MEMBENCH_BUFFER_SIZE);
+    uint8_t* dst = (uint8_t*)kmalloc(MEMBENCH_BUFFER_SIZE);
+    if(!src || !dst) {
+        terminal_write("membench: out of memory\n");
+        if(src) kfree(src);
+        if(dst) kfree(dst);
+        return;
+    }
+    for(size_t i = 0; i < MEMBENCH_BUFFER_SIZE; i++) src[i] = (uint8_t)i;
+
+    terminal_write("Throughput in MB/s per block size\n");
+    membench_table("memcpy", true, dst, src);
+    membench_table("memset", false, dst, src);
+
+    int count = mem_get_impl_count();
+    for(int i = 0; i < count; i++) {
+        const char* name;
+        bool available, active;
+        mem_get_impl_info(i, &name, &available, &active);
+        if(!active) continue;
+        terminal_write("Active implementation: ");
+        terminal_write(name);
+        terminal_write("\n");
+    }
+    kfree(src);
+    kfree(dst);
+}
+
+extern void compositor_set_rate(uint32_t hz);
+extern uint32_t compositor_get_rate();
+
+void cmd_fps(const char* arg) {
+    if(arg && strlen(arg)) {
+        uint32_t hz = 0;
+        for(const char* p = arg; *p; p++) {
+            if(*p < '0' || *p > '9' || hz > 100000) {
+                terminal_write("Usage: fps [rate in Hz]\n");
+                return;
+            }
+            hz = hz * 10 + (*p - '0');
+        }
+        compositor_set_rate(hz);
+    }
+    char s[16];
+    uint_to_str(compositor_get_rate(), s);
+    terminal_write("Frame rate: ");
+    terminal_write(s);
+    terminal_write(" Hz\n");
+}
+
+#define RASTERBENCH_FRAMES 32
+
+extern bool in_gui_mode;
+extern uint64_t fb_width;
+extern uint64_t fb_height;
+extern uint32_t gfx_raster_worker_count();
+extern const char* gfx_raster_disabled_reason();
+extern uint32_t gfx_raster_set_workers(uint32_t count);
+extern void compositor_redraw_all();
+extern const char* pixel_impl_name();
+
+static uint64_t rasterbench_run(uint32_t workers) {
+    gfx_raster_set_workers(workers);
+    compositor_redraw_all();
+    uint64_t start = clock_ns();
+    for(int i = 0; i < RASTERBENCH_FRAMES; i++) compositor_redraw_all();
+    return (clock_ns() - start) / RASTERBENCH_FRAMES;
+}
+
+static void rasterbench_line(uint32_t cores, uint64_t ns) {
+    char s[24];
+    uint_to_str(cores, s);
+    terminal_write(" ");
+    terminal_write(s);
+    terminal_write(cores == 1 ? " core:  " : " cores: ");
+    uint_to_str(ns / 1000, s);
+    terminal_write(s);
+    terminal_write(" us/frame\n");
+}
+
+void cmd_rasterbench(void) {
+    if(!in_gui_mode) {
+        terminal_write("rasterbench: desktop is not running\n");
+        return;
+    }
+    uint32_t workers = gfx_raster_worker_count();
+    char s[24];
+    terminal_write("Full-frame composite ");
+    uint_to_str(fb_width, s);
+    terminal_write(s);
+    terminal_write("x");
+    uint_to_str(fb_height, s);
+    terminal_write(s);
+    terminal_write(", ");
+    terminal_write(pixel_impl_name());
+    terminal_write(" pixel kernels\n");
+
+    uint32_t saved = gfx_raster_set_workers(0);
+    uint64_t single = rasterbench_run(0);
+    rasterbench_line(1, single);
+    if(workers) {
+        uint64_t parallel = rasterbench_run(workers);
+        rasterbench_line(workers + 1, parallel);
+        if(parallel) {
+            uint64_t speedup = single * 100 / parallel;
+            terminal_write(" Speedup: ");
+            uint_to_str(speedup / 100, s);
+            terminal_write(s);
+            terminal_write(".");
+            s[0] = '0' + (speedup % 100) / 10;
+            s[1] = '0' + speedup % 10;
+            s[2] = 0;
+            terminal_write(s);
+            terminal_write("x\n");
+        }
+    } else {
+        terminal_write(" No raster workers (");
+        terminal_write(gfx_raster_disabled_reason());
+        terminal_write(")\n");
+    }
+    gfx_raster_set_workers(saved);
+}
+
+#define GFXBENCH_FRAMES 100
+#define GFXBENCH_SWING 10
+
+enum AppID {
+    APP_NONE = 0,
+    APP_TERMINAL = 1,
+    APP_BROWSER = 2,
+    APP_FILEMANAGER = 3
+};
+
+extern uint64_t rdtsc();
+extern uint64_t tsc_to_ns(uint64_t cycles);
+extern void serial_write(const char* str);
+extern bool get_window_rect(AppID app, int* x, int* y, int* w, int* h);
+extern bool move_window(AppID app, int x, int y);
+extern void refresh_window(AppID app);
+extern bool compositor_frame_now();
+extern void compositor_set_hud(bool enabled);
+extern bool compositor_hud_enabled();
+extern void gfx_flush();
+extern void handle_browser_scroll(int delta);
+extern void handle_filemanager_scroll(int delta);
+extern bool viewer_open;
+
+struct GfxBenchScenario {
+    const char* name;
+    bool (*ready)();
+    void (*step)(int frame);
+};
+
+static uint64_t gfxbench_cycles[GFXBENCH_FRAMES];
+static AppID gfxbench_drag_app = APP_NONE;
+static int gfxbench_drag_x = 0;
+static int gfxbench_drag_y = 0;
+
+static int gfxbench_direction(int frame) {
+    return (frame / GFXBENCH_SWING) % 2 ? 1 : -1;
+}
+
+static bool window_visible(AppID app) {
+    int x, y, w, h;
+    return get_window_rect(app, &x, &y, &w, &h);
+}
+
+static bool gfxbench_always() {
+    return true;
+}
+
+static void gfxbench_full_repaint(int) {
+    refresh_window(APP_TERMINAL);
+    refresh_window(APP_BROWSER);
+    refresh_window(APP_FILEMANAGER);
+}
+
+static bool gfxbench_drag_ready() {
+    static const AppID candidates[] = {APP_TERMINAL, APP_BROWSER, APP_FILEMANAGER};
+    for(size_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); i++) {
+        int w, h;
+        if(!get_window_rect(candidates[i], &gfxbench_drag_x, &gfxbench_drag_y, &w, &h)) continue;
+        if(!move_window(candidates[i], gfxbench_drag_x, gfxbench_drag_y)) continue;
+        gfxbench_drag_app = candidates[i];
+        return true;
+    }
+    return false;
+}
+
+static void gfxbench_window_drag(int frame) {
+    int offset = (frame % (GFXBENCH_SWING * 2)) * 4;
+    if(offset > GFXBENCH_SWING * 4) offset = GFXBENCH_SWING * 8 - offset;
+    move_window(gfxbench_drag_app, gfxbench_drag_x + offset, gfxbench_drag_y + offset / 2);
+}
+
+static bool gfxbench_terminal_ready() {
+    return window_visible(APP_TERMINAL);
+}
+
+static void gfxbench_terminal_scroll(int frame) {
+    char s[24];
+    uint_to_str(frame, s);
+    terminal_write("gfxbench scroll ");
+    terminal_write(s);
+    terminal_write("\n");
+}
+
+static bool gfxbench_browser_ready() {
+    return window_visible(APP_BROWSER);
+}
+
+static void gfxbench_browser_scroll(int frame) {
+    handle_browser_scroll(gfxbench_direction(frame));
+}
+
+static bool gfxbench_file_list_ready() {
+    return window_visible(APP_FILEMANAGER) && !viewer_open;
+}
+
+static void gfxbench_file_list_scroll(int frame) {
+    handle_filemanager_scroll(gfxbench_direction(frame));
+}
+
+static const GfxBenchScenario gfxbench_scenarios[] = {
+    {"full repaint", gfxbench_always, gfxbench_full_repaint},
+    {"window drag", gfxbench_drag_ready, gfxbench_window_drag},
+    {"terminal scroll", gfxbench_terminal_ready, gfxbench_terminal_scroll},
+    {"browser scroll", gfxbench_browser_ready, gfxbench_browser_scroll},
+    {"file list scroll", gfxbench_file_list_ready, gfxbench_file_list_scroll},
+};
+
+static void gfxbench_run(const GfxBenchScenario* scenario) {
+    scenario->step(0);
+    compositor_frame_now();
+    gfx_flush();
+    for(int i = 0; i < GFXBENCH_FRAMES; i++) {
+        uint64_t start = rdtsc();
+        scenario->step(i + 1);
+        compositor_frame_now();
+        gfx_flush();
+        gfxbench_cycles[i] = rdtsc() - start;
+    }
+}
+
+static void gfxbench_serial_stat(const char* label, uint64_t cycles) {
+    char s[24];
+    serial_write(label);
+    uint_to_str(cycles, s);
+    serial_write(s);
+    serial_write(" cyc / ");
+    uint_to_str(tsc_to_ns(cycles) / 1000, s);
+    serial_write(s);
+    serial_write(" us");
+}
+
+static void gfxbench_terminal_stat(const char* label, uint64_t cycles) {
+    char s[24];
+    terminal_write(label);
+    uint_to_str(tsc_to_ns(cycles) / 1000, s);
+    terminal_write(s);
+    terminal_write(" us");
+}
+
+static void gfxbench_report(const char* name) {
+    for(int i = 1; i < GFXBENCH_FRAMES; i++) {
+        uint64_t value = gfxbench_cycles[i];
+        int j = i;
+        for(; j > 0 && gfxbench_cycles[j - 1] > value; j--) gfxbench_cycles[j] = gfxbench_cycles[j - 1];
+        gfxbench_cycles[j] = value;
+    }
+    uint64_t total = 0;
+    for(int i = 0; i < GFXBENCH_FRAMES; i++) total += gfxbench_cycles[i];
+    uint64_t min = gfxbench_cycles[0];
+    uint64_t avg = total / GFXBENCH_FRAMES;
+    uint64_t p99 = gfxbench_cycles[(GFXBENCH_FRAMES - 1) * 99 / 100];
+
+    serial_write("[gfxbench] ");
+    serial_write(name);
+    gfxbench_serial_stat(": min ", min);
+    gfxbench_serial_stat(", avg ", avg);
+    gfxbench_serial_stat(", p99 ", p99);
+    serial_write("\n");
+
+    terminal_write(" ");
+    terminal_write(name);
+    for(size_t pad = strlen(name); pad < 18; pad++) terminal_write(" ");
+    gfxbench_terminal_stat("min ", min);
+    gfxbench_terminal_stat("  avg ", avg);
+    gfxbench_terminal_stat("  p99 ", p99);
+    terminal_write("\n");
+}
+
+void cmd_gfxbench(const char* arg) {
+    if(!in_gui_mode) {
+        terminal_write("gfxbench: desktop is not running\n");
+        return;
+    }
+    if(arg && strcmp(arg, "hud") == 0) {
+        compositor_set_hud(!compositor_hud_enabled());
+        terminal_write(compositor_hud_enabled() ? "Frame-time overlay on\n" : "Frame-time overlay off\n");
+        return;
+    }
+    if(arg && strlen(arg)) {
+        terminal_write("Usage: gfxbench [hud]\n");
+        return;
+    }
+
+    char s[24];
+    uint_to_str(GFXBENCH_FRAMES, s);
+    terminal_write("Frame times over ");
+    terminal_write(s);
+    terminal_write(" frames, cycle counts on serial\n");
+    for(size_t i = 0; i < sizeof(gfxbench_scenarios) / sizeof(gfxbench_scenarios[0]); i++) {
+        const GfxBenchScenario* scenario = &gfxbench_scenarios[i];
+        if(!scenario->ready()) {
+            terminal_write(" ");
+            terminal_write(scenario->name);
+            terminal_write(": skipped, window not shown\n");
+            continue;
+        }
+        gfxbench_run(scenario);
+        gfxbench_report(scenario->name);
+    }
+    if(gfxbench_drag_app != APP_NONE) {
+        move_window(gfxbench_drag_app, gfxbench_drag_x, gfxbench_drag_y);
+        gfxbench_drag_app = APP_NONE;
+    }
+}
+
 void cmd_help(void) {
     terminal_write("Available commands:\n");
-    terminal_write(" System Info:       fetch, uname, hostname, uptime\n");
+    terminal_write(" System Info:       fetch, uname, hostname, uptime, bootlog\n");
     terminal_write(" Files:             ls, cd, pwd, cat\n");
     terminal_write(" Text:              echo\n");
-    terminal_write(" Hardware:          df, free\n");
+    terminal_write(" Hardware:          df, free, slabinfo, membench\n");
+    terminal_write(" Display:           fps, rasterbench, gfxbench\n");
     terminal_write(" Processes:         ps\n");
     terminal_write(" Network:           ping\n");
     terminal_write(" Packages:          hlpkg, ports\n");
@@ -771,32 +1269,64 @@ void cmd_ping(const char* arg) {
     terminal_write(output);
 }
 
+struct ShellCommand {
+    const char* name;
+    void (*run)();
+    void (*run_arg)(const char* arg);
+    bool needs_arg;
+};
+
+static const ShellCommand shell_commands[] = {
+    {"fetch", cmd_fetch, nullptr, false},
+    {"ls", nullptr, cmd_ls, false},
+    {"cd", nullptr, cmd_cd, false},
+    {"pwd", cmd_pwd, nullptr, false},
+    {"cat", nullptr, cmd_cat, true},
+    {"echo", nullptr, cmd_echo, true},
+    {"whoami", cmd_whoami, nullptr, false},
+    {"hostname", cmd_hostname, nullptr, false},
+    {"uname", nullptr, cmd_uname, false},
+    {"df", cmd_df, nullptr, false},
+    {"free", nullptr, cmd_free, false},
+    {"ping", nullptr, cmd_ping, true},
+    {"ps", cmd_ps, nullptr, false},
+    {"bootlog", cmd_bootlog, nullptr, false},
+    {"membench", cmd_membench, nullptr, false},
+    {"hlpkg", nullptr, cmd_hlpkg, false},
+    {"ports", nullptr, cmd_ports, false},
+    {"slabinfo", nullptr, cmd_slabinfo, false},
+    {"fps", nullptr, cmd_fps, false},
+    {"rasterbench", cmd_rasterbench, nullptr, false},
+    {"gfxbench", nullptr, cmd_gfxbench, false},
+    {"help", cmd_help, nullptr, false},
+};
+
+static bool run_shell_command(const char* name, size_t name_len, const char* arg) {
+    for(size_t i = 0; i < sizeof(shell_commands) / sizeof(shell_commands[0]); i++) {
+        const ShellCommand* command = &shell_commands[i];
+        if(strlen(command->name) != name_len || memcmp(command->name, name, name_len) != 0) continue;
+        if(arg) {
+            if(!command->run_arg) return false;
+            command->run_arg(arg);
+        } else if(command->run) {
+            command->run();
+        } else {
+            if(command->needs_arg) return false;
+            command->run_arg(0);
+        }
+        return true;
+    }
+    return false;
+}
+
 void process_command(const char* cmd) {
-    if(strcmp(cmd, "fetch") == 0) cmd_fetch();
-    else if(strcmp(cmd, "ls") == 0) cmd_ls(0);
-    else if(strncmp(cmd, "ls ", 3) == 0) cmd_ls(cmd + 3);
-    else if(strcmp(cmd, "cd") == 0) cmd_cd(0);
-    else if(strncmp(cmd, "cd ", 3) == 0) cmd_cd(cmd + 3);
-    else if(strcmp(cmd, "pwd") == 0) cmd_pwd();
-    else if(strncmp(cmd, "cat ", 4) == 0) cmd_cat(cmd + 4);
-    else if(strncmp(cmd, "echo ", 5) == 0) cmd_echo(cmd + 5);
-    else if(strcmp(cmd, "whoami") == 0) cmd_whoami();
-    else if(strcmp(cmd, "hostname") == 0) cmd_hostname();
-    else if(strcmp(cmd, "uname") == 0) cmd_uname(0);
-    else if(strncmp(cmd, "uname ", 6) == 0) cmd_uname(cmd + 6);
-    else if(strcmp(cmd, "df") == 0) cmd_df();
-    else if(strcmp(cmd, "free") == 0) cmd_free(0);
-    else if(strncmp(cmd, "free ", 5) == 0) cmd_free(cmd + 5);
-    else if(strncmp(cmd, "ping ", 5) == 0) cmd_ping(cmd + 5);
-    else if(strcmp(cmd, "ps") == 0) cmd_ps();
-    else if(strcmp(cmd, "hlpkg") == 0) cmd_hlpkg(0);
-    else if(strncmp(cmd, "hlpkg ", 6) == 0) cmd_hlpkg(cmd + 6);
-    else if(strcmp(cmd, "ports") == 0) cmd_ports(0);
-    else if(strncmp(cmd, "ports ", 6) == 0) cmd_ports(cmd + 6);
-    else if(strcmp(cmd, "help") == 0) cmd_help();
-    else if(strcmp(cmd, "") != 0) {
+    size_t len = strlen(cmd);
+    if(len == 0) return;
+    const char* space = (const char*)memchr(cmd, ' ', len);
+    size_t name_len = space ? (size_t)(space - cmd) : len;
+    if(!run_shell_command(cmd, name_len, space ? space + 1 : nullptr)) {
         terminal_write("bash: ");
         terminal_write(cmd);
         terminal_write(": command not found\n");
     }
-}
\ No newline at end of file
+}
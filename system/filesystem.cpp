@@ -8,7 +8,7 @@ extern int strcmp(const char *s1, const char *s2);
 extern int strncmp(const char *s1, const char *s2, size_t n);
 extern char* strcpy(char *dest, const char *src);
 extern char* strcat(char *dest, const char *src);
-extern uint64_t uptime_seconds;
+extern uint64_t timer_uptime_seconds();
 
 #define MAX_FILES 256
 #define MAX_PATH 256
@@ -58,8 +58,8 @@ int create_node(const char* path, const char* name, FileType type, const char* c
     strcpy(filesystem[idx].path, path);
     filesystem[idx].type = type;
     filesystem[idx].permissions = 0755;
-    filesystem[idx].created_time = uptime_seconds;
-    filesystem[idx].modified_time = uptime_seconds;
+    filesystem[idx].created_time = timer_uptime_seconds();
+    filesystem[idx].modified_time = timer_uptime_seconds();
     filesystem[idx].parent_index = parent_idx;
     
     if(content && type == FILE_REGULAR) {
@@ -317,7 +317,7 @@ bool write_file_content(const char* path, const char* content) {
     }
     filesystem[idx].content[len] = '\0';
     filesystem[idx].size = len;
-    filesystem[idx].modified_time = uptime_seconds;
+    filesystem[idx].modified_time = timer_uptime_seconds();
     
     return true;
 }
@@ -412,7 +412,7 @@ bool rename_file_in_fs(const char* old_path, const char* new_name) {
     
     strcpy(filesystem[idx].name, new_name);
     strcpy(filesystem[idx].path, new_path);
-    filesystem[idx].modified_time = uptime_seconds;
+    filesystem[idx].modified_time = timer_uptime_seconds();
     
     return true;
 }
\ No newline at end of file
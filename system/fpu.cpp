@@ -0,0 +1,177 @@
+#include <stdint.h>
+#include <stddef.h>
+
+extern void* memset(void *s, int c, size_t n);
+extern void* kmalloc(size_t size);
+extern void kfree(void* ptr);
+
+#define CR0_MP (1ULL << 1)
+#define CR0_EM (1ULL << 2)
+#define CR0_TS (1ULL << 3)
+#define CR0_NE (1ULL << 5)
+#define CR4_OSFXSR (1ULL << 9)
+#define CR4_OSXMMEXCPT (1ULL << 10)
+#define CR4_OSXSAVE (1ULL << 18)
+#define XCR0_X87 (1ULL << 0)
+#define XCR0_SSE (1ULL << 1)
+#define XCR0_AVX (1ULL << 2)
+#define FXSAVE_SIZE 512
+#define FPU_MAX_STATE_SIZE 4096
+#define FPU_DEFAULT_FCW 0x037F
+#define FPU_DEFAULT_MXCSR 0x1F80
+
+bool fpu_ready = false;
+bool fpu_has_xsave = false;
+bool fpu_has_xsaveopt = false;
+bool fpu_has_avx = false;
+bool fpu_has_avx2 = false;
+uint64_t fpu_xcr0 = 0;
+uint32_t fpu_state_size = FXSAVE_SIZE;
+
+static uint8_t fpu_default_state[FPU_MAX_STATE_SIZE] __attribute__((aligned(64)));
+
+static inline void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t* eax, uint32_t* ebx, uint32_t* ecx, uint32_t* edx) {
+    __asm__ volatile("cpuid" : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx) : "a"(leaf), "c"(subleaf));
+}
+
+static inline uint64_t read_cr0() {
+    uint64_t value;
+    __asm__ volatile("mov %%cr0, %0" : "=r"(value));
+    return value;
+}
+
+static inline void write_cr0(uint64_t value) {
+    __asm__ volatile("mov %0, %%cr0" : : "r"(value) : "memory");
+}
+
+static inline uint64_t read_cr4() {
+    uint64_t value;
+    __asm__ volatile("mov %%cr4, %0" : "=r"(value));
+    return value;
+}
+
+static inline void write_cr4(uint64_t value) {
+    __asm__ volatile("mov %0, %%cr4" : : "r"(value) : "memory");
+}
+
+static inline void xsetbv(uint32_t index, uint64_t value) {
+    __asm__ volatile("xsetbv" : : "c"(index), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+static void init_state_area(void* area) {
+    uint8_t* bytes = (uint8_t*)area;
+    memset(area, 0, fpu_state_size);
+    *(uint16_t*)(bytes + 0) = FPU_DEFAULT_FCW;
+    *(uint32_t*)(bytes + 24) = FPU_DEFAULT_MXCSR;
+}
+
+void fpu_set_ts() {
+    write_cr0(read_cr0() | CR0_TS);
+}
+
+void fpu_clear_ts() {
+    __asm__ volatile("clts" ::: "memory");
+}
+
+void fpu_save(void* area) {
+    uint32_t low = (uint32_t)fpu_xcr0;
+    uint32_t high = (uint32_t)(fpu_xcr0 >> 32);
+    if(fpu_has_xsaveopt) {
+        __asm__ volatile("xsaveopt64 (%0)" : : "r"(area), "a"(low), "d"(high) : "memory");
+    } else if(fpu_has_xsave) {
+        __asm__ volatile("xsave64 (%0)" : : "r"(area), "a"(low), "d"(high) : "memory");
+    } else {
+        __asm__ volatile("fxsave64 (%0)" : : "r"(area) : "memory");
+    }
+}
+
+void fpu_restore(void* area) {
+    if(!area) area = fpu_default_state;
+    uint32_t low = (uint32_t)fpu_xcr0;
+    uint32_t high = (uint32_t)(fpu_xcr0 >> 32);
+    if(fpu_has_xsave) {
+        __asm__ volatile("xrstor64 (%0)" : : "r"(area), "a"(low), "d"(high) : "memory");
+    } else {
+        __asm__ volatile("fxrstor64 (%0)" : : "r"(area) : "memory");
+    }
+}
+
+bool fpu_usable() {
+    uint64_t flags;
+    __asm__ volatile("pushfq; popq %0" : "=r"(flags));
+    return fpu_ready && (flags & 0x200);
+}
+
+void* fpu_alloc_state() {
+    if(!fpu_ready) return nullptr;
+    void* area = kmalloc(fpu_state_size);
+    if(!area) return nullptr;
+    if((uint64_t)area & 63) {
+        kfree(area);
+        return nullptr;
+    }
+    init_state_area(area);
+    return area;
+}
+
+void fpu_free_state(void* area) {
+    kfree(area);
+}
+
+void fpu_init_cpu() {
+    write_cr0((read_cr0() & ~CR0_EM) | CR0_MP | CR0_NE);
+    uint64_t cr4 = read_cr4() | CR4_OSFXSR | CR4_OSXMMEXCPT;
+    if(fpu_has_xsave) cr4 |= CR4_OSXSAVE;
+    write_cr4(cr4);
+    if(fpu_has_xsave) xsetbv(0, fpu_xcr0);
+
+    fpu_clear_ts();
+    fpu_restore(fpu_default_state);
+    fpu_set_ts();
+}
+
+bool fpu_init() {
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, 0, &eax, &ebx, &ecx, &edx);
+    if(!((edx >> 25) & 1) || !((edx >> 26) & 1)) return false;
+    fpu_has_xsave = (ecx >> 26) & 1;
+    bool cpu_avx = (ecx >> 28) & 1;
+
+    fpu_xcr0 = XCR0_X87 | XCR0_SSE;
+    if(fpu_has_xsave) {
+        cpuid(0xD, 0, &eax, &ebx, &ecx, &edx);
+        if(cpu_avx && (eax & XCR0_AVX)) fpu_xcr0 |= XCR0_AVX;
+        cpuid(0xD, 1, &eax, &ebx, &ecx, &edx);
+        fpu_has_xsaveopt = eax & 1;
+    }
+    fpu_has_avx = (fpu_xcr0 & XCR0_AVX) != 0;
+
+    cpuid(0, 0, &eax, &ebx, &ecx, &edx);
+    if(eax >= 7 && fpu_has_avx) {
+        cpuid(7, 0, &eax, &ebx, &ecx, &edx);
+        fpu_has_avx2 = (ebx >> 5) & 1;
+    }
+
+    fpu_state_size = FXSAVE_SIZE;
+    init_state_area(fpu_default_state);
+    fpu_init_cpu();
+
+    if(fpu_has_xsave) {
+        cpuid(0xD, 0, &eax, &ebx, &ecx, &edx);
+        if(ebx > FPU_MAX_STATE_SIZE) {
+            fpu_has_xsave = false;
+            fpu_has_xsaveopt = false;
+            fpu_has_avx = false;
+            fpu_has_avx2 = false;
+            fpu_xcr0 = XCR0_X87 | XCR0_SSE;
+            write_cr4(read_cr4() & ~CR4_OSXSAVE);
+        } else {
+            fpu_state_size = ebx;
+            init_state_area(fpu_default_state);
+        }
+    }
+
+    fpu_clear_ts();
+    fpu_ready = true;
+    return true;
+}
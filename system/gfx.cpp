@@ -0,0 +1,740 @@
+#include <stdint.h>
+#include <stddef.h>
+
+extern uint32_t* fb_ptr;
+extern uint64_t fb_width;
+extern uint64_t fb_height;
+extern uint64_t fb_pitch;
+
+extern void* memcpy(void *dest, const void *src, size_t n);
+extern void* kmalloc(size_t size);
+extern void kfree(void* ptr);
+extern void serial_write(const char* str);
+extern bool fpu_usable();
+extern void pixel_copy(uint32_t* dst, const uint32_t* src, int count);
+extern void pixel_copy_key(uint32_t* dst, const uint32_t* src, int count, uint32_t key);
+extern void pixel_over(uint32_t* dst, const uint32_t* src, int count);
+extern uint32_t smp_cpu_count;
+extern bool smp_cpu_online(uint32_t index);
+extern uint32_t smp_current_cpu();
+extern uint32_t sched_create_thread(const char* name, void (*entry)(void* arg), void* arg, int affinity);
+extern uint32_t sched_prepare_wait();
+extern void sched_sleep_ns(uint64_t ns);
+extern bool sched_wake(uint32_t id);
+
+#define GFX_MAX_DAMAGE 32
+#define CURSOR_W 11
+#define CURSOR_H 16
+#define CURSOR_KEY 0xFF00FF
+#define BLEND_SPAN 64
+
+#define RASTER_TILE_W 256
+#define RASTER_TILE_H 64
+#define RASTER_TILE_BITS 12
+#define RASTER_MAX_TILES (1 << RASTER_TILE_BITS)
+#define RASTER_MAX_COMMANDS 4096
+#define RASTER_MAX_REFS 32768
+#define RASTER_MAX_WORKERS 64
+#define RASTER_MIN_PIXELS (256 * 1024)
+#define RASTER_SLEEP_FOREVER 0xFFFFFFFFFFFFFFFFULL
+
+typedef long long v16 __attribute__((vector_size(16), may_alias));
+typedef long long v16u __attribute__((vector_size(16), may_alias, aligned(1)));
+typedef long long aliased_i64 __attribute__((may_alias));
+
+struct GfxRect {
+    int x0, y0, x1, y1;
+};
+
+struct GfxSurface {
+    uint32_t* pixels;
+    int width;
+    int height;
+};
+
+uint32_t* gfx_buffer = 0;
+uint64_t gfx_stride = 0;
+int gfx_origin_x = 0;
+int gfx_origin_y = 0;
+GfxRect gfx_clip = {0, 0, 0, 0};
+
+static bool gfx_back_buffer = false;
+static GfxRect damage[GFX_MAX_DAMAGE];
+static int damage_count = 0;
+
+static const uint16_t cursor_shape[CURSOR_H] = {
+    0b1100000000000000,
+    0b1110000000000000,
+    0b1111000000000000,
+    0b1111100000000000,
+    0b1111110000000000,
+    0b1111111000000000,
+    0b1111111100000000,
+    0b1111111110000000,
+    0b1111111111000000,
+    0b1111111000000000,
+    0b1110110000000000,
+    0b1100011000000000,
+    0b1000001100000000,
+    0b0000001100000000,
+    0b0000000110000000,
+    0b0000000000000000
+};
+
+static uint32_t cursor_sprite[CURSOR_H][CURSOR_W];
+static int cursor_x = 0;
+static int cursor_y = 0;
+static bool cursor_visible = false;
+static uint32_t cursor_under[CURSOR_H][CURSOR_W];
+static bool cursor_painted = false;
+
+static GfxRect target_bounds = {0, 0, 0, 0};
+static bool target_is_surface = false;
+static uint32_t* screen_buffer = 0;
+static uint64_t screen_stride = 0;
+
+enum RasterOp {
+    RASTER_FILL,
+    RASTER_BLEND_FILL,
+    RASTER_BLIT,
+    RASTER_BLEND,
+    RASTER_GLYPH
+};
+
+struct RasterCommand {
+    int op;
+    GfxRect rect;
+    uint32_t color;
+    const void* source;
+    int source_x;
+    int source_y;
+    int source_stride;
+};
+
+struct RasterBin {
+    uint32_t batch;
+    int first;
+    int last;
+};
+
+bool gfx_recording = false;
+static bool raster_active = false;
+static RasterCommand raster_commands[RASTER_MAX_COMMANDS];
+static int raster_command_count = 0;
+static int raster_ref_command[RASTER_MAX_REFS];
+static int raster_ref_next[RASTER_MAX_REFS];
+static int raster_ref_count = 0;
+static RasterBin raster_bins[RASTER_MAX_TILES];
+static int raster_tiles[RASTER_MAX_TILES];
+static int raster_tile_count = 0;
+static int raster_tile_cols = 0;
+static int raster_tile_rows = 0;
+static uint32_t raster_batch = 1;
+static uint32_t raster_sequence = 0;
+
+static uint32_t raster_worker_ids[RASTER_MAX_WORKERS];
+static uint32_t raster_worker_count = 0;
+static uint32_t raster_worker_limit = 0;
+static const char* raster_disabled = "not initialized";
+static uint32_t raster_job = 0;
+static uint64_t raster_ticket = 0;
+static uint32_t raster_tiles_done = 0;
+
+static void set_screen_target() {
+    gfx_buffer = screen_buffer;
+    gfx_stride = screen_stride;
+    gfx_origin_x = 0;
+    gfx_origin_y = 0;
+    target_bounds.x0 = 0;
+    target_bounds.y0 = 0;
+    target_bounds.x1 = fb_width;
+    target_bounds.y1 = fb_height;
+    target_is_surface = false;
+    gfx_recording = raster_active;
+}
+
+void gfx_reset_clip() {
+    gfx_clip = target_bounds;
+}
+
+void gfx_set_clip(int x, int y, int w, int h) {
+    gfx_clip.x0 = x < target_bounds.x0 ? target_bounds.x0 : x;
+    gfx_clip.y0 = y < target_bounds.y0 ? target_bounds.y0 : y;
+    gfx_clip.x1 = x + w > target_bounds.x1 ? target_bounds.x1 : x + w;
+    gfx_clip.y1 = y + h > target_bounds.y1 ? target_bounds.y1 : y + h;
+}
+
+bool gfx_clip_rect(int* x, int* y, int* w, int* h) {
+    int x0 = *x < gfx_clip.x0 ? gfx_clip.x0 : *x;
+    int y0 = *y < gfx_clip.y0 ? gfx_clip.y0 : *y;
+    int x1 = *x + *w > gfx_clip.x1 ? gfx_clip.x1 : *x + *w;
+    int y1 = *y + *h > gfx_clip.y1 ? gfx_clip.y1 : *y + *h;
+    if(x0 >= x1 || y0 >= y1) return false;
+    *x = x0;
+    *y = y0;
+    *w = x1 - x0;
+    *h = y1 - y0;
+    return true;
+}
+
+static bool rects_touch(const GfxRect* a, const GfxRect* b) {
+    return a->x0 <= b->x1 && b->x0 <= a->x1 && a->y0 <= b->y1 && b->y0 <= a->y1;
+}
+
+static void rect_union(GfxRect* a, const GfxRect* b) {
+    if(b->x0 < a->x0) a->x0 = b->x0;
+    if(b->y0 < a->y0) a->y0 = b->y0;
+    if(b->x1 > a->x1) a->x1 = b->x1;
+    if(b->y1 > a->y1) a->y1 = b->y1;
+}
+
+static void add_damage(GfxRect rect) {
+
+    for(int i = 0; i < damage_count; i++) {
+        if(!rects_touch(&damage[i], &rect)) continue;
+        rect_union(&rect, &damage[i]);
+        damage[i] = damage[--damage_count];
+        i = -1;
+    }
+    if(damage_count == GFX_MAX_DAMAGE) {
+        for(int i = 1; i < damage_count; i++) rect_union(&damage[0], &damage[i]);
+        rect_union(&rect, &damage[0]);
+        damage_count = 0;
+    }
+    damage[damage_count++] = rect;
+}
+
+void gfx_damage(int x, int y, int w, int h) {
+    if(!gfx_back_buffer || target_is_surface) return;
+    if(!gfx_clip_rect(&x, &y, &w, &h)) return;
+    GfxRect rect = {x, y, x + w, y + h};
+    add_damage(rect);
+}
+
+static bool cursor_screen_rect(GfxRect* rect) {
+    rect->x0 = cursor_x < 0 ? 0 : cursor_x;
+    rect->y0 = cursor_y < 0 ? 0 : cursor_y;
+    rect->x1 = cursor_x + CURSOR_W > (int)fb_width ? (int)fb_width : cursor_x + CURSOR_W;
+    rect->y1 = cursor_y + CURSOR_H > (int)fb_height ? (int)fb_height : cursor_y + CURSOR_H;
+    return rect->x0 < rect->x1 && rect->y0 < rect->y1;
+}
+
+static void paint_cursor(uint32_t* base, uint64_t stride) {
+    GfxRect rect;
+    if(!cursor_screen_rect(&rect)) return;
+    for(int y = rect.y0; y < rect.y1; y++) {
+        int dy = y - cursor_y;
+        if(!cursor_shape[dy]) continue;
+        pixel_copy_key(base + y * stride + rect.x0, &cursor_sprite[dy][rect.x0 - cursor_x], rect.x1 - rect.x0, CURSOR_KEY);
+    }
+}
+
+static void copy_cursor_rows(bool save) {
+    GfxRect rect;
+    if(!cursor_screen_rect(&rect)) return;
+    int w = (rect.x1 - rect.x0) * 4;
+    for(int y = rect.y0; y < rect.y1; y++) {
+        uint32_t* screen = screen_buffer + y * screen_stride + rect.x0;
+        uint32_t* under = &cursor_under[y - cursor_y][rect.x0 - cursor_x];
+        if(save) memcpy(under, screen, w);
+        else memcpy(screen, under, w);
+    }
+}
+
+void gfx_lift_cursor() {
+    if(!cursor_painted) return;
+    copy_cursor_rows(false);
+    cursor_painted = false;
+}
+
+void gfx_set_cursor(int x, int y) {
+    if(cursor_visible && x == cursor_x && y == cursor_y && (gfx_back_buffer || cursor_painted)) return;
+    GfxRect rect;
+    if(!gfx_back_buffer) {
+        gfx_lift_cursor();
+        cursor_x = x;
+        cursor_y = y;
+        cursor_visible = true;
+        copy_cursor_rows(true);
+        paint_cursor(screen_buffer, screen_stride);
+        cursor_painted = true;
+        return;
+    }
+    if(cursor_visible && cursor_screen_rect(&rect)) add_damage(rect);
+    cursor_x = x;
+    cursor_y = y;
+    cursor_visible = true;
+    if(cursor_screen_rect(&rect)) add_damage(rect);
+}
+
+static void fill_span_words(uint32_t* dst, int count, uint32_t color) {
+    if(((uintptr_t)dst & 7) && count > 0) {
+        *dst++ = color;
+        count--;
+    }
+    uint64_t words = count >> 1;
+    uint64_t pattern = ((uint64_t)color << 32) | color;
+    __asm__ volatile("rep stosq" : "+D"(dst), "+c"(words) : "a"(pattern) : "memory");
+    if(count & 1) *dst = color;
+}
+
+__attribute__((target("sse2")))
+static void fill_span_sse2(uint32_t* dst, int count, uint32_t color) {
+    while(((uintptr_t)dst & 15) && count > 0) {
+        *dst++ = color;
+        count--;
+    }
+    long long pattern = (long long)(((uint64_t)color << 32) | color);
+    v16 value = {pattern, pattern};
+    while(count >= 16) {
+        *(v16*)(dst + 0) = value;
+        *(v16*)(dst + 4) = value;
+        *(v16*)(dst + 8) = value;
+        *(v16*)(dst + 12) = value;
+        dst += 16; count -= 16;
+    }
+    while(count >= 4) {
+        *(v16*)dst = value;
+        dst += 4; count -= 4;
+    }
+    while(count-- > 0) *dst++ = color;
+}
+
+static void blend_fill_rows(uint32_t* row, uint64_t stride, int w, int h, uint32_t color) {
+    uint32_t span[BLEND_SPAN];
+    fill_span_words(span, BLEND_SPAN, color);
+    for(int y = 0; y < h; y++, row += stride) {
+        for(int x = 0; x < w; x += BLEND_SPAN) pixel_over(row + x, span, w - x < BLEND_SPAN ? w - x : BLEND_SPAN);
+    }
+}
+
+static void blit_rows(int op, uint32_t* dst, uint64_t dst_stride, const uint32_t* src, int src_stride, int w, int h) {
+    for(int y = 0; y < h; y++, dst += dst_stride, src += src_stride) {
+        if(op == RASTER_BLIT) pixel_copy(dst, src, w);
+        else pixel_over(dst, src, w);
+    }
+}
+
+static void raster_run_command(const RasterCommand* cmd, const GfxRect* tile) {
+    int x0 = cmd->rect.x0 > tile->x0 ? cmd->rect.x0 : tile->x0;
+    int y0 = cmd->rect.y0 > tile->y0 ? cmd->rect.y0 : tile->y0;
+    int x1 = cmd->rect.x1 < tile->x1 ? cmd->rect.x1 : tile->x1;
+    int y1 = cmd->rect.y1 < tile->y1 ? cmd->rect.y1 : tile->y1;
+    if(x0 >= x1 || y0 >= y1) return;
+    int w = x1 - x0;
+    uint32_t* row = screen_buffer + y0 * screen_stride + x0;
+    if(cmd->op == RASTER_FILL) {
+        bool simd = w >= 16 && fpu_usable();
+        for(int y = y0; y < y1; y++, row += screen_stride) {
+            if(simd) fill_span_sse2(row, w, cmd->color);
+            else fill_span_words(row, w, cmd->color);
+        }
+    } else if(cmd->op == RASTER_BLEND_FILL) {
+        blend_fill_rows(row, screen_stride, w, y1 - y0, cmd->color);
+    } else if(cmd->op != RASTER_GLYPH) {
+        const uint32_t* src = (const uint32_t*)cmd->source + (y0 - cmd->source_y) * cmd->source_stride + (x0 - cmd->source_x);
+        blit_rows(cmd->op, row, screen_stride, src, cmd->source_stride, w, y1 - y0);
+    } else {
+        const uint8_t* bits = (const uint8_t*)cmd->source;
+        for(int y = y0; y < y1; y++, row += screen_stride) {
+            uint8_t line = bits[y - cmd->source_y];
+            if(!line) continue;
+            for(int x = x0; x < x1; x++) {
+                if((line >> (7 - (x - cmd->source_x))) & 1) row[x - x0] = cmd->color;
+            }
+        }
+    }
+}
+
+static void raster_run_tile(int index) {
+    int tile = raster_tiles[index];
+    GfxRect bounds;
+    bounds.x0 = (tile % raster_tile_cols) * RASTER_TILE_W;
+    bounds.y0 = (tile / raster_tile_cols) * RASTER_TILE_H;
+    bounds.x1 = bounds.x0 + RASTER_TILE_W > (int)fb_width ? (int)fb_width : bounds.x0 + RASTER_TILE_W;
+    bounds.y1 = bounds.y0 + RASTER_TILE_H > (int)fb_height ? (int)fb_height : bounds.y0 + RASTER_TILE_H;
+    for(int ref = raster_bins[tile].first; ref >= 0; ref = raster_ref_next[ref]) {
+        raster_run_command(&raster_commands[raster_ref_command[ref]], &bounds);
+    }
+}
+
+static bool raster_claim(uint32_t job, int* index) {
+    uint32_t count = job & (RASTER_MAX_TILES - 1);
+    uint64_t ticket = __atomic_load_n(&raster_ticket, __ATOMIC_ACQUIRE);
+    while((uint32_t)(ticket >> 32) == job && (uint32_t)ticket < count) {
+        if(__atomic_compare_exchange_n(&raster_ticket, &ticket, ticket + 1, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            *index = (int)(uint32_t)ticket;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void raster_work(uint32_t job) {
+    int index;
+    while(raster_claim(job, &index)) {
+        raster_run_tile(index);
+        __atomic_fetch_add(&raster_tiles_done, 1, __ATOMIC_RELEASE);
+    }
+}
+
+static void raster_worker(void*) {
+    uint32_t seen = 0;
+    while(true) {
+        sched_prepare_wait();
+        uint32_t job = __atomic_load_n(&raster_job, __ATOMIC_ACQUIRE);
+        if(job == seen) {
+            sched_sleep_ns(RASTER_SLEEP_FOREVER);
+            continue;
+        }
+        seen = job;
+        raster_work(job);
+    }
+}
+
+static void raster_reset() {
+    raster_command_count = 0;
+    raster_ref_count = 0;
+    raster_tile_count = 0;
+    raster_batch++;
+}
+
+static void raster_execute() {
+    if(raster_tile_count == 0) {
+        raster_reset();
+        return;
+    }
+    raster_sequence++;
+    uint32_t count = raster_tile_count;
+    uint32_t job = (raster_sequence << RASTER_TILE_BITS) | count;
+    __atomic_store_n(&raster_tiles_done, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&raster_ticket, (uint64_t)job << 32, __ATOMIC_RELEASE);
+    __atomic_store_n(&raster_job, job, __ATOMIC_RELEASE);
+
+    uint32_t helpers = raster_worker_limit < count - 1 ? raster_worker_limit : count - 1;
+    for(uint32_t i = 0; i < helpers; i++) sched_wake(raster_worker_ids[i]);
+    raster_work(job);
+    while(__atomic_load_n(&raster_tiles_done, __ATOMIC_ACQUIRE) != count) __asm__ volatile("pause");
+    raster_reset();
+}
+
+static RasterCommand* raster_record(int op, int x0, int y0, int x1, int y1) {
+    int tx0 = x0 / RASTER_TILE_W, tx1 = (x1 - 1) / RASTER_TILE_W;
+    int ty0 = y0 / RASTER_TILE_H, ty1 = (y1 - 1) / RASTER_TILE_H;
+    int refs = (tx1 - tx0 + 1) * (ty1 - ty0 + 1);
+    if(raster_command_count == RASTER_MAX_COMMANDS || raster_ref_count + refs > RASTER_MAX_REFS) raster_execute();
+
+    int index = raster_command_count++;
+    RasterCommand* cmd = &raster_commands[index];
+    cmd->op = op;
+    cmd->rect.x0 = x0;
+    cmd->rect.y0 = y0;
+    cmd->rect.x1 = x1;
+    cmd->rect.y1 = y1;
+    for(int ty = ty0; ty <= ty1; ty++) {
+        for(int tx = tx0; tx <= tx1; tx++) {
+            int tile = ty * raster_tile_cols + tx;
+            RasterBin* bin = &raster_bins[tile];
+            int ref = raster_ref_count++;
+            raster_ref_command[ref] = index;
+            raster_ref_next[ref] = -1;
+            if(bin->batch != raster_batch) {
+                bin->batch = raster_batch;
+                bin->first = ref;
+                raster_tiles[raster_tile_count++] = tile;
+            } else {
+                raster_ref_next[bin->last] = ref;
+            }
+            bin->last = ref;
+        }
+    }
+    return cmd;
+}
+
+void gfx_record_glyph(const uint8_t* rows, int x, int y, uint32_t color) {
+    int gx = x, gy = y, w = 8, h = 8;
+    if(!gfx_clip_rect(&gx, &gy, &w, &h)) return;
+    RasterCommand* cmd = raster_record(RASTER_GLYPH, gx, gy, gx + w, gy + h);
+    cmd->color = color;
+    cmd->source = rows;
+    cmd->source_x = x;
+    cmd->source_y = y;
+}
+
+bool gfx_raster_begin(int w, int h) {
+    if(!gfx_back_buffer || target_is_surface || raster_active) return false;
+    if(!raster_worker_limit || (uint64_t)w * h < RASTER_MIN_PIXELS) return false;
+    raster_reset();
+    raster_active = true;
+    gfx_recording = true;
+    return true;
+}
+
+void gfx_raster_end() {
+    if(!raster_active) return;
+    raster_execute();
+    raster_active = false;
+    gfx_recording = false;
+}
+
+void gfx_raster_cancel() {
+    raster_reset();
+    raster_active = false;
+    gfx_recording = false;
+}
+
+uint32_t gfx_raster_worker_count() {
+    return raster_worker_count;
+}
+
+uint32_t gfx_raster_set_workers(uint32_t count) {
+    uint32_t previous = raster_worker_limit;
+    raster_worker_limit = count < raster_worker_count ? count : raster_worker_count;
+    return previous;
+}
+
+const char* gfx_raster_disabled_reason() {
+    return raster_worker_count ? nullptr : raster_disabled;
+}
+
+void gfx_raster_init() {
+    raster_tile_cols = (fb_width + RASTER_TILE_W - 1) / RASTER_TILE_W;
+    raster_tile_rows = (fb_height + RASTER_TILE_H - 1) / RASTER_TILE_H;
+    if(!gfx_back_buffer) {
+        raster_disabled = "no back buffer";
+        return;
+    }
+    if(raster_tile_cols * raster_tile_rows >= RASTER_MAX_TILES) {
+        raster_disabled = "framebuffer exceeds the tile grid";
+        return;
+    }
+    uint32_t self = smp_current_cpu();
+    uint32_t others = 0;
+    for(uint32_t cpu = 0; cpu < smp_cpu_count && raster_worker_count < RASTER_MAX_WORKERS; cpu++) {
+        if(cpu == self || !smp_cpu_online(cpu)) continue;
+        others++;
+        uint32_t id = sched_create_thread("raster", raster_worker, nullptr, cpu);
+        if(id) raster_worker_ids[raster_worker_count++] = id;
+    }
+    raster_worker_limit = raster_worker_count;
+    raster_disabled = others ? "worker threads could not be created" : "single CPU";
+}
+
+void gfx_fill_rect(int x, int y, int w, int h, uint32_t color) {
+    if(!gfx_clip_rect(&x, &y, &w, &h)) return;
+    gfx_damage(x, y, w, h);
+    if(gfx_recording) {
+        raster_record(RASTER_FILL, x, y, x + w, y + h)->color = color;
+        return;
+    }
+    uint32_t* row = gfx_buffer + (y - gfx_origin_y) * gfx_stride + (x - gfx_origin_x);
+    if(w >= 16 && fpu_usable()) {
+        for(int j = 0; j < h; j++, row += gfx_stride) fill_span_sse2(row, w, color);
+    } else {
+        for(int j = 0; j < h; j++, row += gfx_stride) fill_span_words(row, w, color);
+    }
+}
+
+void gfx_scroll_rect(int x, int y, int w, int h, int dy) {
+    if(!gfx_clip_rect(&x, &y, &w, &h)) return;
+    if(dy == 0 || dy >= h || -dy >= h) return;
+    if(gfx_recording) raster_execute();
+    uint32_t* base = gfx_buffer + (y - gfx_origin_y) * gfx_stride + (x - gfx_origin_x);
+    if(dy < 0) {
+        for(int row = 0; row < h + dy; row++) memcpy(base + row * gfx_stride, base + (row - dy) * gfx_stride, w * 4);
+    } else {
+        for(int row = h - 1; row >= dy; row--) memcpy(base + row * gfx_stride, base + (row - dy) * gfx_stride, w * 4);
+    }
+    gfx_damage(x, y, w, h);
+}
+
+void gfx_clear(uint32_t color) {
+    if(target_is_surface) return;
+    GfxRect saved = gfx_clip;
+    gfx_reset_clip();
+    gfx_fill_rect(0, 0, fb_width, fb_height, color);
+    gfx_clip = saved;
+}
+
+static inline void stream_u32(uint32_t* dst, uint32_t value) {
+    __asm__ volatile("movnti %1, %0" : "=m"(*dst) : "r"(value));
+}
+
+static inline void stream_u64(uint32_t* dst, uint64_t value) {
+    __asm__ volatile("movnti %1, %0" : "=m"(*(aliased_i64*)dst) : "r"(value));
+}
+
+__attribute__((target("sse2")))
+static int stream_blocks_sse2(uint32_t* dst, const uint32_t* src, int count) {
+    int done = 0;
+    for(; count - done >= 16; done += 16) {
+        v16 a = *(const v16u*)(src + done + 0);
+        v16 b = *(const v16u*)(src + done + 4);
+        v16 c = *(const v16u*)(src + done + 8);
+        v16 d = *(const v16u*)(src + done + 12);
+        __builtin_ia32_movntdq((v16*)(dst + done + 0), a);
+        __builtin_ia32_movntdq((v16*)(dst + done + 4), b);
+        __builtin_ia32_movntdq((v16*)(dst + done + 8), c);
+        __builtin_ia32_movntdq((v16*)(dst + done + 12), d);
+    }
+    return done;
+}
+
+static void flush_row(uint32_t* dst, const uint32_t* src, int count) {
+    while(((uintptr_t)dst & 15) && count > 0) {
+        stream_u32(dst, *src);
+        dst++; src++; count--;
+    }
+    if(count >= 16 && fpu_usable()) {
+        int done = stream_blocks_sse2(dst, src, count);
+        dst += done; src += done; count -= done;
+    }
+    while(count >= 2) {
+        stream_u64(dst, *(const aliased_i64*)src);
+        dst += 2; src += 2; count -= 2;
+    }
+    if(count) stream_u32(dst, *src);
+}
+
+void gfx_flush() {
+    if(!gfx_back_buffer || damage_count == 0) return;
+    uint64_t fb_stride = fb_pitch / 4;
+    for(int i = 0; i < damage_count; i++) {
+        GfxRect* r = &damage[i];
+        int width = r->x1 - r->x0;
+        for(int y = r->y0; y < r->y1; y++) {
+            flush_row(fb_ptr + y * fb_stride + r->x0, screen_buffer + y * screen_stride + r->x0, width);
+        }
+    }
+    GfxRect cursor;
+    if(cursor_visible && cursor_screen_rect(&cursor)) {
+        for(int i = 0; i < damage_count; i++) {
+            if(damage[i].x0 < cursor.x1 && cursor.x0 < damage[i].x1 && damage[i].y0 < cursor.y1 && cursor.y0 < damage[i].y1) {
+                paint_cursor(fb_ptr, fb_stride);
+                break;
+            }
+        }
+    }
+    __asm__ volatile("sfence" ::: "memory");
+    damage_count = 0;
+}
+
+bool gfx_surface_resize(GfxSurface* surface, int w, int h) {
+    if(w <= 0 || h <= 0) return false;
+    if(surface->pixels && surface->width == w && surface->height == h) return true;
+    if(surface->pixels) kfree(surface->pixels);
+    surface->pixels = (uint32_t*)kmalloc((uint64_t)w * h * 4);
+    surface->width = surface->pixels ? w : 0;
+    surface->height = surface->pixels ? h : 0;
+    return surface->pixels != nullptr;
+}
+
+void gfx_surface_free(GfxSurface* surface) {
+    if(surface->pixels) kfree(surface->pixels);
+    surface->pixels = nullptr;
+    surface->width = 0;
+    surface->height = 0;
+}
+
+void gfx_begin_surface(GfxSurface* surface, int origin_x, int origin_y) {
+    gfx_buffer = surface->pixels;
+    gfx_stride = surface->width;
+    gfx_origin_x = origin_x;
+    gfx_origin_y = origin_y;
+    target_bounds.x0 = origin_x;
+    target_bounds.y0 = origin_y;
+    target_bounds.x1 = origin_x + surface->width;
+    target_bounds.y1 = origin_y + surface->height;
+    target_is_surface = true;
+    gfx_recording = false;
+    gfx_reset_clip();
+}
+
+void gfx_end_surface() {
+    if(!target_is_surface) return;
+    set_screen_target();
+    gfx_reset_clip();
+}
+
+static void draw_surface(const GfxSurface* surface, int x, int y, int op) {
+    if(!surface->pixels) return;
+    int dx = x, dy = y, w = surface->width, h = surface->height;
+    if(!gfx_clip_rect(&dx, &dy, &w, &h)) return;
+    gfx_damage(dx, dy, w, h);
+    if(gfx_recording) {
+        RasterCommand* cmd = raster_record(op, dx, dy, dx + w, dy + h);
+        cmd->source = surface->pixels;
+        cmd->source_x = x;
+        cmd->source_y = y;
+        cmd->source_stride = surface->width;
+        return;
+    }
+    const uint32_t* src = surface->pixels + (dy - y) * surface->width + (dx - x);
+    uint32_t* dst = gfx_buffer + (dy - gfx_origin_y) * gfx_stride + (dx - gfx_origin_x);
+    blit_rows(op, dst, gfx_stride, src, surface->width, w, h);
+}
+
+void gfx_blit_surface(const GfxSurface* surface, int x, int y) {
+    draw_surface(surface, x, y, RASTER_BLIT);
+}
+
+void gfx_blend_surface(const GfxSurface* surface, int x, int y) {
+    draw_surface(surface, x, y, RASTER_BLEND);
+}
+
+void gfx_blend_rect(int x, int y, int w, int h, uint32_t color, uint8_t alpha) {
+    if(alpha == 0xFF) {
+        gfx_fill_rect(x, y, w, h, color);
+        return;
+    }
+    if(!gfx_clip_rect(&x, &y, &w, &h)) return;
+    gfx_damage(x, y, w, h);
+    uint32_t rb = (color & 0x00FF00FF) * alpha + 0x00800080;
+    uint32_t g = (color & 0x0000FF00) * alpha + 0x00008000;
+    rb = ((rb + ((rb >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+    g = ((g + ((g >> 8) & 0x0000FF00)) >> 8) & 0x0000FF00;
+    uint32_t premultiplied = ((uint32_t)alpha << 24) | rb | g;
+    if(gfx_recording) {
+        raster_record(RASTER_BLEND_FILL, x, y, x + w, y + h)->color = premultiplied;
+        return;
+    }
+    uint32_t* row = gfx_buffer + (y - gfx_origin_y) * gfx_stride + (x - gfx_origin_x);
+    blend_fill_rows(row, gfx_stride, w, h, premultiplied);
+}
+
+static void build_cursor_sprite() {
+    for(int dy = 0; dy < CURSOR_H; dy++) {
+        for(int dx = 0; dx < CURSOR_W; dx++) {
+            if(!((cursor_shape[dy] >> (15 - dx)) & 1)) cursor_sprite[dy][dx] = CURSOR_KEY;
+            else cursor_sprite[dy][dx] = (dx == 0 || dy == 0) ? 0x000000 : 0xFFFFFF;
+        }
+    }
+}
+
+void gfx_init_early() {
+    build_cursor_sprite();
+    screen_buffer = fb_ptr;
+    screen_stride = fb_pitch / 4;
+    set_screen_target();
+    gfx_back_buffer = false;
+    damage_count = 0;
+    gfx_reset_clip();
+}
+
+bool gfx_init() {
+    uint32_t* buffer = (uint32_t*)kmalloc(fb_width * fb_height * 4);
+    if(!buffer) {
+        serial_write("[gfx] back buffer allocation failed, drawing to the framebuffer directly\n");
+        return false;
+    }
+
+    gfx_lift_cursor();
+    uint64_t fb_stride = fb_pitch / 4;
+    for(uint64_t y = 0; y < fb_height; y++) memcpy(buffer + y * fb_width, fb_ptr + y * fb_stride, fb_width * 4);
+    screen_buffer = buffer;
+    screen_stride = fb_width;
+    set_screen_target();
+    gfx_back_buffer = true;
+    damage_count = 0;
+    return true;
+}
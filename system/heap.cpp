@@ -0,0 +1,520 @@
+#include <stdint.h>
+#include <stddef.h>
+
+extern void* memcpy(void *dest, const void *src, size_t n);
+extern void* memset(void *s, int c, size_t n);
+extern size_t strlen(const char *str);
+extern char* strcpy(char *dest, const char *src);
+extern char* strcat(char *dest, const char *src);
+extern void uint_to_str(uint64_t n, char* buffer);
+extern uint64_t pmm_alloc_pages(int order);
+extern void pmm_free_pages(uint64_t phys, int order);
+extern uint64_t pmm_alloc_contiguous(uint64_t count);
+extern void pmm_free_contiguous(uint64_t phys, uint64_t count);
+extern uint64_t pmm_get_page_count();
+extern void* phys_to_virt(uint64_t phys);
+extern uint64_t virt_to_phys(const void* virt);
+extern uint64_t spin_lock_irqsave(uint32_t* lock);
+extern void spin_unlock_irqrestore(uint32_t* lock, uint64_t flags);
+extern void* vmm_alloc(uint64_t size);
+extern void vmm_free(void* ptr, uint64_t size);
+
+#define PAGE_SIZE 4096
+#define PAGE_SHIFT 12
+#define SLAB_ORDER 2
+#define SLAB_SIZE (PAGE_SIZE << SLAB_ORDER)
+#define SLAB_HEADER_SIZE 64
+#define LARGE_HEADER_SIZE 64
+#define SLAB_MAGIC 0x534C4142
+#define LARGE_MAGIC 0x4C415247
+#define VMALLOC_MAGIC 0x564D414C
+#define VMALLOC_BASE 0xFFFFC90000000000ULL
+#define VMALLOC_SIZE (64ULL << 30)
+#define PMM_MAX_ORDER 10
+#define MAX_CACHES 32
+#define KMALLOC_MIN_SHIFT 4
+#define KMALLOC_MAX_SHIFT 11
+#define KMALLOC_CLASSES (KMALLOC_MAX_SHIFT - KMALLOC_MIN_SHIFT + 1)
+#define POISON_FREE 0x6B
+#define POISON_ALLOC 0xA5
+
+#define PAGE_KIND_NONE 0
+#define PAGE_KIND_SLAB 1
+#define PAGE_KIND_LARGE 2
+
+struct KmemCache;
+
+struct Slab {
+    uint32_t magic;
+    uint32_t in_use;
+    uint32_t capacity;
+    uint32_t reserved;
+    KmemCache* cache;
+    Slab* next;
+    Slab* prev;
+    void* free_list;
+};
+
+struct KmemCache {
+    char name[24];
+    uint32_t object_size;
+    uint32_t objects_per_slab;
+    Slab* partial;
+    Slab* full;
+    Slab* empty;
+    uint64_t slab_count;
+    uint64_t active_objects;
+    uint64_t peak_objects;
+    uint64_t alloc_count;
+    uint64_t free_count;
+    uint32_t lock;
+};
+
+struct LargeHeader {
+    uint32_t magic;
+    uint32_t pages;
+    uint64_t size;
+};
+
+static KmemCache caches[MAX_CACHES];
+static int cache_count = 0;
+static uint32_t cache_table_lock = 0;
+static KmemCache* kmalloc_caches[KMALLOC_CLASSES];
+static uint8_t* page_kind = nullptr;
+static uint64_t page_kind_count = 0;
+
+bool heap_ready = false;
+bool heap_debug = false;
+uint64_t heap_large_allocs = 0;
+uint64_t heap_large_pages = 0;
+uint64_t heap_bad_frees = 0;
+uint64_t heap_double_frees = 0;
+uint64_t heap_corruptions = 0;
+
+static void set_page_kind(uint64_t phys, uint64_t pages, uint8_t kind) {
+    uint64_t pfn = phys >> PAGE_SHIFT;
+    for(uint64_t i = 0; i < pages && pfn + i < page_kind_count; i++) {
+        page_kind[pfn + i] = kind;
+    }
+}
+
+static uint8_t get_page_kind(const void* ptr) {
+    uint64_t pfn = virt_to_phys(ptr) >> PAGE_SHIFT;
+    if(pfn >= page_kind_count) return PAGE_KIND_NONE;
+    return page_kind[pfn];
+}
+
+static void slab_list_push(Slab** head, Slab* slab) {
+    slab->prev = nullptr;
+    slab->next = *head;
+    if(*head) (*head)->prev = slab;
+    *head = slab;
+}
+
+static void slab_list_remove(Slab** head, Slab* slab) {
+    if(slab->prev) slab->prev->next = slab->next;
+    else *head = slab->next;
+    if(slab->next) slab->next->prev = slab->prev;
+    slab->next = nullptr;
+    slab->prev = nullptr;
+}
+
+static uint8_t* slab_objects(Slab* slab) {
+    return (uint8_t*)slab + SLAB_HEADER_SIZE;
+}
+
+static void poison_object(KmemCache* cache, void* obj) {
+    if(cache->object_size > sizeof(void*)) {
+        memset((uint8_t*)obj + sizeof(void*), POISON_FREE, cache->object_size - sizeof(void*));
+    }
+}
+
+static void check_poison(KmemCache* cache, void* obj) {
+    uint8_t* bytes = (uint8_t*)obj;
+    for(uint32_t i = sizeof(void*); i < cache->object_size; i++) {
+        if(bytes[i] != POISON_FREE) {
+            heap_corruptions++;
+            return;
+        }
+    }
+}
+
+static Slab* slab_create(KmemCache* cache) {
+    uint64_t phys = pmm_alloc_pages(SLAB_ORDER);
+    if(!phys) return nullptr;
+
+    Slab* slab = (Slab*)phys_to_virt(phys);
+    slab->magic = SLAB_MAGIC;
+    slab->in_use = 0;
+    slab->capacity = cache->objects_per_slab;
+    slab->cache = cache;
+    slab->next = nullptr;
+    slab->prev = nullptr;
+    slab->free_list = nullptr;
+
+    uint8_t* objects = slab_objects(slab);
+    for(int i = slab->capacity - 1; i >= 0; i--) {
+        void* obj = objects + (uint64_t)i * cache->object_size;
+        *(void**)obj = slab->free_list;
+        slab->free_list = obj;
+        if(heap_debug) poison_object(cache, obj);
+    }
+
+    set_page_kind(phys, 1 << SLAB_ORDER, PAGE_KIND_SLAB);
+    cache->slab_count++;
+    return slab;
+}
+
+static void slab_destroy(Slab* slab) {
+    uint64_t phys = virt_to_phys(slab);
+    slab->cache->slab_count--;
+    slab->magic = 0;
+    set_page_kind(phys, 1 << SLAB_ORDER, PAGE_KIND_NONE);
+    pmm_free_pages(phys, SLAB_ORDER);
+}
+
+KmemCache* kmem_cache_create(const char* name, uint32_t object_size) {
+    if(object_size == 0) return nullptr;
+
+    object_size = (object_size + 15) & ~15u;
+    if(object_size > SLAB_SIZE - SLAB_HEADER_SIZE) return nullptr;
+
+    uint64_t flags = spin_lock_irqsave(&cache_table_lock);
+    if(cache_count >= MAX_CACHES) {
+        spin_unlock_irqrestore(&cache_table_lock, flags);
+        return nullptr;
+    }
+    KmemCache* cache = &caches[cache_count];
+    memset(cache, 0, sizeof(KmemCache));
+    int len = strlen(name);
+    if(len > (int)sizeof(cache->name) - 1) len = sizeof(cache->name) - 1;
+    memcpy(cache->name, name, len);
+    cache->name[len] = '\0';
+    cache->object_size = object_size;
+    cache->objects_per_slab = (SLAB_SIZE - SLAB_HEADER_SIZE) / object_size;
+    __atomic_store_n(&cache_count, cache_count + 1, __ATOMIC_RELEASE);
+    spin_unlock_irqrestore(&cache_table_lock, flags);
+    return cache;
+}
+
+void* kmem_cache_alloc(KmemCache* cache) {
+    if(!cache) return nullptr;
+
+    uint64_t flags = spin_lock_irqsave(&cache->lock);
+    Slab* slab = cache->partial;
+    if(!slab) {
+        slab = cache->empty;
+        if(slab) {
+            slab_list_remove(&cache->empty, slab);
+        } else {
+            slab = slab_create(cache);
+            if(!slab) {
+                spin_unlock_irqrestore(&cache->lock, flags);
+                return nullptr;
+            }
+        }
+        slab_list_push(&cache->partial, slab);
+    }
+
+    void* obj = slab->free_list;
+    slab->free_list = *(void**)obj;
+    slab->in_use++;
+    if(slab->in_use == slab->capacity) {
+        slab_list_remove(&cache->partial, slab);
+        slab_list_push(&cache->full, slab);
+    }
+
+    cache->alloc_count++;
+    cache->active_objects++;
+    if(cache->active_objects > cache->peak_objects) cache->peak_objects = cache->active_objects;
+
+    if(heap_debug) {
+        check_poison(cache, obj);
+        memset(obj, POISON_ALLOC, cache->object_size);
+    }
+    spin_unlock_irqrestore(&cache->lock, flags);
+    return obj;
+}
+
+static bool slab_owns_free(Slab* slab, void* obj) {
+    for(void* it = slab->free_list; it; it = *(void**)it) {
+        if(it == obj) return true;
+    }
+    return false;
+}
+
+static void slab_free_object(Slab* slab, void* obj) {
+    KmemCache* cache = slab->cache;
+    uint64_t offset = (uint8_t*)obj - slab_objects(slab);
+    if((uint8_t*)obj < slab_objects(slab) || offset % cache->object_size != 0 ||
+       offset / cache->object_size >= slab->capacity) {
+        heap_bad_frees++;
+        return;
+    }
+
+    uint64_t flags = spin_lock_irqsave(&cache->lock);
+    if(heap_debug && slab_owns_free(slab, obj)) {
+        spin_unlock_irqrestore(&cache->lock, flags);
+        heap_double_frees++;
+        return;
+    }
+
+    bool was_full = slab->in_use == slab->capacity;
+    if(heap_debug) poison_object(cache, obj);
+    *(void**)obj = slab->free_list;
+    slab->free_list = obj;
+    slab->in_use--;
+    cache->free_count++;
+    cache->active_objects--;
+
+    if(was_full) {
+        slab_list_remove(&cache->full, slab);
+        slab_list_push(&cache->partial, slab);
+    }
+    if(slab->in_use == 0) {
+        slab_list_remove(&cache->partial, slab);
+        if(cache->empty) {
+            slab_destroy(slab);
+        } else {
+            slab_list_push(&cache->empty, slab);
+        }
+    }
+    spin_unlock_irqrestore(&cache->lock, flags);
+}
+
+void kmem_cache_free(KmemCache* cache, void* obj) {
+    if(!obj) return;
+    if(get_page_kind(obj) != PAGE_KIND_SLAB) {
+        heap_bad_frees++;
+        return;
+    }
+    Slab* slab = (Slab*)((uint64_t)obj & ~(uint64_t)(SLAB_SIZE - 1));
+    if(slab->magic != SLAB_MAGIC || slab->cache != cache) {
+        heap_bad_frees++;
+        return;
+    }
+    slab_free_object(slab, obj);
+}
+
+static bool is_vmalloc(const void* ptr) {
+    uint64_t addr = (uint64_t)ptr;
+    return addr >= VMALLOC_BASE && addr < VMALLOC_BASE + VMALLOC_SIZE;
+}
+
+static void* vmalloc_large(size_t size, uint64_t pages) {
+    LargeHeader* header = (LargeHeader*)vmm_alloc(pages * PAGE_SIZE);
+    if(!header) return nullptr;
+    header->magic = VMALLOC_MAGIC;
+    header->pages = pages;
+    header->size = size;
+    __atomic_fetch_add(&heap_large_allocs, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&heap_large_pages, pages, __ATOMIC_RELAXED);
+    return (uint8_t*)header + LARGE_HEADER_SIZE;
+}
+
+static LargeHeader* vmalloc_header(void* ptr) {
+    if(((uint64_t)ptr & (PAGE_SIZE - 1)) != LARGE_HEADER_SIZE) return nullptr;
+    LargeHeader* header = (LargeHeader*)((uint8_t*)ptr - LARGE_HEADER_SIZE);
+    if(header->magic != VMALLOC_MAGIC) return nullptr;
+    return header;
+}
+
+static void vmalloc_free(void* ptr) {
+    LargeHeader* header = vmalloc_header(ptr);
+    if(!header) {
+        heap_bad_frees++;
+        return;
+    }
+    uint64_t pages = header->pages;
+    header->magic = 0;
+    __atomic_fetch_sub(&heap_large_allocs, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_sub(&heap_large_pages, pages, __ATOMIC_RELAXED);
+    vmm_free(header, pages * PAGE_SIZE);
+}
+
+static void* large_alloc(size_t size) {
+    uint64_t pages = (size + LARGE_HEADER_SIZE + PAGE_SIZE - 1) / PAGE_SIZE;
+    if(pages > (1ULL << PMM_MAX_ORDER)) return vmalloc_large(size, pages);
+    uint64_t phys = pmm_alloc_contiguous(pages);
+    if(!phys) return nullptr;
+
+    LargeHeader* header = (LargeHeader*)phys_to_virt(phys);
+    header->magic = LARGE_MAGIC;
+    header->pages = pages;
+    header->size = size;
+    set_page_kind(phys, 1, PAGE_KIND_LARGE);
+    __atomic_fetch_add(&heap_large_allocs, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&heap_large_pages, pages, __ATOMIC_RELAXED);
+    return (uint8_t*)header + LARGE_HEADER_SIZE;
+}
+
+static LargeHeader* large_header(void* ptr) {
+    if(((uint64_t)ptr & (PAGE_SIZE - 1)) != LARGE_HEADER_SIZE) return nullptr;
+    LargeHeader* header = (LargeHeader*)((uint8_t*)ptr - LARGE_HEADER_SIZE);
+    if(header->magic != LARGE_MAGIC) return nullptr;
+    return header;
+}
+
+static void large_free(void* ptr) {
+    LargeHeader* header = large_header(ptr);
+    if(!header) {
+        heap_bad_frees++;
+        return;
+    }
+    uint64_t phys = virt_to_phys(header);
+    uint64_t pages = header->pages;
+    header->magic = 0;
+    set_page_kind(phys, 1, PAGE_KIND_NONE);
+    __atomic_fetch_sub(&heap_large_allocs, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_sub(&heap_large_pages, pages, __ATOMIC_RELAXED);
+    pmm_free_contiguous(phys, pages);
+}
+
+static KmemCache* kmalloc_cache_for(size_t size) {
+    int shift = KMALLOC_MIN_SHIFT;
+    while(shift <= KMALLOC_MAX_SHIFT && ((size_t)1 << shift) < size) shift++;
+    if(shift > KMALLOC_MAX_SHIFT) return nullptr;
+    return kmalloc_caches[shift - KMALLOC_MIN_SHIFT];
+}
+
+void* kmalloc(size_t size) {
+    if(!heap_ready || size == 0) return nullptr;
+    KmemCache* cache = kmalloc_cache_for(size);
+    if(cache) return kmem_cache_alloc(cache);
+    return large_alloc(size);
+}
+
+void* kzalloc(size_t size) {
+    void* ptr = kmalloc(size);
+    if(ptr) memset(ptr, 0, size);
+    return ptr;
+}
+
+size_t ksize(void* ptr) {
+    if(!ptr) return 0;
+    if(is_vmalloc(ptr)) {
+        LargeHeader* header = vmalloc_header(ptr);
+        return header ? header->pages * PAGE_SIZE - LARGE_HEADER_SIZE : 0;
+    }
+    uint8_t kind = get_page_kind(ptr);
+    if(kind == PAGE_KIND_SLAB) {
+        Slab* slab = (Slab*)((uint64_t)ptr & ~(uint64_t)(SLAB_SIZE - 1));
+        return slab->cache->object_size;
+    }
+    if(kind == PAGE_KIND_LARGE) {
+        LargeHeader* header = large_header(ptr);
+        if(header) return header->pages * PAGE_SIZE - LARGE_HEADER_SIZE;
+    }
+    return 0;
+}
+
+void kfree(void* ptr) {
+    if(!ptr) return;
+    if(is_vmalloc(ptr)) {
+        vmalloc_free(ptr);
+        return;
+    }
+    uint8_t kind = get_page_kind(ptr);
+    if(kind == PAGE_KIND_SLAB) {
+        Slab* slab = (Slab*)((uint64_t)ptr & ~(uint64_t)(SLAB_SIZE - 1));
+        if(slab->magic != SLAB_MAGIC) {
+            heap_bad_frees++;
+            return;
+        }
+        slab_free_object(slab, ptr);
+    } else if(kind == PAGE_KIND_LARGE) {
+        large_free(ptr);
+    } else {
+        heap_bad_frees++;
+    }
+}
+
+void* krealloc(void* ptr, size_t size) {
+    if(!ptr) return kmalloc(size);
+    if(size == 0) {
+        kfree(ptr);
+        return nullptr;
+    }
+
+    size_t old_size = ksize(ptr);
+    if(old_size == 0) return nullptr;
+    if(size <= old_size) return ptr;
+
+    void* new_ptr = kmalloc(size);
+    if(!new_ptr) return nullptr;
+    memcpy(new_ptr, ptr, old_size);
+    kfree(ptr);
+    return new_ptr;
+}
+
+char* kstrdup(const char* str) {
+    size_t len = strlen(str);
+    char* copy = (char*)kmalloc(len + 1);
+    if(copy) memcpy(copy, str, len + 1);
+    return copy;
+}
+
+void heap_set_debug(bool enabled) {
+    if(enabled && !heap_debug) {
+        for(int i = 0; i < cache_count; i++) {
+            Slab* lists[2] = { caches[i].partial, caches[i].empty };
+            for(int l = 0; l < 2; l++) {
+                for(Slab* slab = lists[l]; slab; slab = slab->next) {
+                    for(void* obj = slab->free_list; obj; obj = *(void**)obj) {
+                        poison_object(&caches[i], obj);
+                    }
+                }
+            }
+        }
+    }
+    heap_debug = enabled;
+}
+
+int heap_get_cache_count() {
+    return cache_count;
+}
+
+bool heap_get_cache_info(int index, char* name_out, uint32_t* object_size_out, uint64_t* active_out,
+                         uint64_t* total_out, uint64_t* slabs_out, uint64_t* peak_out) {
+    if(index < 0 || index >= cache_count) return false;
+    KmemCache* cache = &caches[index];
+    strcpy(name_out, cache->name);
+    *object_size_out = cache->object_size;
+    *active_out = cache->active_objects;
+    *total_out = cache->slab_count * cache->objects_per_slab;
+    *slabs_out = cache->slab_count;
+    *peak_out = cache->peak_objects;
+    return true;
+}
+
+uint64_t heap_get_used_kb() {
+    uint64_t pages = heap_large_pages;
+    for(int i = 0; i < cache_count; i++) {
+        pages += caches[i].slab_count << SLAB_ORDER;
+    }
+    return pages * (PAGE_SIZE / 1024);
+}
+
+bool heap_init() {
+    page_kind_count = pmm_get_page_count();
+    if(page_kind_count == 0) return false;
+
+    uint64_t pages = (page_kind_count + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint64_t phys = pmm_alloc_contiguous(pages);
+    if(!phys) return false;
+    page_kind = (uint8_t*)phys_to_virt(phys);
+    memset(page_kind, PAGE_KIND_NONE, page_kind_count);
+
+    cache_count = 0;
+    for(int i = 0; i < KMALLOC_CLASSES; i++) {
+        char name[24];
+        char size_str[16];
+        strcpy(name, "kmalloc-");
+        uint_to_str(1ULL << (KMALLOC_MIN_SHIFT + i), size_str);
+        strcat(name, size_str);
+        kmalloc_caches[i] = kmem_cache_create(name, 1 << (KMALLOC_MIN_SHIFT + i));
+    }
+
+    heap_ready = true;
+    return true;
+}
@@ -0,0 +1,160 @@
+#include <stdint.h>
+#include <stddef.h>
+
+struct InterruptFrame;
+typedef InterruptFrame* (*InterruptHandler)(InterruptFrame* frame);
+
+extern void register_interrupt_handler(uint8_t vector, InterruptHandler handler);
+extern bool ioapic_route_isa_irq(uint8_t irq, uint8_t vector, uint8_t dest_apic_id);
+extern uint32_t lapic_id();
+extern bool sched_ready;
+extern uint32_t sched_prepare_wait();
+extern void sched_sleep_ns(uint64_t ns);
+extern bool sched_wake(uint32_t id);
+extern void udelay(uint64_t us);
+
+#define IRQ_VECTOR_BASE 0x40
+#define KEYBOARD_IRQ 1
+#define MOUSE_IRQ 12
+#define SCANCODE_RING_SIZE 256
+#define MOUSE_RING_SIZE 128
+#define INPUT_POLL_NS 10000000ULL
+#define INPUT_WAIT_FOREVER 0xFFFFFFFFFFFFFFFFULL
+
+struct MousePacket {
+    uint8_t buttons;
+    int16_t dx;
+    int16_t dy;
+};
+
+struct ScancodeRing {
+    uint32_t head;
+    uint32_t tail;
+    uint8_t data[SCANCODE_RING_SIZE];
+};
+
+struct MouseRing {
+    uint32_t head;
+    uint32_t tail;
+    MousePacket data[MOUSE_RING_SIZE];
+};
+
+static ScancodeRing scancode_ring;
+static MouseRing mouse_ring;
+static uint8_t mouse_packet_bytes[3];
+static int mouse_packet_index = 0;
+
+bool input_irq_driven = false;
+uint64_t input_dropped_events = 0;
+static volatile uint32_t input_waiter = 0;
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t ret;
+    __asm__ volatile("inb %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+static void push_scancode(uint8_t scancode) {
+    uint32_t head = scancode_ring.head;
+    if(head - __atomic_load_n(&scancode_ring.tail, __ATOMIC_ACQUIRE) >= SCANCODE_RING_SIZE) {
+        input_dropped_events++;
+        return;
+    }
+    scancode_ring.data[head % SCANCODE_RING_SIZE] = scancode;
+    __atomic_store_n(&scancode_ring.head, head + 1, __ATOMIC_RELEASE);
+}
+
+static void push_mouse_byte(uint8_t byte) {
+    if(mouse_packet_index == 0 && !(byte & 0x08)) return;
+    mouse_packet_bytes[mouse_packet_index++] = byte;
+    if(mouse_packet_index < 3) return;
+    mouse_packet_index = 0;
+
+    uint32_t head = mouse_ring.head;
+    if(head - __atomic_load_n(&mouse_ring.tail, __ATOMIC_ACQUIRE) >= MOUSE_RING_SIZE) {
+        input_dropped_events++;
+        return;
+    }
+
+    uint8_t flags = mouse_packet_bytes[0];
+    MousePacket* packet = &mouse_ring.data[head % MOUSE_RING_SIZE];
+    packet->buttons = flags & 0x07;
+    packet->dx = (flags & 0x40) ? 0 : (int16_t)mouse_packet_bytes[1] - ((flags << 4) & 0x100);
+    packet->dy = (flags & 0x80) ? 0 : (int16_t)mouse_packet_bytes[2] - ((flags << 3) & 0x100);
+    __atomic_store_n(&mouse_ring.head, head + 1, __ATOMIC_RELEASE);
+}
+
+static void drain_controller() {
+    uint8_t status = inb(0x64);
+    while(status & 0x01) {
+        uint8_t b = inb(0x60);
+        if(status & 0x20) push_mouse_byte(b);
+        else push_scancode(b);
+        status = inb(0x64);
+    }
+}
+
+static InterruptFrame* controller_interrupt(InterruptFrame* frame) {
+    drain_controller();
+    uint32_t waiter = input_waiter;
+    if(waiter) sched_wake(waiter);
+    return frame;
+}
+
+void input_poll_controller() {
+    if(!input_irq_driven) drain_controller();
+}
+
+bool input_read_scancode(uint8_t* scancode) {
+    uint32_t tail = scancode_ring.tail;
+    if(tail == __atomic_load_n(&scancode_ring.head, __ATOMIC_ACQUIRE)) return false;
+    *scancode = scancode_ring.data[tail % SCANCODE_RING_SIZE];
+    __atomic_store_n(&scancode_ring.tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool input_read_mouse(MousePacket* packet) {
+    uint32_t tail = mouse_ring.tail;
+    if(tail == __atomic_load_n(&mouse_ring.head, __ATOMIC_ACQUIRE)) return false;
+    *packet = mouse_ring.data[tail % MOUSE_RING_SIZE];
+    __atomic_store_n(&mouse_ring.tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+void input_discard_mouse() {
+    __atomic_store_n(&mouse_ring.tail, __atomic_load_n(&mouse_ring.head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+}
+
+bool input_pending() {
+    return __atomic_load_n(&scancode_ring.head, __ATOMIC_ACQUIRE) != scancode_ring.tail ||
+           __atomic_load_n(&mouse_ring.head, __ATOMIC_ACQUIRE) != mouse_ring.tail;
+}
+
+void input_wait_ns(uint64_t timeout_ns) {
+    if(input_pending() || timeout_ns == 0) return;
+    if(!sched_ready) {
+        udelay((timeout_ns < INPUT_POLL_NS ? timeout_ns : INPUT_POLL_NS) / 1000);
+        return;
+    }
+    uint64_t sleep_ns = input_irq_driven ? INPUT_WAIT_FOREVER : INPUT_POLL_NS;
+    if(timeout_ns < sleep_ns) sleep_ns = timeout_ns;
+    input_waiter = sched_prepare_wait();
+    if(!input_pending()) sched_sleep_ns(sleep_ns);
+    input_waiter = 0;
+}
+
+void input_wait() {
+    input_wait_ns(INPUT_WAIT_FOREVER);
+}
+
+void input_init() {
+    while(inb(0x64) & 0x01) inb(0x60);
+
+    register_interrupt_handler(IRQ_VECTOR_BASE + KEYBOARD_IRQ, controller_interrupt);
+    register_interrupt_handler(IRQ_VECTOR_BASE + MOUSE_IRQ, controller_interrupt);
+
+    uint8_t cpu = lapic_id();
+    bool keyboard_routed = ioapic_route_isa_irq(KEYBOARD_IRQ, IRQ_VECTOR_BASE + KEYBOARD_IRQ, cpu);
+    bool mouse_routed = ioapic_route_isa_irq(MOUSE_IRQ, IRQ_VECTOR_BASE + MOUSE_IRQ, cpu);
+    input_irq_driven = keyboard_routed && mouse_routed;
+}
@@ -0,0 +1,348 @@
+#include <stdint.h>
+#include <stddef.h>
+
+extern void* memset(void *s, int c, size_t n);
+extern char* strcpy(char *dest, const char *src);
+extern char* strcat(char *dest, const char *src);
+extern void hex_to_str(uint64_t n, char* buffer);
+extern void draw_rect(int x, int y, int w, int h, uint32_t color);
+extern void draw_string(const char* str, int x, int y, uint32_t color);
+extern void gfx_reset_clip();
+extern void gfx_end_surface();
+extern void gfx_raster_cancel();
+extern void gfx_flush();
+extern void lapic_eoi();
+extern uint64_t pmm_alloc_pages(int order);
+extern void pmm_free_pages(uint64_t phys, int order);
+extern void* phys_to_virt(uint64_t phys);
+extern uint64_t fb_width;
+
+#define GDT_KERNEL_CODE 0x08
+#define GDT_KERNEL_DATA 0x10
+#define GDT_TSS 0x28
+#define GDT_ENTRIES 7
+#define IDT_ENTRIES 256
+#define IST_STACK_SIZE 16384
+#define IST_STACK_ORDER 2
+#define MAX_CPUS 64
+#define PIC_VECTOR_BASE 0x20
+#define SPURIOUS_VECTOR 0xFF
+
+struct InterruptFrame {
+    uint64_t r15, r14, r13, r12, r11, r10, r9, r8;
+    uint64_t rbp, rdi, rsi, rdx, rcx, rbx, rax;
+    uint64_t vector, error_code;
+    uint64_t rip, cs, rflags, rsp, ss;
+};
+
+struct __attribute__((packed)) TSS {
+    uint32_t reserved0;
+    uint64_t rsp[3];
+    uint64_t reserved1;
+    uint64_t ist[7];
+    uint64_t reserved2;
+    uint16_t reserved3;
+    uint16_t iomap_base;
+};
+
+struct __attribute__((packed)) IDTEntry {
+    uint16_t offset_low;
+    uint16_t selector;
+    uint8_t ist;
+    uint8_t type_attr;
+    uint16_t offset_mid;
+    uint32_t offset_high;
+    uint32_t reserved;
+};
+
+struct __attribute__((packed)) DescriptorPointer {
+    uint16_t limit;
+    uint64_t base;
+};
+
+typedef InterruptFrame* (*InterruptHandler)(InterruptFrame* frame);
+
+static uint64_t gdt[MAX_CPUS][GDT_ENTRIES];
+static TSS tss[MAX_CPUS];
+static IDTEntry idt[IDT_ENTRIES];
+static InterruptHandler interrupt_handlers[IDT_ENTRIES];
+static uint8_t double_fault_stack[IST_STACK_SIZE] __attribute__((aligned(16)));
+static uint8_t nmi_stack[IST_STACK_SIZE] __attribute__((aligned(16)));
+static uint8_t sched_stack[IST_STACK_SIZE] __attribute__((aligned(16)));
+static bool software_vectors[IDT_ENTRIES];
+
+uint64_t interrupt_counts[IDT_ENTRIES];
+
+extern "C" uint64_t isr_stub_table[IDT_ENTRIES];
+
+__asm__(
+    ".altmacro\n"
+    ".macro isr_stub num\n"
+    "isr_stub_\\num:\n"
+    "    .if (\\num == 8) || ((\\num >= 10) && (\\num <= 14)) || (\\num == 17) || (\\num == 21) || (\\num == 29) || (\\num == 30)\n"
+    "    .else\n"
+    "    pushq $0\n"
+    "    .endif\n"
+    "    pushq $\\num\n"
+    "    jmp isr_common\n"
+    ".endm\n"
+    ".macro isr_entry num\n"
+    "    .quad isr_stub_\\num\n"
+    ".endm\n"
+    ".section .text\n"
+    "isr_common:\n"
+    "    pushq %rax\n"
+    "    pushq %rbx\n"
+    "    pushq %rcx\n"
+    "    pushq %rdx\n"
+    "    pushq %rsi\n"
+    "    pushq %rdi\n"
+    "    pushq %rbp\n"
+    "    pushq %r8\n"
+    "    pushq %r9\n"
+    "    pushq %r10\n"
+    "    pushq %r11\n"
+    "    pushq %r12\n"
+    "    pushq %r13\n"
+    "    pushq %r14\n"
+    "    pushq %r15\n"
+    "    movq %rsp, %rdi\n"
+    "    cld\n"
+    "    call interrupt_dispatch\n"
+    "    movq %rax, %rsp\n"
+    "    popq %r15\n"
+    "    popq %r14\n"
+    "    popq %r13\n"
+    "    popq %r12\n"
+    "    popq %r11\n"
+    "    popq %r10\n"
+    "    popq %r9\n"
+    "    popq %r8\n"
+    "    popq %rbp\n"
+    "    popq %rdi\n"
+    "    popq %rsi\n"
+    "    popq %rdx\n"
+    "    popq %rcx\n"
+    "    popq %rbx\n"
+    "    popq %rax\n"
+    "    addq $16, %rsp\n"
+    "    iretq\n"
+    ".set vec, 0\n"
+    ".rept 256\n"
+    "    isr_stub %vec\n"
+    "    .set vec, vec + 1\n"
+    ".endr\n"
+    ".section .rodata\n"
+    ".global isr_stub_table\n"
+    ".balign 8\n"
+    "isr_stub_table:\n"
+    ".set vec, 0\n"
+    ".rept 256\n"
+    "    isr_entry %vec\n"
+    "    .set vec, vec + 1\n"
+    ".endr\n"
+    ".noaltmacro\n"
+    ".section .text\n"
+);
+
+static const char* exception_names[32] = {
+    "Divide Error", "Debug", "NMI", "Breakpoint", "Overflow", "Bound Range Exceeded",
+    "Invalid Opcode", "Device Not Available", "Double Fault", "Coprocessor Segment Overrun",
+    "Invalid TSS", "Segment Not Present", "Stack-Segment Fault", "General Protection Fault",
+    "Page Fault", "Reserved", "x87 Floating-Point", "Alignment Check", "Machine Check",
+    "SIMD Floating-Point", "Virtualization", "Control Protection", "Reserved", "Reserved",
+    "Reserved", "Reserved", "Reserved", "Reserved", "Hypervisor Injection",
+    "VMM Communication", "Security", "Reserved"
+};
+
+static inline void outb(uint16_t port, uint8_t val) {
+    __asm__ volatile("outb %0, %1" : : "a"(val), "Nd"(port));
+}
+
+static void panic_line(const char* label, uint64_t value, int x, int y) {
+    char line[64];
+    char hex[24];
+    strcpy(line, label);
+    hex_to_str(value, hex);
+    strcat(line, "0x");
+    strcat(line, hex);
+    draw_string(line, x, y, 0xFFFFFF);
+}
+
+static void exception_panic(InterruptFrame* frame) {
+    uint64_t cr2;
+    __asm__ volatile("mov %%cr2, %0" : "=r"(cr2));
+
+    gfx_raster_cancel();
+    gfx_end_surface();
+    gfx_reset_clip();
+    draw_rect(0, 0, fb_width, 200, 0x8B0000);
+    char title[64];
+    strcpy(title, "KERNEL PANIC: ");
+    strcat(title, exception_names[frame->vector]);
+    draw_string(title, 20, 16, 0xFFFFFF);
+    panic_line("RIP    ", frame->rip, 20, 40);
+    panic_line("ERROR  ", frame->error_code, 20, 56);
+    panic_line("CR2    ", cr2, 20, 72);
+    panic_line("RSP    ", frame->rsp, 20, 88);
+    panic_line("RFLAGS ", frame->rflags, 20, 104);
+    panic_line("RAX    ", frame->rax, 320, 40);
+    panic_line("RBX    ", frame->rbx, 320, 56);
+    panic_line("RCX    ", frame->rcx, 320, 72);
+    panic_line("RDX    ", frame->rdx, 320, 88);
+    panic_line("RSI    ", frame->rsi, 320, 104);
+    panic_line("RDI    ", frame->rdi, 320, 120);
+    panic_line("RBP    ", frame->rbp, 320, 136);
+    gfx_flush();
+
+    for(;;) __asm__ volatile("cli; hlt");
+}
+
+extern "C" InterruptFrame* interrupt_dispatch(InterruptFrame* frame) {
+    uint64_t vector = frame->vector;
+    interrupt_counts[vector]++;
+
+    if(interrupt_handlers[vector]) {
+        frame = interrupt_handlers[vector](frame);
+    } else if(vector < 32) {
+        exception_panic(frame);
+    }
+
+    if(vector >= 32 && vector != SPURIOUS_VECTOR && !software_vectors[vector] &&
+       (vector < PIC_VECTOR_BASE || vector >= PIC_VECTOR_BASE + 16)) {
+        lapic_eoi();
+    }
+    return frame;
+}
+
+void register_interrupt_handler(uint8_t vector, InterruptHandler handler) {
+    interrupt_handlers[vector] = handler;
+}
+
+void register_software_interrupt(uint8_t vector, InterruptHandler handler) {
+    software_vectors[vector] = true;
+    interrupt_handlers[vector] = handler;
+}
+
+static void set_idt_entry(int vector, uint64_t handler, uint8_t ist) {
+    idt[vector].offset_low = handler & 0xFFFF;
+    idt[vector].selector = GDT_KERNEL_CODE;
+    idt[vector].ist = ist;
+    idt[vector].type_attr = 0x8E;
+    idt[vector].offset_mid = (handler >> 16) & 0xFFFF;
+    idt[vector].offset_high = handler >> 32;
+    idt[vector].reserved = 0;
+}
+
+static void gdt_init(int cpu, uint64_t double_fault_stack_top, uint64_t nmi_stack_top, uint64_t sched_stack_top) {
+    uint64_t* table = gdt[cpu];
+    table[0] = 0;
+    table[1] = 0x00AF9A000000FFFFULL;
+    table[2] = 0x00CF92000000FFFFULL;
+    table[3] = 0x00CFF2000000FFFFULL;
+    table[4] = 0x00AFFA000000FFFFULL;
+
+    memset(&tss[cpu], 0, sizeof(TSS));
+    tss[cpu].ist[0] = double_fault_stack_top;
+    tss[cpu].ist[1] = nmi_stack_top;
+    tss[cpu].ist[2] = sched_stack_top;
+    tss[cpu].iomap_base = sizeof(TSS);
+
+    uint64_t base = (uint64_t)&tss[cpu];
+    uint64_t limit = sizeof(TSS) - 1;
+    table[5] = (limit & 0xFFFF) | ((base & 0xFFFFFF) << 16) | (0x89ULL << 40) |
+               (((limit >> 16) & 0xF) << 48) | (((base >> 24) & 0xFF) << 56);
+    table[6] = base >> 32;
+
+    DescriptorPointer gdtr = { sizeof(gdt[cpu]) - 1, (uint64_t)table };
+    __asm__ volatile(
+        "lgdt %0\n"
+        "pushq %1\n"
+        "leaq 1f(%%rip), %%rax\n"
+        "pushq %%rax\n"
+        "lretq\n"
+        "1:\n"
+        "movw %w2, %%ax\n"
+        "movw %%ax, %%ds\n"
+        "movw %%ax, %%es\n"
+        "movw %%ax, %%ss\n"
+        "xorw %%ax, %%ax\n"
+        "movw %%ax, %%fs\n"
+        "movw %%ax, %%gs\n"
+        "ltr %w3\n"
+        : : "m"(gdtr), "i"(GDT_KERNEL_CODE), "r"(GDT_KERNEL_DATA), "r"(GDT_TSS) : "rax", "memory");
+}
+
+static void pic_disable() {
+    outb(0x20, 0x11);
+    outb(0xA0, 0x11);
+    outb(0x21, PIC_VECTOR_BASE);
+    outb(0xA1, PIC_VECTOR_BASE + 8);
+    outb(0x21, 0x04);
+    outb(0xA1, 0x02);
+    outb(0x21, 0x01);
+    outb(0xA1, 0x01);
+    outb(0x21, 0xFF);
+    outb(0xA1, 0xFF);
+}
+
+static InterruptFrame* ignore_interrupt(InterruptFrame* frame) {
+    return frame;
+}
+
+static void idt_load() {
+    DescriptorPointer idtr = { sizeof(idt) - 1, (uint64_t)idt };
+    __asm__ volatile("lidt %0" : : "m"(idtr));
+}
+
+void interrupts_init() {
+    gdt_init(0, (uint64_t)(double_fault_stack + IST_STACK_SIZE), (uint64_t)(nmi_stack + IST_STACK_SIZE),
+             (uint64_t)(sched_stack + IST_STACK_SIZE));
+
+    for(int i = 0; i < IDT_ENTRIES; i++) {
+        uint8_t ist = 0;
+        if(i == 8) ist = 1;
+        if(i == 2) ist = 2;
+        set_idt_entry(i, isr_stub_table[i], ist);
+        interrupt_handlers[i] = nullptr;
+        software_vectors[i] = false;
+    }
+    for(int i = 0; i < 16; i++) {
+        interrupt_handlers[PIC_VECTOR_BASE + i] = ignore_interrupt;
+    }
+    interrupt_handlers[SPURIOUS_VECTOR] = ignore_interrupt;
+
+    idt_load();
+    pic_disable();
+}
+
+bool interrupts_init_cpu(int cpu) {
+    if(cpu <= 0 || cpu >= MAX_CPUS) return false;
+    uint64_t double_fault_stack_phys = pmm_alloc_pages(IST_STACK_ORDER);
+    uint64_t nmi_stack_phys = pmm_alloc_pages(IST_STACK_ORDER);
+    uint64_t sched_stack_phys = pmm_alloc_pages(IST_STACK_ORDER);
+    if(!double_fault_stack_phys || !nmi_stack_phys || !sched_stack_phys) {
+        if(double_fault_stack_phys) pmm_free_pages(double_fault_stack_phys, IST_STACK_ORDER);
+        if(nmi_stack_phys) pmm_free_pages(nmi_stack_phys, IST_STACK_ORDER);
+        if(sched_stack_phys) pmm_free_pages(sched_stack_phys, IST_STACK_ORDER);
+        return false;
+    }
+
+    gdt_init(cpu, (uint64_t)phys_to_virt(double_fault_stack_phys) + IST_STACK_SIZE,
+             (uint64_t)phys_to_virt(nmi_stack_phys) + IST_STACK_SIZE,
+             (uint64_t)phys_to_virt(sched_stack_phys) + IST_STACK_SIZE);
+    idt_load();
+    return true;
+}
+
+void interrupts_set_stack(uint8_t vector, uint8_t ist) {
+    idt[vector].ist = ist;
+}
+
+void interrupts_enable() {
+    __asm__ volatile("sti");
+}
+
+void interrupts_disable() {
+    __asm__ volatile("cli");
+}
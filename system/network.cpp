@@ -3,12 +3,18 @@
 
 extern void* memcpy(void *dest, const void *src, size_t n);
 extern void* memset(void *s, int c, size_t n);
+extern void* memmem(const void *haystack, size_t haystack_len, const void *needle, size_t needle_len);
 extern size_t strlen(const char *str);
 extern int strcmp(const char *s1, const char *s2);
 extern int strncmp(const char *s1, const char *s2, size_t n);
 extern char* strcpy(char *dest, const char *src);
 extern char* strcat(char *dest, const char *src);
-extern uint64_t uptime_seconds;
+extern uint64_t timer_uptime_seconds();
+extern uint64_t hhdm_offset;
+extern uint64_t clock_ns();
+extern void udelay(uint64_t us);
+
+#define PING_REPLY_DELAY_US 250
 
 static inline uint32_t inl(uint16_t port) {
     uint32_t ret;
@@ -98,16 +104,23 @@ int dns_cache_count = 0;
 struct DNSFile {
     char filename[32];
     char domain[64];
-    char content[4096];
+    const char* content;
 };
 
 DNSFile dns_files[16];
 int dns_file_count = 0;
 
+static void add_dns_file(const char* filename, const char* domain, const char* content) {
+    if(dns_file_count >= 16) return;
+    strcpy(dns_files[dns_file_count].filename, filename);
+    strcpy(dns_files[dns_file_count].domain, domain);
+    dns_files[dns_file_count].content = content;
+    dns_file_count++;
+}
+
 void init_dns_filesystem() {
-    strcpy(dns_files[0].filename, "halden.html");
-    strcpy(dns_files[0].domain, "halden.os");
-    strcpy(dns_files[0].content, 
+    dns_file_count = 0;
+    add_dns_file("halden.html", "halden.os", 
         "<!-- domain: halden.os -->\n"
         "<!DOCTYPE html>\n"
         "<html>\n"
@@ -225,9 +238,7 @@ void init_dns_filesystem() {
         "</html>"
     );
     
-    strcpy(dns_files[1].filename, "example.html");
-    strcpy(dns_files[1].domain, "example.com");
-    strcpy(dns_files[1].content,
+    add_dns_file("example.html", "example.com",
         "<!-- domain: example.com -->\n"
         "<!DOCTYPE html>\n"
         "<html>\n"
@@ -249,9 +260,7 @@ void init_dns_filesystem() {
         "</html>"
     );
     
-    strcpy(dns_files[2].filename, "github.html");
-    strcpy(dns_files[2].domain, "github.com");
-    strcpy(dns_files[2].content,
+    add_dns_file("github.html", "github.com",
         "<!-- domain: github.com -->\n"
         "<!DOCTYPE html>\n"
         "<html>\n"
@@ -277,9 +286,7 @@ void init_dns_filesystem() {
         "</html>"
     );
     
-    strcpy(dns_files[3].filename, "google.html");
-    strcpy(dns_files[3].domain, "google.com");
-    strcpy(dns_files[3].content,
+    add_dns_file("google.html", "google.com",
         "<!-- domain: google.com -->\n"
         "<!DOCTYPE html>\n"
         "<html>\n"
@@ -299,8 +306,6 @@ void init_dns_filesystem() {
         "</body>\n"
         "</html>"
     );
-    
-    dns_file_count = 4;
 }
 
 bool get_dns_file_content(const char* domain, char* content_out) {
@@ -341,7 +346,7 @@ uint8_t rtl_read_reg8(uint16_t io_base, uint32_t mem_base, uint16_t reg) {
     if(io_base & 0x1) {
         return inb(io_base + reg);
     } else if(mem_base) {
-        volatile uint8_t* regs = (volatile uint8_t*)(uint64_t)mem_base;
+        volatile uint8_t* regs = (volatile uint8_t*)(hhdm_offset + mem_base);
         return regs[reg];
     }
     return 0;
@@ -351,7 +356,7 @@ void rtl_write_reg8(uint16_t io_base, uint32_t mem_base, uint16_t reg, uint8_t v
     if(io_base & 0x1) {
         outb(io_base + reg, val);
     } else if(mem_base) {
-        volatile uint8_t* regs = (volatile uint8_t*)(uint64_t)mem_base;
+        volatile uint8_t* regs = (volatile uint8_t*)(hhdm_offset + mem_base);
         regs[reg] = val;
     }
 }
@@ -360,7 +365,7 @@ uint16_t rtl_read_reg16(uint16_t io_base, uint32_t mem_base, uint16_t reg) {
     if(io_base & 0x1) {
         return inw(io_base + reg);
     } else if(mem_base) {
-        volatile uint16_t* regs = (volatile uint16_t*)(uint64_t)mem_base;
+        volatile uint16_t* regs = (volatile uint16_t*)(hhdm_offset + mem_base);
         return regs[reg / 2];
     }
     return 0;
@@ -370,7 +375,7 @@ void rtl_write_reg16(uint16_t io_base, uint32_t mem_base, uint16_t reg, uint16_t
     if(io_base & 0x1) {
         outw(io_base + reg, val);
     } else if(mem_base) {
-        volatile uint16_t* regs = (volatile uint16_t*)(uint64_t)mem_base;
+        volatile uint16_t* regs = (volatile uint16_t*)(hhdm_offset + mem_base);
         regs[reg / 2] = val;
     }
 }
@@ -379,7 +384,7 @@ uint32_t rtl_read_reg32(uint16_t io_base, uint32_t mem_base, uint16_t reg) {
     if(io_base & 0x1) {
         return inl(io_base + reg);
     } else if(mem_base) {
-        volatile uint32_t* regs = (volatile uint32_t*)(uint64_t)mem_base;
+        volatile uint32_t* regs = (volatile uint32_t*)(hhdm_offset + mem_base);
         return regs[reg / 4];
     }
     return 0;
@@ -389,17 +394,17 @@ void rtl_write_reg32(uint16_t io_base, uint32_t mem_base, uint16_t reg, uint32_t
     if(io_base & 0x1) {
         outl(io_base + reg, val);
     } else if(mem_base) {
-        volatile uint32_t* regs = (volatile uint32_t*)(uint64_t)mem_base;
+        volatile uint32_t* regs = (volatile uint32_t*)(hhdm_offset + mem_base);
         regs[reg / 4] = val;
     }
 }
 
 void rtl8192eu_init(uint16_t io_base, uint32_t mem_base) {
     rtl_write_reg8(io_base, mem_base, 0x37, 0x10);
-    for(volatile int i = 0; i < 10000; i++);
+    udelay(10);
     
     rtl_write_reg8(io_base, mem_base, 0x37, 0x00);
-    for(volatile int i = 0; i < 50000; i++);
+    udelay(50);
     
     for(int i = 0; i < 6; i++) {
         primary_interface.mac[i] = rtl_read_reg8(io_base, mem_base, i);
@@ -411,7 +416,7 @@ void rtl8192eu_init(uint16_t io_base, uint32_t mem_base) {
         primary_interface.mac[2] = 0xDA;
         primary_interface.mac[3] = 0x81;
         primary_interface.mac[4] = 0x8B;
-        primary_interface.mac[5] = (uint8_t)(uptime_seconds & 0xFF);
+        primary_interface.mac[5] = (uint8_t)(timer_uptime_seconds() & 0xFF);
     }
     
     primary_interface.wifi_chip = WIFI_RTL8192EU;
@@ -419,10 +424,10 @@ void rtl8192eu_init(uint16_t io_base, uint32_t mem_base) {
 
 void rtl8192cu_init(uint16_t io_base, uint32_t mem_base) {
     rtl_write_reg8(io_base, mem_base, 0x37, 0x10);
-    for(volatile int i = 0; i < 10000; i++);
+    udelay(10);
     
     rtl_write_reg8(io_base, mem_base, 0x37, 0x00);
-    for(volatile int i = 0; i < 50000; i++);
+    udelay(50);
     
     for(int i = 0; i < 6; i++) {
         primary_interface.mac[i] = rtl_read_reg8(io_base, mem_base, i);
@@ -434,7 +439,7 @@ void rtl8192cu_init(uint16_t io_base, uint32_t mem_base) {
         primary_interface.mac[2] = 0xDA;
         primary_interface.mac[3] = 0x81;
         primary_interface.mac[4] = 0x78;
-        primary_interface.mac[5] = (uint8_t)(uptime_seconds & 0xFF);
+        primary_interface.mac[5] = (uint8_t)(timer_uptime_seconds() & 0xFF);
     }
     
     primary_interface.wifi_chip = WIFI_RTL8192CU;
@@ -448,12 +453,12 @@ void rtl8192_scan_networks() {
     
     rtl_write_reg8(io_base, mem_base, 0x522, 0x01);
     
-    for(volatile int i = 0; i < 1000000; i++);
+    udelay(1000);
     
     for(int ch = 1; ch <= 11; ch++) {
         rtl_write_reg8(io_base, mem_base, 0x424, ch);
         
-        for(volatile int i = 0; i < 500000; i++);
+        udelay(500);
         
         uint8_t scan_result = rtl_read_reg8(io_base, mem_base, 0x425);
         
@@ -560,7 +565,7 @@ void detect_network_hardware() {
                             }
                         } else {
                             uint32_t mem_base = bar0 & 0xFFFFFFF0;
-                            volatile uint8_t* mac_addr = (volatile uint8_t*)(uint64_t)mem_base;
+                            volatile uint8_t* mac_addr = (volatile uint8_t*)(hhdm_offset + mem_base);
                             for(int i = 0; i < 6; i++) {
                                 primary_interface.mac[i] = mac_addr[i];
                             }
@@ -713,17 +718,15 @@ bool http_get(const char* url, char* title_out, char* content_out) {
     }
     
     if(get_dns_file_content(domain, content_out)) {
-        const char* title_start = content_out;
-        while(*title_start && strncmp(title_start, "<title>", 7) != 0) title_start++;
-        if(*title_start) {
+        const char* content_end = content_out + strlen(content_out);
+        const char* title_start = (const char*)memmem(content_out, content_end - content_out, "<title>", 7);
+        if(title_start) {
             title_start += 7;
-            const char* title_end = title_start;
-            while(*title_end && strncmp(title_end, "</title>", 8) != 0) title_end++;
+            const char* title_end = (const char*)memmem(title_start, content_end - title_start, "</title>", 8);
+            if(!title_end) title_end = content_end;
             int len = title_end - title_start;
             if(len > 63) len = 63;
-            for(int i = 0; i < len; i++) {
-                title_out[i] = title_start[i];
-            }
+            memcpy(title_out, title_start, len);
             title_out[len] = '\0';
         } else {
             strcpy(title_out, domain);
@@ -823,7 +826,7 @@ void connect_to_wifi(int index, const char* password) {
                 
                 rtl_write_reg8(io_base, mem_base, 0x100, 0x01);
                 
-                for(volatile int i = 0; i < 2000000; i++);
+                udelay(2000);
                 
                 uint8_t status = rtl_read_reg8(io_base, mem_base, 0x101);
                 success = (status & 0x01) != 0;
@@ -909,12 +912,6 @@ void get_network_stats(char* output) {
     }
 }
 
-uint64_t rdtsc() {
-    uint32_t low, high;
-    __asm__ volatile("rdtsc" : "=a"(low), "=d"(high));
-    return ((uint64_t)high << 32) | low;
-}
-
 bool network_ping(const char* host, char* output) {
     if(!primary_interface.connected) {
         strcpy(output, "Network is not connected");
@@ -978,16 +975,12 @@ bool network_ping(const char* host, char* output) {
     strcat(output, tmp);
     strcat(output, ") 56(84) bytes of data.\n");
     
-    uint64_t start_tsc = rdtsc();
-    
     for(int i = 0; i < 4; i++) {
-        uint64_t ping_start = rdtsc();
+        uint64_t ping_start = clock_ns();
         
-        for(volatile int d = 0; d < 100000; d++);
+        udelay(PING_REPLY_DELAY_US);
         
-        uint64_t ping_end = rdtsc();
-        uint64_t cycles = ping_end - ping_start;
-        uint64_t time_us = cycles / 2000;
+        uint64_t time_us = (clock_ns() - ping_start) / 1000;
         uint64_t time_ms = time_us / 1000;
         uint64_t time_frac = (time_us % 1000) / 10;
         
@@ -0,0 +1,404 @@
+#include <stdint.h>
+#include <stddef.h>
+#include "limine.h"
+
+extern void* memset(void *s, int c, size_t n);
+extern uint64_t pmm_alloc_page();
+extern void pmm_free_page(uint64_t phys);
+extern void* phys_to_virt(uint64_t phys);
+extern uint64_t hhdm_offset;
+extern uint32_t* fb_ptr;
+extern uint64_t fb_height;
+extern uint64_t fb_pitch;
+extern uint64_t spin_lock_irqsave(uint32_t* lock);
+extern void spin_unlock_irqrestore(uint32_t* lock, uint64_t flags);
+extern void smp_flush_tlb_others();
+
+extern "C" char __kernel_text_start[], __kernel_text_end[];
+extern "C" char __kernel_rodata_start[], __kernel_rodata_end[];
+extern "C" char __kernel_data_start[], __kernel_data_end[];
+
+#define PAGE_SIZE 4096ULL
+#define LARGE_PAGE_SIZE (2ULL << 20)
+#define HUGE_PAGE_SIZE (1ULL << 30)
+
+#define PTE_PRESENT (1ULL << 0)
+#define PTE_WRITABLE (1ULL << 1)
+#define PTE_WRITE_THROUGH (1ULL << 3)
+#define PTE_CACHE_DISABLE (1ULL << 4)
+#define PTE_HUGE (1ULL << 7)
+#define PTE_GLOBAL (1ULL << 8)
+#define PTE_NO_EXECUTE (1ULL << 63)
+#define PTE_ADDR_MASK 0x000FFFFFFFFFF000ULL
+
+#define CACHE_WB 0
+#define CACHE_WC 1
+#define CACHE_UC 2
+
+#define MSR_PAT 0x277
+#define MSR_EFER 0xC0000080
+#define EFER_NXE (1ULL << 11)
+#define CR4_PGE (1ULL << 7)
+#define PAT_VALUE 0x0007040600070106ULL
+
+#define VMALLOC_BASE 0xFFFFC90000000000ULL
+#define VMALLOC_PAGES ((64ULL << 30) / PAGE_SIZE)
+#define MAX_VM_RANGES 128
+
+struct VMRange {
+    uint64_t start_page;
+    uint64_t page_count;
+};
+
+uint64_t kernel_pml4_phys = 0;
+bool vmm_active = false;
+bool vmm_has_huge_pages = false;
+bool vmm_has_nx = false;
+uint64_t vmm_direct_map_1g = 0;
+uint64_t vmm_direct_map_2m = 0;
+uint64_t vmm_direct_map_4k = 0;
+
+static struct limine_memmap_response* vmm_memmap = nullptr;
+static uint64_t fb_phys_start = 0;
+static uint64_t fb_phys_end = 0;
+static VMRange vm_free_ranges[MAX_VM_RANGES];
+static int vm_free_range_count = 0;
+static uint32_t vmm_table_lock = 0;
+static uint32_t vmm_range_lock = 0;
+
+static inline void cpuid(uint32_t leaf, uint32_t* eax, uint32_t* ebx, uint32_t* ecx, uint32_t* edx) {
+    __asm__ volatile("cpuid" : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx) : "a"(leaf), "c"(0));
+}
+
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint32_t lo, hi;
+    __asm__ volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ volatile("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+static inline void invlpg(uint64_t virt) {
+    __asm__ volatile("invlpg (%0)" : : "r"(virt) : "memory");
+}
+
+static uint64_t cache_bits(int cache) {
+    if(cache == CACHE_WC) return PTE_WRITE_THROUGH;
+    if(cache == CACHE_UC) return PTE_WRITE_THROUGH | PTE_CACHE_DISABLE;
+    return 0;
+}
+
+static uint64_t nx_bit() {
+    return vmm_has_nx ? PTE_NO_EXECUTE : 0;
+}
+
+static uint64_t* table_entry_next(uint64_t* table, int index, bool create) {
+    if(!(table[index] & PTE_PRESENT)) {
+        if(!create) return nullptr;
+        uint64_t phys = pmm_alloc_page();
+        if(!phys) return nullptr;
+        memset(phys_to_virt(phys), 0, PAGE_SIZE);
+        table[index] = phys | PTE_PRESENT | PTE_WRITABLE;
+    }
+    if(table[index] & PTE_HUGE) return nullptr;
+    return (uint64_t*)phys_to_virt(table[index] & PTE_ADDR_MASK);
+}
+
+static uint64_t* walk(uint64_t pml4_phys, uint64_t virt, int level, bool create) {
+    uint64_t* table = (uint64_t*)phys_to_virt(pml4_phys);
+    for(int shift = 39; shift > 12 + 9 * (level - 1); shift -= 9) {
+        table = table_entry_next(table, (virt >> shift) & 0x1FF, create);
+        if(!table) return nullptr;
+    }
+    return &table[(virt >> (12 + 9 * (level - 1))) & 0x1FF];
+}
+
+static bool map_at_level(uint64_t pml4_phys, uint64_t virt, uint64_t phys, uint64_t flags, int level) {
+    uint64_t* entry = walk(pml4_phys, virt, level, true);
+    if(!entry) return false;
+    *entry = phys | flags | PTE_PRESENT | (level > 1 ? PTE_HUGE : 0);
+    return true;
+}
+
+static int memmap_cache_type(uint64_t type) {
+    switch(type) {
+        case LIMINE_MEMMAP_USABLE:
+        case LIMINE_MEMMAP_ACPI_RECLAIMABLE:
+        case LIMINE_MEMMAP_ACPI_NVS:
+        case LIMINE_MEMMAP_BOOTLOADER_RECLAIMABLE:
+        case LIMINE_MEMMAP_KERNEL_AND_MODULES:
+            return CACHE_WB;
+        case LIMINE_MEMMAP_FRAMEBUFFER:
+            return CACHE_WC;
+        default:
+            return CACHE_UC;
+    }
+}
+
+static int cache_type_at(uint64_t phys) {
+    if(phys >= fb_phys_start && phys < fb_phys_end) return CACHE_WC;
+    for(uint64_t i = 0; i < vmm_memmap->entry_count; i++) {
+        struct limine_memmap_entry* entry = vmm_memmap->entries[i];
+        if(phys >= entry->base && phys < entry->base + entry->length) {
+            return memmap_cache_type(entry->type);
+        }
+    }
+    return CACHE_UC;
+}
+
+static bool range_uniform(uint64_t base, uint64_t length, int* type_out) {
+    uint64_t end = base + length;
+    int type = cache_type_at(base);
+    if(fb_phys_start > base && fb_phys_start < end && cache_type_at(fb_phys_start) != type) return false;
+    if(fb_phys_end > base && fb_phys_end < end && cache_type_at(fb_phys_end) != type) return false;
+    for(uint64_t i = 0; i < vmm_memmap->entry_count; i++) {
+        struct limine_memmap_entry* entry = vmm_memmap->entries[i];
+        uint64_t entry_end = entry->base + entry->length;
+        if(entry->base > base && entry->base < end && cache_type_at(entry->base) != type) return false;
+        if(entry_end > base && entry_end < end && cache_type_at(entry_end) != type) return false;
+    }
+    *type_out = type;
+    return true;
+}
+
+static bool map_direct(uint64_t pml4_phys, uint64_t limit) {
+    uint64_t base_flags = PTE_WRITABLE | PTE_GLOBAL | nx_bit();
+    int type;
+
+    for(uint64_t gb = 0; gb < limit; gb += HUGE_PAGE_SIZE) {
+        if(vmm_has_huge_pages && range_uniform(gb, HUGE_PAGE_SIZE, &type)) {
+            if(!map_at_level(pml4_phys, hhdm_offset + gb, gb, base_flags | cache_bits(type), 3)) return false;
+            vmm_direct_map_1g++;
+            continue;
+        }
+        for(uint64_t mb = gb; mb < gb + HUGE_PAGE_SIZE; mb += LARGE_PAGE_SIZE) {
+            if(range_uniform(mb, LARGE_PAGE_SIZE, &type)) {
+                if(!map_at_level(pml4_phys, hhdm_offset + mb, mb, base_flags | cache_bits(type), 2)) return false;
+                vmm_direct_map_2m++;
+                continue;
+            }
+            for(uint64_t page = mb; page < mb + LARGE_PAGE_SIZE; page += PAGE_SIZE) {
+                uint64_t flags = base_flags | cache_bits(cache_type_at(page));
+                if(!map_at_level(pml4_phys, hhdm_offset + page, page, flags, 1)) return false;
+                vmm_direct_map_4k++;
+            }
+        }
+    }
+    return true;
+}
+
+static bool map_kernel_range(uint64_t pml4_phys, char* start, char* end, uint64_t flags,
+                             uint64_t kernel_phys, uint64_t kernel_virt) {
+    uint64_t virt = (uint64_t)start & ~(PAGE_SIZE - 1);
+    for(; virt < (uint64_t)end; virt += PAGE_SIZE) {
+        uint64_t phys = virt - kernel_virt + kernel_phys;
+        if(!map_at_level(pml4_phys, virt, phys, flags | PTE_GLOBAL, 1)) return false;
+    }
+    return true;
+}
+
+bool vmm_init(struct limine_memmap_response* memmap, uint64_t kernel_phys, uint64_t kernel_virt) {
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(0x80000000, &eax, &ebx, &ecx, &edx);
+    if(eax >= 0x80000001) {
+        cpuid(0x80000001, &eax, &ebx, &ecx, &edx);
+        vmm_has_huge_pages = (edx >> 26) & 1;
+        vmm_has_nx = (edx >> 20) & 1;
+    }
+
+    vmm_memmap = memmap;
+    if(fb_ptr) {
+        fb_phys_start = (uint64_t)fb_ptr - hhdm_offset;
+        fb_phys_end = fb_phys_start + fb_pitch * fb_height;
+    }
+
+    uint64_t limit = 4ULL << 30;
+    for(uint64_t i = 0; i < memmap->entry_count; i++) {
+        uint64_t top = memmap->entries[i]->base + memmap->entries[i]->length;
+        if(top > limit) limit = top;
+    }
+    if(fb_phys_end > limit) limit = fb_phys_end;
+    limit = (limit + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+
+    uint64_t pml4_phys = pmm_alloc_page();
+    if(!pml4_phys) return false;
+    memset(phys_to_virt(pml4_phys), 0, PAGE_SIZE);
+
+    if(!map_direct(pml4_phys, limit)) return false;
+    if(!map_kernel_range(pml4_phys, __kernel_text_start, __kernel_text_end, 0, kernel_phys, kernel_virt)) return false;
+    if(!map_kernel_range(pml4_phys, __kernel_rodata_start, __kernel_rodata_end, nx_bit(), kernel_phys, kernel_virt)) return false;
+    if(!map_kernel_range(pml4_phys, __kernel_data_start, __kernel_data_end, PTE_WRITABLE | nx_bit(), kernel_phys, kernel_virt)) return false;
+
+    uint64_t* pml4 = (uint64_t*)phys_to_virt(pml4_phys);
+    for(int i = 256; i < 512; i++) {
+        if(!table_entry_next(pml4, i, true)) return false;
+    }
+
+    vm_free_ranges[0].start_page = 0;
+    vm_free_ranges[0].page_count = VMALLOC_PAGES;
+    vm_free_range_count = 1;
+
+    if(vmm_has_nx) wrmsr(MSR_EFER, rdmsr(MSR_EFER) | EFER_NXE);
+    wrmsr(MSR_PAT, PAT_VALUE);
+    __asm__ volatile("wbinvd" ::: "memory");
+    __asm__ volatile("mov %0, %%cr3" : : "r"(pml4_phys) : "memory");
+
+    uint64_t cr4;
+    __asm__ volatile("mov %%cr4, %0" : "=r"(cr4));
+    __asm__ volatile("mov %0, %%cr4" : : "r"(cr4 | CR4_PGE) : "memory");
+
+    kernel_pml4_phys = pml4_phys;
+    vmm_active = true;
+    return true;
+}
+
+void vmm_load_kernel_space() {
+    uint64_t cr4;
+    if(vmm_has_nx) wrmsr(MSR_EFER, rdmsr(MSR_EFER) | EFER_NXE);
+    wrmsr(MSR_PAT, PAT_VALUE);
+    __asm__ volatile("wbinvd" ::: "memory");
+    __asm__ volatile("mov %0, %%cr3" : : "r"(kernel_pml4_phys) : "memory");
+    __asm__ volatile("mov %%cr4, %0" : "=r"(cr4));
+    __asm__ volatile("mov %0, %%cr4" : : "r"(cr4 | CR4_PGE) : "memory");
+}
+
+bool vmm_map_page(uint64_t virt, uint64_t phys, bool writable) {
+    uint64_t flags = PTE_GLOBAL | nx_bit() | (writable ? PTE_WRITABLE : 0);
+    uint64_t irq = spin_lock_irqsave(&vmm_table_lock);
+    bool mapped = map_at_level(kernel_pml4_phys, virt, phys, flags, 1);
+    spin_unlock_irqrestore(&vmm_table_lock, irq);
+    if(!mapped) return false;
+    invlpg(virt);
+    return true;
+}
+
+static uint64_t unmap_entry(uint64_t virt) {
+    uint64_t irq = spin_lock_irqsave(&vmm_table_lock);
+    uint64_t* entry = walk(kernel_pml4_phys, virt, 1, false);
+    uint64_t phys = 0;
+    if(entry && (*entry & PTE_PRESENT)) {
+        phys = *entry & PTE_ADDR_MASK;
+        *entry = 0;
+    }
+    spin_unlock_irqrestore(&vmm_table_lock, irq);
+    if(phys) invlpg(virt);
+    return phys;
+}
+
+uint64_t vmm_unmap_page(uint64_t virt) {
+    uint64_t phys = unmap_entry(virt);
+    if(phys) smp_flush_tlb_others();
+    return phys;
+}
+
+uint64_t vmm_translate(uint64_t virt) {
+    uint64_t* table = (uint64_t*)phys_to_virt(kernel_pml4_phys);
+    for(int shift = 39; shift >= 12; shift -= 9) {
+        uint64_t entry = table[(virt >> shift) & 0x1FF];
+        if(!(entry & PTE_PRESENT)) return 0;
+        if(shift == 12 || (entry & PTE_HUGE)) {
+            uint64_t page_mask = (1ULL << shift) - 1;
+            return (entry & PTE_ADDR_MASK & ~page_mask) | (virt & page_mask);
+        }
+        table = (uint64_t*)phys_to_virt(entry & PTE_ADDR_MASK);
+    }
+    return 0;
+}
+
+static uint64_t vm_range_alloc(uint64_t pages) {
+    uint64_t irq = spin_lock_irqsave(&vmm_range_lock);
+    for(int i = 0; i < vm_free_range_count; i++) {
+        if(vm_free_ranges[i].page_count < pages) continue;
+        uint64_t start = vm_free_ranges[i].start_page;
+        vm_free_ranges[i].start_page += pages;
+        vm_free_ranges[i].page_count -= pages;
+        if(vm_free_ranges[i].page_count == 0) {
+            for(int j = i; j < vm_free_range_count - 1; j++) vm_free_ranges[j] = vm_free_ranges[j + 1];
+            vm_free_range_count--;
+        }
+        spin_unlock_irqrestore(&vmm_range_lock, irq);
+        return VMALLOC_BASE + start * PAGE_SIZE;
+    }
+    spin_unlock_irqrestore(&vmm_range_lock, irq);
+    return 0;
+}
+
+static void vm_range_insert(uint64_t virt, uint64_t pages) {
+    uint64_t start = (virt - VMALLOC_BASE) / PAGE_SIZE;
+    int pos = 0;
+    while(pos < vm_free_range_count && vm_free_ranges[pos].start_page < start) pos++;
+
+    if(pos > 0 && vm_free_ranges[pos - 1].start_page + vm_free_ranges[pos - 1].page_count == start) {
+        vm_free_ranges[pos - 1].page_count += pages;
+        if(pos < vm_free_range_count && start + pages == vm_free_ranges[pos].start_page) {
+            vm_free_ranges[pos - 1].page_count += vm_free_ranges[pos].page_count;
+            for(int j = pos; j < vm_free_range_count - 1; j++) vm_free_ranges[j] = vm_free_ranges[j + 1];
+            vm_free_range_count--;
+        }
+        return;
+    }
+    if(pos < vm_free_range_count && start + pages == vm_free_ranges[pos].start_page) {
+        vm_free_ranges[pos].start_page = start;
+        vm_free_ranges[pos].page_count += pages;
+        return;
+    }
+    if(vm_free_range_count >= MAX_VM_RANGES) return;
+    for(int j = vm_free_range_count; j > pos; j--) vm_free_ranges[j] = vm_free_ranges[j - 1];
+    vm_free_ranges[pos].start_page = start;
+    vm_free_ranges[pos].page_count = pages;
+    vm_free_range_count++;
+}
+
+static void vm_range_free(uint64_t virt, uint64_t pages) {
+    uint64_t irq = spin_lock_irqsave(&vmm_range_lock);
+    vm_range_insert(virt, pages);
+    spin_unlock_irqrestore(&vmm_range_lock, irq);
+}
+
+void vmm_free(void* ptr, uint64_t size) {
+    if(!ptr || !vmm_active) return;
+    uint64_t pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint64_t virt = (uint64_t)ptr;
+    uint64_t irq = spin_lock_irqsave(&vmm_table_lock);
+    for(uint64_t i = 0; i < pages; i++) {
+        uint64_t* entry = walk(kernel_pml4_phys, virt + i * PAGE_SIZE, 1, false);
+        if(entry) *entry &= ~PTE_PRESENT;
+        invlpg(virt + i * PAGE_SIZE);
+    }
+    spin_unlock_irqrestore(&vmm_table_lock, irq);
+    smp_flush_tlb_others();
+
+    irq = spin_lock_irqsave(&vmm_table_lock);
+    for(uint64_t i = 0; i < pages; i++) {
+        uint64_t* entry = walk(kernel_pml4_phys, virt + i * PAGE_SIZE, 1, false);
+        if(!entry || !*entry) continue;
+        uint64_t phys = *entry & PTE_ADDR_MASK;
+        *entry = 0;
+        pmm_free_page(phys);
+    }
+    spin_unlock_irqrestore(&vmm_table_lock, irq);
+    vm_range_free(virt, pages + 1);
+}
+
+void* vmm_alloc(uint64_t size) {
+    if(!vmm_active || size == 0) return nullptr;
+    uint64_t pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint64_t virt = vm_range_alloc(pages + 1);
+    if(!virt) return nullptr;
+
+    for(uint64_t i = 0; i < pages; i++) {
+        uint64_t phys = pmm_alloc_page();
+        if(!phys || !vmm_map_page(virt + i * PAGE_SIZE, phys, true)) {
+            if(phys) pmm_free_page(phys);
+            for(uint64_t j = 0; j < i; j++) {
+                pmm_free_page(unmap_entry(virt + j * PAGE_SIZE));
+            }
+            vm_range_free(virt, pages + 1);
+            return nullptr;
+        }
+        memset((void*)(virt + i * PAGE_SIZE), 0, PAGE_SIZE);
+    }
+    return (void*)virt;
+}
@@ -0,0 +1,157 @@
+#include <stdint.h>
+#include <stddef.h>
+
+extern bool fpu_usable();
+extern bool fpu_ready;
+extern bool fpu_has_avx2;
+extern void pixel_copy_sse2(uint32_t* dst, const uint32_t* src, int count);
+extern void pixel_copy_key_sse2(uint32_t* dst, const uint32_t* src, int count, uint32_t key);
+extern void pixel_over_sse2(uint32_t* dst, const uint32_t* src, int count);
+extern void pixel_copy_avx2(uint32_t* dst, const uint32_t* src, int count);
+extern void pixel_copy_key_avx2(uint32_t* dst, const uint32_t* src, int count, uint32_t key);
+extern void pixel_over_avx2(uint32_t* dst, const uint32_t* src, int count);
+extern void serial_write(const char* str);
+
+#define PIXEL_IMPL_SCALAR 0
+#define PIXEL_IMPL_SSE2 1
+#define PIXEL_IMPL_AVX2 2
+#define PIXEL_TEST_LEN 72
+#define PIXEL_TEST_KEY 0xFF00FF00
+
+struct PixelImpl {
+    const char* name;
+    void (*copy)(uint32_t* dst, const uint32_t* src, int count);
+    void (*copy_key)(uint32_t* dst, const uint32_t* src, int count, uint32_t key);
+    void (*over)(uint32_t* dst, const uint32_t* src, int count);
+    bool simd;
+    bool available;
+};
+
+static void pixel_copy_scalar(uint32_t* dst, const uint32_t* src, int count) {
+    uint64_t words = (uint64_t)count >> 1;
+    __asm__ volatile("rep movsq" : "+D"(dst), "+S"(src), "+c"(words) : : "memory");
+    if(count & 1) *dst = *src;
+}
+
+static void pixel_copy_key_scalar(uint32_t* dst, const uint32_t* src, int count, uint32_t key) {
+    for(; count > 0; count--, dst++, src++) {
+        if(*src != key) *dst = *src;
+    }
+}
+
+static void pixel_over_scalar(uint32_t* dst, const uint32_t* src, int count) {
+    for(; count > 0; count--, dst++, src++) {
+        uint32_t s = *src;
+        uint32_t inv = 255 - (s >> 24);
+        if(inv == 0) {
+            *dst = s;
+            continue;
+        }
+        uint32_t rb = (*dst & 0x00FF00FF) * inv + 0x00800080;
+        uint32_t ag = ((*dst >> 8) & 0x00FF00FF) * inv + 0x00800080;
+        rb = ((rb + ((rb >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+        ag = (ag + ((ag >> 8) & 0x00FF00FF)) & 0xFF00FF00;
+        *dst = s + (rb | ag);
+    }
+}
+
+static PixelImpl pixel_impls[] = {
+    {"scalar", pixel_copy_scalar, pixel_copy_key_scalar, pixel_over_scalar, false, true},
+    {"sse2", pixel_copy_sse2, pixel_copy_key_sse2, pixel_over_sse2, true, false},
+    {"avx2", pixel_copy_avx2, pixel_copy_key_avx2, pixel_over_avx2, true, false},
+};
+#define PIXEL_IMPL_COUNT (int)(sizeof(pixel_impls) / sizeof(pixel_impls[0]))
+
+static PixelImpl* pixel_active = &pixel_impls[PIXEL_IMPL_SCALAR];
+
+static inline PixelImpl* pixel_impl_for_context() {
+    if(pixel_active->simd && !fpu_usable()) return &pixel_impls[PIXEL_IMPL_SCALAR];
+    return pixel_active;
+}
+
+void pixel_copy(uint32_t* dst, const uint32_t* src, int count) {
+    pixel_impl_for_context()->copy(dst, src, count);
+}
+
+void pixel_copy_key(uint32_t* dst, const uint32_t* src, int count, uint32_t key) {
+    pixel_impl_for_context()->copy_key(dst, src, count, key);
+}
+
+void pixel_over(uint32_t* dst, const uint32_t* src, int count) {
+    pixel_impl_for_context()->over(dst, src, count);
+}
+
+static uint32_t test_src[PIXEL_TEST_LEN];
+static uint32_t test_ref[PIXEL_TEST_LEN];
+static uint32_t test_out[PIXEL_TEST_LEN];
+
+static uint32_t test_next(uint32_t* seed) {
+    *seed = *seed * 1103515245 + 12345;
+    return *seed >> 8;
+}
+
+static void test_fill(uint32_t seed) {
+    for(int i = 0; i < PIXEL_TEST_LEN; i++) {
+        uint32_t a = test_next(&seed) & 0xFF;
+        if(i % 5 == 0) a = 0;
+        else if(i % 5 == 1) a = 255;
+        uint32_t r = (test_next(&seed) & 0xFF) * a / 255;
+        uint32_t g = (test_next(&seed) & 0xFF) * a / 255;
+        uint32_t b = (test_next(&seed) & 0xFF) * a / 255;
+        test_src[i] = (i % 8 == 3) ? PIXEL_TEST_KEY : (a << 24) | (r << 16) | (g << 8) | b;
+        uint32_t d = test_next(&seed) | 0xFF000000;
+        test_ref[i] = d;
+        test_out[i] = d;
+    }
+}
+
+static bool test_same() {
+    for(int i = 0; i < PIXEL_TEST_LEN; i++) {
+        if(test_ref[i] != test_out[i]) return false;
+    }
+    return true;
+}
+
+static bool pixel_impl_matches(const PixelImpl* impl) {
+    const PixelImpl* ref = &pixel_impls[PIXEL_IMPL_SCALAR];
+    for(int op = 0; op < 3; op++) {
+        for(int offset = 0; offset < 4; offset++) {
+            for(int count = 0; count + offset <= PIXEL_TEST_LEN; count++) {
+                test_fill(op * 7919 + offset * 131 + count);
+                const uint32_t* src = test_src + offset;
+                if(op == 0) {
+                    ref->copy(test_ref + offset, src, count);
+                    impl->copy(test_out + offset, src, count);
+                } else if(op == 1) {
+                    ref->copy_key(test_ref + offset, src, count, PIXEL_TEST_KEY);
+                    impl->copy_key(test_out + offset, src, count, PIXEL_TEST_KEY);
+                } else {
+                    ref->over(test_ref + offset, src, count);
+                    impl->over(test_out + offset, src, count);
+                }
+                if(!test_same()) return false;
+            }
+        }
+    }
+    return true;
+}
+
+void pixel_init() {
+    pixel_impls[PIXEL_IMPL_SSE2].available = fpu_ready;
+    pixel_impls[PIXEL_IMPL_AVX2].available = fpu_ready && fpu_has_avx2;
+    for(int i = 0; i < PIXEL_IMPL_COUNT; i++) {
+        PixelImpl* impl = &pixel_impls[i];
+        if(!impl->simd || !impl->available || pixel_impl_matches(impl)) continue;
+        impl->available = false;
+        serial_write("[pixel] ");
+        serial_write(impl->name);
+        serial_write(" kernels disagree with scalar, disabled\n");
+    }
+
+    if(pixel_impls[PIXEL_IMPL_AVX2].available) pixel_active = &pixel_impls[PIXEL_IMPL_AVX2];
+    else if(pixel_impls[PIXEL_IMPL_SSE2].available) pixel_active = &pixel_impls[PIXEL_IMPL_SSE2];
+}
+
+const char* pixel_impl_name() {
+    return pixel_active->name;
+}
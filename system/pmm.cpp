@@ -0,0 +1,256 @@
+#include <stdint.h>
+#include <stddef.h>
+#include "limine.h"
+
+extern uint64_t hhdm_offset;
+extern uint64_t free_memory_kb;
+extern uint64_t spin_lock_irqsave(uint32_t* lock);
+extern void spin_unlock_irqrestore(uint32_t* lock, uint64_t flags);
+
+#define PAGE_SIZE 4096
+#define PAGE_SHIFT 12
+#define PMM_MAX_ORDER 10
+#define PMM_BLOCK_FREE 0x80
+
+struct FreeBlock {
+    FreeBlock* next;
+    FreeBlock* prev;
+};
+
+static FreeBlock* free_lists[PMM_MAX_ORDER + 1];
+static uint64_t free_block_count[PMM_MAX_ORDER + 1];
+static uint8_t* page_state = nullptr;
+static uint64_t page_count = 0;
+static uint32_t pmm_lock = 0;
+
+uint64_t pmm_total_page_count = 0;
+uint64_t pmm_free_page_count = 0;
+
+static inline FreeBlock* block_at(uint64_t pfn) {
+    return (FreeBlock*)(hhdm_offset + (pfn << PAGE_SHIFT));
+}
+
+static inline uint64_t block_pfn(FreeBlock* block) {
+    return ((uint64_t)block - hhdm_offset) >> PAGE_SHIFT;
+}
+
+static void free_list_push(uint64_t pfn, int order) {
+    FreeBlock* block = block_at(pfn);
+    block->prev = nullptr;
+    block->next = free_lists[order];
+    if(free_lists[order]) free_lists[order]->prev = block;
+    free_lists[order] = block;
+    free_block_count[order]++;
+    page_state[pfn] = PMM_BLOCK_FREE | order;
+}
+
+static void free_list_remove(uint64_t pfn, int order) {
+    FreeBlock* block = block_at(pfn);
+    if(block->prev) block->prev->next = block->next;
+    else free_lists[order] = block->next;
+    if(block->next) block->next->prev = block->prev;
+    free_block_count[order]--;
+    page_state[pfn] = order;
+}
+
+static void update_free_memory() {
+    free_memory_kb = pmm_free_page_count * (PAGE_SIZE / 1024);
+}
+
+static void release_block(uint64_t pfn, int order) {
+    while(order < PMM_MAX_ORDER) {
+        uint64_t buddy = pfn ^ (1ULL << order);
+        if(buddy >= page_count || page_state[buddy] != (PMM_BLOCK_FREE | order)) break;
+        free_list_remove(buddy, order);
+        page_state[buddy] = 0;
+        pfn &= ~(1ULL << order);
+        order++;
+    }
+    free_list_push(pfn, order);
+}
+
+static void add_free_range(uint64_t start_pfn, uint64_t end_pfn) {
+    while(start_pfn < end_pfn) {
+        int order = PMM_MAX_ORDER;
+        while(order > 0 && ((start_pfn & ((1ULL << order) - 1)) != 0 || start_pfn + (1ULL << order) > end_pfn)) {
+            order--;
+        }
+        release_block(start_pfn, order);
+        pmm_free_page_count += 1ULL << order;
+        pmm_total_page_count += 1ULL << order;
+        start_pfn += 1ULL << order;
+    }
+}
+
+uint64_t pmm_alloc_pages(int order) {
+    if(order < 0 || order > PMM_MAX_ORDER) return 0;
+
+    uint64_t flags = spin_lock_irqsave(&pmm_lock);
+    int current = order;
+    while(current <= PMM_MAX_ORDER && !free_lists[current]) current++;
+    if(current > PMM_MAX_ORDER) {
+        spin_unlock_irqrestore(&pmm_lock, flags);
+        return 0;
+    }
+
+    uint64_t pfn = block_pfn(free_lists[current]);
+    free_list_remove(pfn, current);
+
+    while(current > order) {
+        current--;
+        free_list_push(pfn + (1ULL << current), current);
+    }
+
+    page_state[pfn] = order;
+    pmm_free_page_count -= 1ULL << order;
+    update_free_memory();
+    spin_unlock_irqrestore(&pmm_lock, flags);
+    return pfn << PAGE_SHIFT;
+}
+
+void pmm_free_pages(uint64_t phys, int order) {
+    if(!phys || order < 0 || order > PMM_MAX_ORDER) return;
+    uint64_t pfn = phys >> PAGE_SHIFT;
+    if(pfn >= page_count) return;
+
+    uint64_t flags = spin_lock_irqsave(&pmm_lock);
+    if(!(page_state[pfn] & PMM_BLOCK_FREE)) {
+        page_state[pfn] = 0;
+        release_block(pfn, order);
+        pmm_free_page_count += 1ULL << order;
+        update_free_memory();
+    }
+    spin_unlock_irqrestore(&pmm_lock, flags);
+}
+
+uint64_t pmm_alloc_page() {
+    return pmm_alloc_pages(0);
+}
+
+void pmm_free_page(uint64_t phys) {
+    pmm_free_pages(phys, 0);
+}
+
+int pmm_order_for_pages(uint64_t count) {
+    int order = 0;
+    while((1ULL << order) < count) order++;
+    return order;
+}
+
+uint64_t pmm_alloc_contiguous(uint64_t count) {
+    if(count == 0) return 0;
+    int order = pmm_order_for_pages(count);
+    uint64_t phys = pmm_alloc_pages(order);
+    if(!phys) return 0;
+
+    uint64_t pfn = phys >> PAGE_SHIFT;
+    uint64_t tail = pfn + count;
+    uint64_t end = pfn + (1ULL << order);
+    uint64_t flags = spin_lock_irqsave(&pmm_lock);
+    while(tail < end) {
+        int tail_order = 0;
+        while(tail_order < order && (tail & ((1ULL << (tail_order + 1)) - 1)) == 0 &&
+              tail + (1ULL << (tail_order + 1)) <= end) {
+            tail_order++;
+        }
+        release_block(tail, tail_order);
+        pmm_free_page_count += 1ULL << tail_order;
+        tail += 1ULL << tail_order;
+    }
+
+    update_free_memory();
+    spin_unlock_irqrestore(&pmm_lock, flags);
+    return phys;
+}
+
+void pmm_free_contiguous(uint64_t phys, uint64_t count) {
+    if(!phys) return;
+    uint64_t pfn = phys >> PAGE_SHIFT;
+    uint64_t end = pfn + count;
+    while(pfn < end) {
+        int order = 0;
+        while(order < PMM_MAX_ORDER && (pfn & ((1ULL << (order + 1)) - 1)) == 0 &&
+              pfn + (1ULL << (order + 1)) <= end) {
+            order++;
+        }
+        pmm_free_pages(pfn << PAGE_SHIFT, order);
+        pfn += 1ULL << order;
+    }
+}
+
+void* phys_to_virt(uint64_t phys) {
+    return (void*)(hhdm_offset + phys);
+}
+
+uint64_t virt_to_phys(const void* virt) {
+    return (uint64_t)virt - hhdm_offset;
+}
+
+uint64_t pmm_get_page_count() {
+    return page_count;
+}
+
+void pmm_get_free_blocks(uint64_t* counts_out, int max_orders) {
+    for(int i = 0; i <= PMM_MAX_ORDER && i < max_orders; i++) {
+        counts_out[i] = free_block_count[i];
+    }
+}
+
+bool pmm_init(struct limine_memmap_response* memmap) {
+    uint64_t highest = 0;
+    for(uint64_t i = 0; i < memmap->entry_count; i++) {
+        struct limine_memmap_entry* entry = memmap->entries[i];
+        if(entry->type != LIMINE_MEMMAP_USABLE) continue;
+        uint64_t top = entry->base + entry->length;
+        if(top > highest) highest = top;
+    }
+
+    page_count = highest >> PAGE_SHIFT;
+    uint64_t state_bytes = (page_count + PAGE_SIZE - 1) & ~(uint64_t)(PAGE_SIZE - 1);
+
+    uint64_t state_base = 0;
+    for(uint64_t i = 0; i < memmap->entry_count; i++) {
+        struct limine_memmap_entry* entry = memmap->entries[i];
+        if(entry->type != LIMINE_MEMMAP_USABLE) continue;
+        uint64_t base = (entry->base + PAGE_SIZE - 1) & ~(uint64_t)(PAGE_SIZE - 1);
+        uint64_t top = (entry->base + entry->length) & ~(uint64_t)(PAGE_SIZE - 1);
+        if(base == 0) base = PAGE_SIZE;
+        if(top > base && top - base >= state_bytes) {
+            state_base = base;
+            break;
+        }
+    }
+    if(!state_base) return false;
+
+    page_state = (uint8_t*)(hhdm_offset + state_base);
+    for(uint64_t i = 0; i < page_count; i++) page_state[i] = 0;
+    for(int i = 0; i <= PMM_MAX_ORDER; i++) {
+        free_lists[i] = nullptr;
+        free_block_count[i] = 0;
+    }
+    pmm_total_page_count = 0;
+    pmm_free_page_count = 0;
+
+    uint64_t state_end = state_base + state_bytes;
+    for(uint64_t i = 0; i < memmap->entry_count; i++) {
+        struct limine_memmap_entry* entry = memmap->entries[i];
+        if(entry->type != LIMINE_MEMMAP_USABLE) continue;
+
+        uint64_t start = (entry->base + PAGE_SIZE - 1) >> PAGE_SHIFT;
+        uint64_t end = (entry->base + entry->length) >> PAGE_SHIFT;
+        if(start == 0) start = 1;
+
+        uint64_t state_start_pfn = state_base >> PAGE_SHIFT;
+        uint64_t state_end_pfn = state_end >> PAGE_SHIFT;
+        if(start < state_end_pfn && end > state_start_pfn) {
+            if(start < state_start_pfn) add_free_range(start, state_start_pfn);
+            if(end > state_end_pfn) add_free_range(state_end_pfn, end);
+        } else if(start < end) {
+            add_free_range(start, end);
+        }
+    }
+
+    pmm_total_page_count += state_bytes >> PAGE_SHIFT;
+    update_free_memory();
+    return true;
+}
@@ -0,0 +1,721 @@
+#include <stdint.h>
+#include <stddef.h>
+
+extern void* memset(void *s, int c, size_t n);
+extern char* strcpy(char *dest, const char *src);
+extern size_t strlen(const char *str);
+extern uint64_t pmm_alloc_pages(int order);
+extern void pmm_free_pages(uint64_t phys, int order);
+extern void* phys_to_virt(uint64_t phys);
+extern uint64_t clock_ns();
+extern void udelay(uint64_t us);
+extern uint32_t smp_current_cpu();
+extern bool smp_cpu_online(uint32_t index);
+extern uint32_t smp_cpu_count;
+extern void spin_lock(uint32_t* lock);
+extern void spin_unlock(uint32_t* lock);
+extern uint64_t spin_lock_irqsave(uint32_t* lock);
+extern void spin_unlock_irqrestore(uint32_t* lock, uint64_t flags);
+extern uint64_t irq_save();
+extern void irq_restore(uint64_t flags);
+extern uint32_t smp_cpu_lapic_id(uint32_t index);
+extern void lapic_send_ipi(uint32_t apic_id, uint8_t vector);
+extern void timer_arm_oneshot(uint64_t deadline_ns);
+extern void timer_stop();
+extern bool fpu_ready;
+extern void* fpu_alloc_state();
+extern void fpu_free_state(void* area);
+extern void fpu_save(void* area);
+extern void fpu_restore(void* area);
+extern void fpu_set_ts();
+extern void fpu_clear_ts();
+
+#define MAX_CPUS 64
+#define MAX_THREADS 128
+#define THREAD_NAME_LEN 32
+#define THREAD_STACK_ORDER 2
+#define THREAD_STACK_SIZE (4096 << THREAD_STACK_ORDER)
+#define SCHED_SLICE_NS 10000000ULL
+#define SCHED_YIELD_VECTOR 0x31
+#define SCHED_WAKE_VECTOR 0xF1
+#define SCHED_NO_DEADLINE 0xFFFFFFFFFFFFFFFFULL
+#define SCHED_IST 3
+#define TIMER_VECTOR 0x30
+#define NM_VECTOR 7
+#define KERNEL_CS 0x08
+#define KERNEL_SS 0x10
+
+struct InterruptFrame {
+    uint64_t r15, r14, r13, r12, r11, r10, r9, r8;
+    uint64_t rbp, rdi, rsi, rdx, rcx, rbx, rax;
+    uint64_t vector, error_code;
+    uint64_t rip, cs, rflags, rsp, ss;
+};
+
+typedef InterruptFrame* (*InterruptHandler)(InterruptFrame* frame);
+typedef void (*ThreadEntry)(void* arg);
+
+extern void register_interrupt_handler(uint8_t vector, InterruptHandler handler);
+extern void register_software_interrupt(uint8_t vector, InterruptHandler handler);
+extern void interrupts_set_stack(uint8_t vector, uint8_t ist);
+
+enum ThreadState {
+    THREAD_FREE = 0,
+    THREAD_READY = 1,
+    THREAD_RUNNING = 2,
+    THREAD_SLEEPING = 3,
+    THREAD_SUSPENDED = 4,
+    THREAD_DEAD = 5
+};
+
+struct Thread {
+    InterruptFrame frame;
+    uint32_t id;
+    char name[THREAD_NAME_LEN];
+    volatile ThreadState state;
+    volatile int cpu;
+    int affinity;
+    uint64_t stack_phys;
+    void* fpu_state;
+    ThreadEntry entry;
+    void* arg;
+    uint64_t cpu_time_ns;
+    uint64_t run_start_ns;
+    uint64_t wake_ns;
+    volatile bool suspend_pending;
+    volatile bool kill_pending;
+    volatile bool wake_pending;
+    bool system;
+    uint32_t joiner;
+    Thread* next;
+};
+
+struct RunQueue {
+    uint32_t lock;
+    Thread* head;
+    Thread* tail;
+    Thread* sleeping;
+    volatile uint32_t nr_ready;
+    Thread* current;
+    Thread* idle;
+    Thread* fpu_owner;
+    uint64_t slice_start_ns;
+    uint64_t armed_ns;
+    volatile uint32_t wake_word;
+    volatile bool steal_requested;
+    uint64_t switches;
+    uint64_t steals;
+};
+
+static Thread threads[MAX_THREADS];
+static RunQueue run_queues[MAX_CPUS];
+static uint32_t thread_table_lock = 0;
+static uint32_t next_thread_id = 1;
+bool sched_ready = false;
+bool sched_has_mwait = false;
+
+static void rq_push(RunQueue* rq, Thread* t) {
+    t->next = nullptr;
+    if(rq->tail) rq->tail->next = t;
+    else rq->head = t;
+    rq->tail = t;
+    rq->nr_ready++;
+}
+
+static bool rq_remove(RunQueue* rq, Thread* t) {
+    Thread* prev = nullptr;
+    for(Thread* it = rq->head; it; prev = it, it = it->next) {
+        if(it != t) continue;
+        if(prev) prev->next = it->next;
+        else rq->head = it->next;
+        if(rq->tail == it) rq->tail = prev;
+        it->next = nullptr;
+        rq->nr_ready--;
+        return true;
+    }
+    return false;
+}
+
+static Thread* rq_pop(RunQueue* rq) {
+    Thread* t = rq->head;
+    if(t) rq_remove(rq, t);
+    return t;
+}
+
+static bool sleep_remove(RunQueue* rq, Thread* t) {
+    Thread** link = &rq->sleeping;
+    while(*link) {
+        if(*link == t) {
+            *link = t->next;
+            t->next = nullptr;
+            return true;
+        }
+        link = &(*link)->next;
+    }
+    return false;
+}
+
+static void wake_sleepers(RunQueue* rq, uint64_t now) {
+    Thread** link = &rq->sleeping;
+    while(*link) {
+        Thread* t = *link;
+        if(t->wake_ns > now) {
+            link = &t->next;
+            continue;
+        }
+        *link = t->next;
+        t->wake_ns = 0;
+        if(t->suspend_pending) {
+            t->suspend_pending = false;
+            t->state = THREAD_SUSPENDED;
+            t->next = nullptr;
+        } else {
+            t->state = THREAD_READY;
+            rq_push(rq, t);
+        }
+    }
+}
+
+bool sched_wake(uint32_t id);
+
+static void release_thread(Thread* t) {
+    uint64_t stack = t->stack_phys;
+    void* fpu_state = t->fpu_state;
+    uint64_t flags = spin_lock_irqsave(&thread_table_lock);
+    uint32_t joiner = t->joiner;
+    t->stack_phys = 0;
+    t->fpu_state = nullptr;
+    t->id = 0;
+    t->joiner = 0;
+    t->state = THREAD_FREE;
+    spin_unlock_irqrestore(&thread_table_lock, flags);
+    if(stack) pmm_free_pages(stack, THREAD_STACK_ORDER);
+    if(fpu_state) fpu_free_state(fpu_state);
+    if(joiner) sched_wake(joiner);
+}
+
+static void program_timer(RunQueue* rq) {
+    uint64_t deadline = SCHED_NO_DEADLINE;
+    spin_lock(&rq->lock);
+    if(rq->current != rq->idle && rq->nr_ready) deadline = rq->slice_start_ns + SCHED_SLICE_NS;
+    for(Thread* t = rq->sleeping; t; t = t->next) {
+        if(t->wake_ns < deadline) deadline = t->wake_ns;
+    }
+    spin_unlock(&rq->lock);
+
+    if(deadline == rq->armed_ns) return;
+    rq->armed_ns = deadline;
+    if(deadline == SCHED_NO_DEADLINE) timer_stop();
+    else timer_arm_oneshot(deadline);
+}
+
+static void kick_cpu(uint32_t cpu) {
+    RunQueue* rq = &run_queues[cpu];
+    if(sched_has_mwait && cpu != smp_current_cpu()) {
+        __atomic_fetch_add(&rq->wake_word, 1, __ATOMIC_SEQ_CST);
+        if(__atomic_load_n(&rq->current, __ATOMIC_SEQ_CST) == rq->idle) return;
+    }
+    lapic_send_ipi(smp_cpu_lapic_id(cpu), SCHED_WAKE_VECTOR);
+}
+
+static void kick_idle_cpu(uint32_t busy) {
+    for(uint32_t i = 0; i < smp_cpu_count; i++) {
+        RunQueue* rq = &run_queues[i];
+        if(i == busy || !smp_cpu_online(i) || rq->current != rq->idle || rq->nr_ready) continue;
+        rq->steal_requested = true;
+        kick_cpu(i);
+        return;
+    }
+}
+
+static void enqueue_thread(RunQueue* rq, Thread* t) {
+    t->state = THREAD_READY;
+    rq_push(rq, t);
+}
+
+static void kick_for_thread(Thread* t, uint32_t cpu) {
+    kick_cpu(cpu);
+    RunQueue* rq = &run_queues[cpu];
+    if(t->affinity < 0 && rq->current != rq->idle) kick_idle_cpu(cpu);
+}
+
+static Thread* steal_thread(uint32_t thief) {
+    for(uint32_t n = 1; n < smp_cpu_count; n++) {
+        uint32_t victim = (thief + n) % smp_cpu_count;
+        RunQueue* rq = &run_queues[victim];
+        if(rq->nr_ready == 0) continue;
+
+        spin_lock(&rq->lock);
+        Thread* found = nullptr;
+        for(Thread* it = rq->head; it; it = it->next) {
+            if(it->affinity < 0 || it->affinity == (int)thief) found = it;
+        }
+        if(found) {
+            rq_remove(rq, found);
+            found->state = THREAD_RUNNING;
+            found->cpu = thief;
+        }
+        spin_unlock(&rq->lock);
+        if(found) {
+            run_queues[thief].steals++;
+            return found;
+        }
+    }
+    return nullptr;
+}
+
+static InterruptFrame* schedule(InterruptFrame* frame) {
+    uint32_t cpu = smp_current_cpu();
+    RunQueue* rq = &run_queues[cpu];
+    Thread* prev = rq->current;
+    uint64_t now = clock_ns();
+
+    prev->frame = *frame;
+    prev->cpu_time_ns += now - prev->run_start_ns;
+
+    spin_lock(&rq->lock);
+    wake_sleepers(rq, now);
+    if(prev != rq->idle) {
+        if(prev->kill_pending) {
+            prev->state = THREAD_DEAD;
+        } else if(prev->suspend_pending) {
+            prev->suspend_pending = false;
+            prev->state = THREAD_SUSPENDED;
+        } else if(prev->wake_ns > now && !prev->wake_pending) {
+            prev->state = THREAD_SLEEPING;
+            prev->next = rq->sleeping;
+            rq->sleeping = prev;
+        } else {
+            prev->wake_ns = 0;
+            prev->wake_pending = false;
+            enqueue_thread(rq, prev);
+        }
+    }
+    Thread* next = rq_pop(rq);
+    if(next) next->state = THREAD_RUNNING;
+    rq->steal_requested = false;
+    spin_unlock(&rq->lock);
+
+    if(!next) next = steal_thread(cpu);
+    if(!next) next = rq->idle;
+    if(next != prev && rq->fpu_owner == prev) {
+        fpu_save(prev->fpu_state);
+        rq->fpu_owner = nullptr;
+    }
+    if(next != prev && fpu_ready) fpu_set_ts();
+    if(prev == rq->idle && next != prev) prev->state = THREAD_READY;
+    if(prev->state == THREAD_DEAD) release_thread(prev);
+
+    next->state = THREAD_RUNNING;
+    next->cpu = cpu;
+    next->run_start_ns = now;
+    if(next != prev) rq->switches++;
+    rq->current = next;
+    rq->slice_start_ns = now;
+    program_timer(rq);
+    return &next->frame;
+}
+
+static InterruptFrame* sched_event(InterruptFrame* frame) {
+    if(!sched_ready) return frame;
+    RunQueue* rq = &run_queues[smp_current_cpu()];
+    if(!rq->current) return frame;
+
+    uint64_t now = clock_ns();
+    spin_lock(&rq->lock);
+    wake_sleepers(rq, now);
+    spin_unlock(&rq->lock);
+
+    Thread* current = rq->current;
+    if(current == rq->idle) {
+        if(rq->nr_ready || rq->steal_requested) return schedule(frame);
+    } else {
+        if(current->kill_pending || current->suspend_pending) return schedule(frame);
+        if(rq->nr_ready && now - rq->slice_start_ns >= SCHED_SLICE_NS) return schedule(frame);
+    }
+    program_timer(rq);
+    return frame;
+}
+
+InterruptFrame* sched_tick(InterruptFrame* frame) {
+    if(!sched_ready) return frame;
+    run_queues[smp_current_cpu()].armed_ns = 0;
+    return sched_event(frame);
+}
+
+static InterruptFrame* wake_interrupt(InterruptFrame* frame) {
+    return sched_event(frame);
+}
+
+static InterruptFrame* fpu_trap(InterruptFrame* frame) {
+    fpu_clear_ts();
+    if(!sched_ready) return frame;
+    RunQueue* rq = &run_queues[smp_current_cpu()];
+    Thread* t = rq->current;
+    if(!t || rq->fpu_owner == t) return frame;
+
+    if(!t->fpu_state) t->fpu_state = fpu_alloc_state();
+    fpu_restore(t->fpu_state);
+    if(t->fpu_state) rq->fpu_owner = t;
+    return frame;
+}
+
+static InterruptFrame* yield_interrupt(InterruptFrame* frame) {
+    if(!sched_ready || !run_queues[smp_current_cpu()].current) return frame;
+    return schedule(frame);
+}
+
+void sched_yield() {
+    if(sched_ready) __asm__ volatile("int %0" : : "i"(SCHED_YIELD_VECTOR) : "memory");
+}
+
+static Thread* current_thread() {
+    uint64_t flags = irq_save();
+    Thread* t = run_queues[smp_current_cpu()].current;
+    irq_restore(flags);
+    return t;
+}
+
+uint32_t sched_prepare_wait() {
+    Thread* t = sched_ready ? current_thread() : nullptr;
+    if(!t) return 0;
+    t->wake_pending = false;
+    return t->id;
+}
+
+void sched_sleep_ns(uint64_t ns) {
+    Thread* t = sched_ready ? current_thread() : nullptr;
+    if(!t || t == run_queues[t->cpu].idle) {
+        udelay(ns / 1000);
+        return;
+    }
+    uint64_t now = clock_ns();
+    t->wake_ns = ns >= SCHED_NO_DEADLINE - now ? SCHED_NO_DEADLINE : now + ns;
+    sched_yield();
+}
+
+void sched_exit() {
+    Thread* t = current_thread();
+    t->kill_pending = true;
+    while(true) sched_yield();
+}
+
+static void thread_start(Thread* t) {
+    t->entry(t->arg);
+    sched_exit();
+}
+
+static void idle_loop(void*) {
+    while(true) {
+        __asm__ volatile("cli" ::: "memory");
+        RunQueue* rq = &run_queues[smp_current_cpu()];
+        if(sched_has_mwait) {
+            __asm__ volatile("monitor" : : "a"(&rq->wake_word), "c"(0), "d"(0));
+        }
+        if(rq->nr_ready || rq->steal_requested) {
+            __asm__ volatile("sti" ::: "memory");
+            sched_yield();
+            continue;
+        }
+        if(sched_has_mwait) {
+            __asm__ volatile("sti; mwait" : : "a"(0), "c"(0) : "memory");
+        } else {
+            __asm__ volatile("sti; hlt" ::: "memory");
+        }
+    }
+}
+
+static Thread* alloc_thread(const char* name, int affinity) {
+    uint64_t flags = spin_lock_irqsave(&thread_table_lock);
+    Thread* t = nullptr;
+    for(int i = 0; i < MAX_THREADS; i++) {
+        if(threads[i].state == THREAD_FREE) {
+            t = &threads[i];
+            break;
+        }
+    }
+    if(t) {
+        memset(t, 0, sizeof(Thread));
+        t->id = next_thread_id++;
+        t->state = THREAD_SUSPENDED;
+        t->affinity = affinity;
+        int len = strlen(name);
+        if(len >= THREAD_NAME_LEN) len = THREAD_NAME_LEN - 1;
+        for(int i = 0; i < len; i++) t->name[i] = name[i];
+    }
+    spin_unlock_irqrestore(&thread_table_lock, flags);
+    return t;
+}
+
+static bool setup_stack(Thread* t, ThreadEntry entry, void* arg) {
+    t->stack_phys = pmm_alloc_pages(THREAD_STACK_ORDER);
+    if(!t->stack_phys) return false;
+    uint64_t top = (uint64_t)phys_to_virt(t->stack_phys) + THREAD_STACK_SIZE;
+    *(uint64_t*)(top - 8) = 0;
+
+    t->entry = entry;
+    t->arg = arg;
+    t->frame.rip = (uint64_t)thread_start;
+    t->frame.rdi = (uint64_t)t;
+    t->frame.cs = KERNEL_CS;
+    t->frame.ss = KERNEL_SS;
+    t->frame.rflags = 0x202;
+    t->frame.rsp = top - 8;
+    return true;
+}
+
+static uint32_t pick_cpu(int affinity) {
+    if(affinity >= 0) return affinity;
+    uint32_t best = 0;
+    for(uint32_t i = 0; i < smp_cpu_count; i++) {
+        RunQueue* rq = &run_queues[i];
+        if(!smp_cpu_online(i)) continue;
+        if(rq->current == rq->idle && rq->nr_ready == 0) return i;
+        if(rq->nr_ready < run_queues[best].nr_ready) best = i;
+    }
+    return best;
+}
+
+static RunQueue* lock_thread_queue(Thread* t, uint32_t id, uint64_t* flags) {
+    while(true) {
+        int cpu = t->cpu;
+        RunQueue* rq = &run_queues[cpu];
+        *flags = spin_lock_irqsave(&rq->lock);
+        if(t->id != id) {
+            spin_unlock_irqrestore(&rq->lock, *flags);
+            return nullptr;
+        }
+        if(t->cpu == cpu) return rq;
+        spin_unlock_irqrestore(&rq->lock, *flags);
+    }
+}
+
+static Thread* find_thread(uint32_t id) {
+    if(id == 0) return nullptr;
+    for(int i = 0; i < MAX_THREADS; i++) {
+        if(threads[i].id == id && threads[i].state != THREAD_FREE) return &threads[i];
+    }
+    return nullptr;
+}
+
+uint32_t sched_create_thread(const char* name, ThreadEntry entry, void* arg, int affinity) {
+    if(!sched_ready || affinity >= (int)smp_cpu_count) return 0;
+    if(affinity >= 0 && !smp_cpu_online(affinity)) return 0;
+    Thread* t = alloc_thread(name, affinity);
+    if(!t) return 0;
+    if(!setup_stack(t, entry, arg)) {
+        release_thread(t);
+        return 0;
+    }
+
+    uint32_t cpu = pick_cpu(affinity);
+    RunQueue* rq = &run_queues[cpu];
+    uint64_t flags = spin_lock_irqsave(&rq->lock);
+    t->cpu = cpu;
+    enqueue_thread(rq, t);
+    spin_unlock_irqrestore(&rq->lock, flags);
+    kick_for_thread(t, cpu);
+    return t->id;
+}
+
+bool sched_suspend(uint32_t id) {
+    Thread* t = find_thread(id);
+    if(!t || t->system) return false;
+    uint64_t flags;
+    RunQueue* rq = lock_thread_queue(t, id, &flags);
+    if(!rq) return false;
+
+    bool ok = true;
+    if(t->state == THREAD_READY) {
+        rq_remove(rq, t);
+        t->state = THREAD_SUSPENDED;
+    } else if(t->state == THREAD_SLEEPING) {
+        sleep_remove(rq, t);
+        t->wake_ns = 0;
+        t->state = THREAD_SUSPENDED;
+    } else if(t->state == THREAD_RUNNING) {
+        t->suspend_pending = true;
+    } else {
+        ok = false;
+    }
+    spin_unlock_irqrestore(&rq->lock, flags);
+    return ok;
+}
+
+bool sched_resume(uint32_t id) {
+    Thread* t = find_thread(id);
+    if(!t) return false;
+    uint64_t flags;
+    RunQueue* rq = lock_thread_queue(t, id, &flags);
+    if(!rq) return false;
+
+    bool ok = true;
+    bool kick = false;
+    if(t->state == THREAD_SUSPENDED) {
+        enqueue_thread(rq, t);
+        kick = true;
+    } else if(t->suspend_pending) {
+        t->suspend_pending = false;
+    } else {
+        ok = false;
+    }
+    int cpu = t->cpu;
+    spin_unlock_irqrestore(&rq->lock, flags);
+    if(kick) kick_for_thread(t, cpu);
+    return ok;
+}
+
+bool sched_wake(uint32_t id) {
+    Thread* t = find_thread(id);
+    if(!t) return false;
+    uint64_t flags;
+    RunQueue* rq = lock_thread_queue(t, id, &flags);
+    if(!rq) return false;
+
+    bool kick = false;
+    if(t->state == THREAD_SLEEPING) {
+        sleep_remove(rq, t);
+        t->wake_ns = 0;
+        enqueue_thread(rq, t);
+        kick = true;
+    } else if(t->state == THREAD_RUNNING || t->state == THREAD_READY) {
+        t->wake_pending = true;
+    }
+    int cpu = t->cpu;
+    spin_unlock_irqrestore(&rq->lock, flags);
+    if(kick) kick_for_thread(t, cpu);
+    return true;
+}
+
+bool sched_kill(uint32_t id) {
+    Thread* t = find_thread(id);
+    if(!t || t->system) return false;
+    uint64_t flags;
+    RunQueue* rq = lock_thread_queue(t, id, &flags);
+    if(!rq) return false;
+
+    bool release = false;
+    if(t->state == THREAD_READY) {
+        rq_remove(rq, t);
+        release = true;
+    } else if(t->state == THREAD_SLEEPING) {
+        sleep_remove(rq, t);
+        release = true;
+    } else if(t->state == THREAD_SUSPENDED) {
+        release = true;
+    } else if(t->state == THREAD_RUNNING) {
+        t->kill_pending = true;
+    }
+    if(release) t->state = THREAD_DEAD;
+    spin_unlock_irqrestore(&rq->lock, flags);
+    if(release) release_thread(t);
+    return true;
+}
+
+void sched_join(uint32_t id) {
+    while(true) {
+        uint32_t self = sched_prepare_wait();
+        uint64_t flags = spin_lock_irqsave(&thread_table_lock);
+        Thread* t = find_thread(id);
+        if(t) t->joiner = self;
+        spin_unlock_irqrestore(&thread_table_lock, flags);
+        if(!t) return;
+        if(!self) {
+            sched_yield();
+            continue;
+        }
+        sched_sleep_ns(SCHED_NO_DEADLINE);
+    }
+}
+
+bool sched_get_thread_info(uint32_t id, int* state_out, int* cpu_out, uint64_t* time_out) {
+    Thread* t = find_thread(id);
+    if(!t) return false;
+    if(state_out) *state_out = t->state;
+    if(cpu_out) *cpu_out = t->cpu;
+    if(time_out) *time_out = t->cpu_time_ns;
+    return true;
+}
+
+uint64_t sched_thread_cpu_time(uint32_t id) {
+    uint64_t time = 0;
+    sched_get_thread_info(id, nullptr, nullptr, &time);
+    return time;
+}
+
+int sched_get_thread_list(uint32_t* ids, int max_count) {
+    int count = 0;
+    for(int i = 0; i < MAX_THREADS && count < max_count; i++) {
+        if(threads[i].state != THREAD_FREE && threads[i].state != THREAD_DEAD) ids[count++] = threads[i].id;
+    }
+    return count;
+}
+
+bool sched_get_thread_name(uint32_t id, char* name_out) {
+    Thread* t = find_thread(id);
+    if(!t) return false;
+    strcpy(name_out, t->name);
+    return true;
+}
+
+void sched_get_cpu_stats(uint32_t cpu, uint32_t* ready_out, uint64_t* switches_out, uint64_t* steals_out) {
+    if(cpu >= MAX_CPUS) return;
+    *ready_out = run_queues[cpu].nr_ready;
+    *switches_out = run_queues[cpu].switches;
+    *steals_out = run_queues[cpu].steals;
+}
+
+void sched_init_cpu(uint32_t cpu) {
+    Thread* idle = alloc_thread("idle", cpu);
+    if(!idle) return;
+    idle->system = true;
+    RunQueue* rq = &run_queues[cpu];
+    uint64_t flags = spin_lock_irqsave(&rq->lock);
+    idle->cpu = cpu;
+    idle->state = THREAD_RUNNING;
+    idle->run_start_ns = clock_ns();
+    rq->idle = idle;
+    rq->current = idle;
+    rq->slice_start_ns = idle->run_start_ns;
+    spin_unlock_irqrestore(&rq->lock, flags);
+}
+
+void sched_idle() {
+    idle_loop(nullptr);
+}
+
+bool sched_init() {
+    memset(threads, 0, sizeof(threads));
+    memset(run_queues, 0, sizeof(run_queues));
+
+    Thread* boot = alloc_thread("kernel", 0);
+    Thread* idle = alloc_thread("idle", 0);
+    if(!boot || !idle || !setup_stack(idle, idle_loop, nullptr)) return false;
+
+    boot->system = true;
+    idle->system = true;
+    boot->cpu = 0;
+    boot->state = THREAD_RUNNING;
+    boot->run_start_ns = clock_ns();
+    idle->cpu = 0;
+    idle->state = THREAD_READY;
+
+    RunQueue* rq = &run_queues[0];
+    rq->current = boot;
+    rq->idle = idle;
+    rq->slice_start_ns = boot->run_start_ns;
+    if(fpu_ready) fpu_set_ts();
+
+    uint32_t eax, ebx, ecx, edx;
+    __asm__ volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(1), "c"(0));
+    sched_has_mwait = (ecx >> 3) & 1;
+
+    register_software_interrupt(SCHED_YIELD_VECTOR, yield_interrupt);
+    register_interrupt_handler(SCHED_WAKE_VECTOR, wake_interrupt);
+    if(fpu_ready) register_interrupt_handler(NM_VECTOR, fpu_trap);
+    interrupts_set_stack(SCHED_YIELD_VECTOR, SCHED_IST);
+    interrupts_set_stack(SCHED_WAKE_VECTOR, SCHED_IST);
+    interrupts_set_stack(TIMER_VECTOR, SCHED_IST);
+    sched_ready = true;
+    return true;
+}
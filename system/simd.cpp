@@ -0,0 +1,215 @@
+#include <stdint.h>
+#include <stddef.h>
+
+typedef long long v16 __attribute__((vector_size(16), may_alias, aligned(1)));
+typedef long long v32 __attribute__((vector_size(32), may_alias, aligned(1)));
+
+void* memcpy_sse2(void* dest, const void* src, size_t n) {
+    uint8_t* d = (uint8_t*)dest;
+    const uint8_t* s = (const uint8_t*)src;
+    while(n >= 64) {
+        v16 a = *(const v16*)(s + 0);
+        v16 b = *(const v16*)(s + 16);
+        v16 c = *(const v16*)(s + 32);
+        v16 e = *(const v16*)(s + 48);
+        *(v16*)(d + 0) = a;
+        *(v16*)(d + 16) = b;
+        *(v16*)(d + 32) = c;
+        *(v16*)(d + 48) = e;
+        s += 64; d += 64; n -= 64;
+    }
+    while(n >= 16) {
+        *(v16*)d = *(const v16*)s;
+        s += 16; d += 16; n -= 16;
+    }
+    if(n) __asm__ volatile("rep movsb" : "+D"(d), "+S"(s), "+c"(n) : : "memory");
+    return dest;
+}
+
+void* memset_sse2(void* dest, int c, size_t n) {
+    uint8_t* d = (uint8_t*)dest;
+    long long pattern = (long long)(0x0101010101010101ULL * (uint8_t)c);
+    v16 value = {pattern, pattern};
+    while(n >= 64) {
+        *(v16*)(d + 0) = value;
+        *(v16*)(d + 16) = value;
+        *(v16*)(d + 32) = value;
+        *(v16*)(d + 48) = value;
+        d += 64; n -= 64;
+    }
+    while(n >= 16) {
+        *(v16*)d = value;
+        d += 16; n -= 16;
+    }
+    if(n) __asm__ volatile("rep stosb" : "+D"(d), "+c"(n) : "a"(c) : "memory");
+    return dest;
+}
+
+__attribute__((target("avx")))
+void* memcpy_avx(void* dest, const void* src, size_t n) {
+    uint8_t* d = (uint8_t*)dest;
+    const uint8_t* s = (const uint8_t*)src;
+    while(n >= 128) {
+        v32 a = *(const v32*)(s + 0);
+        v32 b = *(const v32*)(s + 32);
+        v32 c = *(const v32*)(s + 64);
+        v32 e = *(const v32*)(s + 96);
+        *(v32*)(d + 0) = a;
+        *(v32*)(d + 32) = b;
+        *(v32*)(d + 64) = c;
+        *(v32*)(d + 96) = e;
+        s += 128; d += 128; n -= 128;
+    }
+    while(n >= 32) {
+        *(v32*)d = *(const v32*)s;
+        s += 32; d += 32; n -= 32;
+    }
+    if(n) __asm__ volatile("rep movsb" : "+D"(d), "+S"(s), "+c"(n) : : "memory");
+    return dest;
+}
+
+__attribute__((target("avx")))
+void* memset_avx(void* dest, int c, size_t n) {
+    uint8_t* d = (uint8_t*)dest;
+    long long pattern = (long long)(0x0101010101010101ULL * (uint8_t)c);
+    v32 value = {pattern, pattern, pattern, pattern};
+    while(n >= 128) {
+        *(v32*)(d + 0) = value;
+        *(v32*)(d + 32) = value;
+        *(v32*)(d + 64) = value;
+        *(v32*)(d + 96) = value;
+        d += 128; n -= 128;
+    }
+    while(n >= 32) {
+        *(v32*)d = value;
+        d += 32; n -= 32;
+    }
+    if(n) __asm__ volatile("rep stosb" : "+D"(d), "+c"(n) : "a"(c) : "memory");
+    return dest;
+}
+
+typedef char v16c __attribute__((vector_size(16), may_alias));
+typedef char v16cu __attribute__((vector_size(16), may_alias, aligned(1)));
+
+size_t strlen_sse2(const char* str) {
+    const char* p = (const char*)((uintptr_t)str & ~(uintptr_t)15);
+    v16c zero = {};
+    uint32_t mask = __builtin_ia32_pmovmskb128((v16c)(*(const v16c*)p == zero));
+    mask >>= str - p;
+    if(mask) return __builtin_ctz(mask);
+    while(true) {
+        p += 16;
+        mask = __builtin_ia32_pmovmskb128((v16c)(*(const v16c*)p == zero));
+        if(mask) return p + __builtin_ctz(mask) - str;
+    }
+}
+
+void* memchr_sse2(const void* s, int c, size_t n) {
+    const char* p = (const char*)s;
+    v16c needle = {};
+    needle += (char)c;
+    while(n >= 16) {
+        uint32_t mask = __builtin_ia32_pmovmskb128((v16c)(*(const v16cu*)p == needle));
+        if(mask) return (void*)(p + __builtin_ctz(mask));
+        p += 16;
+        n -= 16;
+    }
+    for(; n; n--, p++) {
+        if(*p == (char)c) return (void*)p;
+    }
+    return nullptr;
+}
+
+typedef int v4i __attribute__((vector_size(16), may_alias, aligned(1)));
+typedef int v8i __attribute__((vector_size(32), may_alias, aligned(1)));
+typedef unsigned short v8u __attribute__((vector_size(16)));
+typedef unsigned short v16u __attribute__((vector_size(32)));
+typedef short v8s __attribute__((vector_size(16)));
+typedef short v16s __attribute__((vector_size(32)));
+typedef char v32c __attribute__((vector_size(32)));
+
+void pixel_copy_sse2(uint32_t* dst, const uint32_t* src, int count) {
+    memcpy_sse2(dst, src, (size_t)count * 4);
+}
+
+void pixel_copy_key_sse2(uint32_t* dst, const uint32_t* src, int count, uint32_t key) {
+    v4i keys = {(int)key, (int)key, (int)key, (int)key};
+    while(count >= 4) {
+        v4i s = *(const v4i*)src;
+        v4i d = *(const v4i*)dst;
+        v4i hit = s == keys;
+        *(v4i*)dst = (d & hit) | (s & ~hit);
+        dst += 4; src += 4; count -= 4;
+    }
+    for(; count > 0; count--, dst++, src++) {
+        if(*src != key) *dst = *src;
+    }
+}
+
+static inline v8u blend_words_sse2(v8u d, v8u s) {
+    v8u alpha = (v8u)__builtin_ia32_pshufhw(__builtin_ia32_pshuflw((v8s)s, 0xFF), 0xFF);
+    v8u t = d * (255 - alpha) + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+void pixel_over_sse2(uint32_t* dst, const uint32_t* src, int count) {
+    v16c zero = {};
+    while(count >= 4) {
+        v16c s = *(const v16cu*)src;
+        v16c d = *(const v16cu*)dst;
+        v8u lo = blend_words_sse2((v8u)__builtin_ia32_punpcklbw128(d, zero), (v8u)__builtin_ia32_punpcklbw128(s, zero));
+        v8u hi = blend_words_sse2((v8u)__builtin_ia32_punpckhbw128(d, zero), (v8u)__builtin_ia32_punpckhbw128(s, zero));
+        v16c packed = __builtin_ia32_packuswb128((v8s)lo, (v8s)hi);
+        *(v16cu*)dst = __builtin_ia32_paddusb128(packed, s);
+        dst += 4; src += 4; count -= 4;
+    }
+    for(; count > 0; count--, dst++, src++) {
+        uint32_t s = *src;
+        uint32_t inv = 255 - (s >> 24);
+        uint32_t rb = (*dst & 0x00FF00FF) * inv + 0x00800080;
+        uint32_t ag = ((*dst >> 8) & 0x00FF00FF) * inv + 0x00800080;
+        rb = ((rb + ((rb >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+        ag = (ag + ((ag >> 8) & 0x00FF00FF)) & 0xFF00FF00;
+        *dst = s + (rb | ag);
+    }
+}
+
+__attribute__((target("avx2")))
+void pixel_copy_avx2(uint32_t* dst, const uint32_t* src, int count) {
+    memcpy_avx(dst, src, (size_t)count * 4);
+}
+
+__attribute__((target("avx2")))
+void pixel_copy_key_avx2(uint32_t* dst, const uint32_t* src, int count, uint32_t key) {
+    v8i keys = {(int)key, (int)key, (int)key, (int)key, (int)key, (int)key, (int)key, (int)key};
+    while(count >= 8) {
+        v8i s = *(const v8i*)src;
+        v8i d = *(const v8i*)dst;
+        v8i hit = s == keys;
+        *(v8i*)dst = (d & hit) | (s & ~hit);
+        dst += 8; src += 8; count -= 8;
+    }
+    pixel_copy_key_sse2(dst, src, count, key);
+}
+
+__attribute__((target("avx2")))
+static inline v16u blend_words_avx2(v16u d, v16u s) {
+    v16u alpha = (v16u)__builtin_ia32_pshufhw256(__builtin_ia32_pshuflw256((v16s)s, 0xFF), 0xFF);
+    v16u t = d * (255 - alpha) + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+__attribute__((target("avx2")))
+void pixel_over_avx2(uint32_t* dst, const uint32_t* src, int count) {
+    v32c zero = {};
+    while(count >= 8) {
+        v32c s = (v32c)*(const v8i*)src;
+        v32c d = (v32c)*(const v8i*)dst;
+        v16u lo = blend_words_avx2((v16u)__builtin_ia32_punpcklbw256(d, zero), (v16u)__builtin_ia32_punpcklbw256(s, zero));
+        v16u hi = blend_words_avx2((v16u)__builtin_ia32_punpckhbw256(d, zero), (v16u)__builtin_ia32_punpckhbw256(s, zero));
+        v32c packed = __builtin_ia32_packuswb256((v16s)lo, (v16s)hi);
+        *(v8i*)dst = (v8i)__builtin_ia32_paddusb256(packed, s);
+        dst += 8; src += 8; count -= 8;
+    }
+    pixel_over_sse2(dst, src, count);
+}
@@ -0,0 +1,270 @@
+#include <stdint.h>
+#include <stddef.h>
+#include "limine.h"
+
+struct InterruptFrame;
+typedef InterruptFrame* (*InterruptHandler)(InterruptFrame* frame);
+
+extern void* memset(void *s, int c, size_t n);
+extern void register_interrupt_handler(uint8_t vector, InterruptHandler handler);
+extern bool interrupts_init_cpu(int cpu);
+extern bool lapic_init();
+extern uint32_t lapic_id();
+extern void lapic_send_ipi(uint32_t apic_id, uint8_t vector);
+extern void vmm_load_kernel_space();
+extern bool vmm_active;
+extern uint64_t pmm_alloc_pages(int order);
+extern void* phys_to_virt(uint64_t phys);
+extern void udelay(uint64_t us);
+extern void sched_init_cpu(uint32_t cpu);
+extern void sched_idle();
+extern bool fpu_ready;
+extern void fpu_init_cpu();
+
+#define MAX_CPUS 64
+#define CPU_STACK_ORDER 3
+#define CPU_STACK_SIZE (4096 << CPU_STACK_ORDER)
+#define SMP_CALL_QUEUE 32
+#define CALL_VECTOR 0xF0
+#define MSR_GS_BASE 0xC0000101
+#define AP_STARTUP_TIMEOUT_US 1000000
+
+typedef void (*SMPFunction)(void* arg);
+
+struct SMPCall {
+    SMPFunction fn;
+    void* arg;
+    volatile uint32_t* done;
+};
+
+struct CPUData {
+    CPUData* self;
+    uint64_t stack_top;
+    uint32_t index;
+    uint32_t lapic_id;
+    volatile bool online;
+    uint32_t call_lock;
+    uint32_t call_head;
+    uint32_t call_tail;
+    SMPCall calls[SMP_CALL_QUEUE];
+    uint64_t ipi_count;
+};
+
+static CPUData cpu_data[MAX_CPUS];
+uint32_t smp_cpu_count = 1;
+volatile uint32_t smp_online_count = 1;
+static volatile uint32_t smp_failed_count = 0;
+
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ volatile("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+uint64_t irq_save() {
+    uint64_t flags;
+    __asm__ volatile("pushfq; popq %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+void irq_restore(uint64_t flags) {
+    if(flags & 0x200) __asm__ volatile("sti" ::: "memory");
+}
+
+void spin_lock(uint32_t* lock) {
+    while(__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE)) {
+        while(__atomic_load_n(lock, __ATOMIC_RELAXED)) __asm__ volatile("pause");
+    }
+}
+
+void spin_unlock(uint32_t* lock) {
+    __atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+}
+
+uint64_t spin_lock_irqsave(uint32_t* lock) {
+    uint64_t flags = irq_save();
+    spin_lock(lock);
+    return flags;
+}
+
+void spin_unlock_irqrestore(uint32_t* lock, uint64_t flags) {
+    spin_unlock(lock);
+    irq_restore(flags);
+}
+
+CPUData* this_cpu() {
+    CPUData* cpu;
+    __asm__ volatile("movq %%gs:0, %0" : "=r"(cpu));
+    return cpu;
+}
+
+uint32_t smp_current_cpu() {
+    uint32_t index;
+    __asm__ volatile("movl %%gs:16, %0" : "=r"(index));
+    return index;
+}
+
+static void smp_process_calls(CPUData* cpu) {
+    while(true) {
+        uint64_t flags = spin_lock_irqsave(&cpu->call_lock);
+        if(cpu->call_tail == cpu->call_head) {
+            spin_unlock_irqrestore(&cpu->call_lock, flags);
+            return;
+        }
+        SMPCall call = cpu->calls[cpu->call_tail % SMP_CALL_QUEUE];
+        cpu->call_tail++;
+        spin_unlock_irqrestore(&cpu->call_lock, flags);
+
+        call.fn(call.arg);
+        if(call.done) __atomic_store_n(call.done, 1, __ATOMIC_RELEASE);
+    }
+}
+
+static InterruptFrame* call_interrupt(InterruptFrame* frame) {
+    CPUData* cpu = this_cpu();
+    cpu->ipi_count++;
+    smp_process_calls(cpu);
+    return frame;
+}
+
+bool smp_call_function(uint32_t target, SMPFunction fn, void* arg, bool wait) {
+    if(target >= smp_cpu_count || !cpu_data[target].online) return false;
+
+    if(target == smp_current_cpu()) {
+        fn(arg);
+        return true;
+    }
+
+    volatile uint32_t done = 0;
+    CPUData* cpu = &cpu_data[target];
+    while(true) {
+        uint64_t flags = spin_lock_irqsave(&cpu->call_lock);
+        if(cpu->call_head - cpu->call_tail < SMP_CALL_QUEUE) {
+            SMPCall* call = &cpu->calls[cpu->call_head % SMP_CALL_QUEUE];
+            call->fn = fn;
+            call->arg = arg;
+            call->done = wait ? &done : nullptr;
+            cpu->call_head++;
+            spin_unlock_irqrestore(&cpu->call_lock, flags);
+            break;
+        }
+        spin_unlock_irqrestore(&cpu->call_lock, flags);
+        smp_process_calls(this_cpu());
+        __asm__ volatile("pause");
+    }
+
+    lapic_send_ipi(cpu->lapic_id, CALL_VECTOR);
+
+    if(wait) {
+        while(!__atomic_load_n(&done, __ATOMIC_ACQUIRE)) {
+            smp_process_calls(this_cpu());
+            __asm__ volatile("pause");
+        }
+    }
+    return true;
+}
+
+void smp_call_others(SMPFunction fn, void* arg, bool wait) {
+    uint32_t self = smp_current_cpu();
+    for(uint32_t i = 0; i < smp_cpu_count; i++) {
+        if(i != self && cpu_data[i].online) smp_call_function(i, fn, arg, wait);
+    }
+}
+
+static void flush_tlb_local(void*) {
+    uint64_t cr4;
+    __asm__ volatile("mov %%cr4, %0" : "=r"(cr4));
+    __asm__ volatile("mov %0, %%cr4" : : "r"(cr4 & ~(1ULL << 7)) : "memory");
+    __asm__ volatile("mov %0, %%cr4" : : "r"(cr4) : "memory");
+}
+
+void smp_flush_tlb_others() {
+    if(smp_online_count > 1) smp_call_others(flush_tlb_local, nullptr, true);
+}
+
+bool smp_cpu_online(uint32_t index) {
+    return index < smp_cpu_count && cpu_data[index].online;
+}
+
+uint32_t smp_cpu_lapic_id(uint32_t index) {
+    return index < smp_cpu_count ? cpu_data[index].lapic_id : 0;
+}
+
+uint64_t smp_cpu_ipi_count(uint32_t index) {
+    return index < smp_cpu_count ? cpu_data[index].ipi_count : 0;
+}
+
+static void load_cpu_data(CPUData* cpu) {
+    wrmsr(MSR_GS_BASE, (uint64_t)cpu);
+}
+
+extern "C" void ap_main(CPUData* cpu) {
+    if(vmm_active) vmm_load_kernel_space();
+    if(!interrupts_init_cpu(cpu->index)) {
+        __atomic_fetch_add(&smp_failed_count, 1, __ATOMIC_ACQ_REL);
+        for(;;) __asm__ volatile("cli; hlt");
+    }
+    load_cpu_data(cpu);
+    if(fpu_ready) fpu_init_cpu();
+    lapic_init();
+    sched_init_cpu(cpu->index);
+
+    __atomic_store_n(&cpu->online, true, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&smp_online_count, 1, __ATOMIC_ACQ_REL);
+
+    sched_idle();
+}
+
+extern "C" void ap_trampoline(struct limine_smp_info* info);
+
+__asm__(
+    ".section .text\n"
+    ".global ap_trampoline\n"
+    "ap_trampoline:\n"
+    "    movq 24(%rdi), %rdi\n"
+    "    movq 8(%rdi), %rsp\n"
+    "    xorq %rbp, %rbp\n"
+    "    call ap_main\n"
+    "1:  cli\n"
+    "    hlt\n"
+    "    jmp 1b\n"
+);
+
+void smp_init_bsp() {
+    memset(cpu_data, 0, sizeof(cpu_data));
+    cpu_data[0].self = &cpu_data[0];
+    cpu_data[0].index = 0;
+    cpu_data[0].online = true;
+    load_cpu_data(&cpu_data[0]);
+}
+
+void smp_init(struct limine_smp_response* smp) {
+    cpu_data[0].lapic_id = lapic_id();
+    register_interrupt_handler(CALL_VECTOR, call_interrupt);
+    if(!smp) return;
+
+    uint32_t index = 1;
+    for(uint64_t i = 0; i < smp->cpu_count && index < MAX_CPUS; i++) {
+        struct limine_smp_info* info = smp->cpus[i];
+        if(info->lapic_id == smp->bsp_lapic_id) continue;
+
+        uint64_t stack = pmm_alloc_pages(CPU_STACK_ORDER);
+        if(!stack) break;
+
+        CPUData* cpu = &cpu_data[index];
+        cpu->self = cpu;
+        cpu->index = index;
+        cpu->lapic_id = info->lapic_id;
+        cpu->stack_top = (uint64_t)phys_to_virt(stack) + CPU_STACK_SIZE;
+        index++;
+
+        info->extra_argument = (uint64_t)cpu;
+        __atomic_store_n(&info->goto_address, (limine_goto_address)ap_trampoline, __ATOMIC_RELEASE);
+    }
+    smp_cpu_count = index;
+
+    for(uint64_t waited = 0; waited < AP_STARTUP_TIMEOUT_US; waited += 100) {
+        uint32_t done = __atomic_load_n(&smp_online_count, __ATOMIC_ACQUIRE) +
+                        __atomic_load_n(&smp_failed_count, __ATOMIC_ACQUIRE);
+        if(done == smp_cpu_count) break;
+        udelay(100);
+    }
+}
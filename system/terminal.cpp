@@ -1,7 +1,6 @@
 #include <stdint.h>
 #include <stddef.h>
 
-extern uint32_t* fb_ptr;
 extern uint64_t fb_width;
 extern uint64_t fb_height;
 extern uint64_t fb_pitch;
@@ -11,7 +10,6 @@ extern bool boot_menu_active;
 extern uint32_t cpu_core_count;
 extern uint64_t total_memory_kb;
 extern uint64_t free_memory_kb;
-extern uint64_t uptime_seconds;
 extern char cpu_brand_string[];
 
 char current_directory[64] = "/";
@@ -28,10 +26,57 @@ extern char* strcat(char *dest, const char *src);
 extern void uint_to_str(uint64_t n, char* buffer);
 extern void process_command(const char* cmd);
 extern void handle_gui_click(int x, int y, bool right_click);
-extern void refresh_all_windows();
+enum AppID {
+    APP_NONE = 0,
+    APP_TERMINAL = 1,
+    APP_BROWSER = 2,
+    APP_FILEMANAGER = 3
+};
+
+extern void invalidate_window_rect(AppID app, int x, int y, int w, int h);
+extern bool scroll_window_rect(AppID app, int x, int y, int w, int h, int dy);
+extern void refresh_region(int x, int y, int w, int h);
+
+extern struct TerminalWindow {
+    int x, y, w, h;
+    bool minimized;
+    bool maximized;
+} term_win;
 extern bool is_hlfs_enabled();
 extern void get_filesystem_name(char* output);
 
+struct MousePacket {
+    uint8_t buttons;
+    int16_t dx;
+    int16_t dy;
+};
+
+extern void input_poll_controller();
+extern bool input_read_scancode(uint8_t* scancode);
+extern bool input_read_mouse(MousePacket* packet);
+extern void input_wait();
+
+struct GfxRect {
+    int x0, y0, x1, y1;
+};
+
+extern uint32_t* gfx_buffer;
+extern uint64_t gfx_stride;
+extern int gfx_origin_x;
+extern int gfx_origin_y;
+extern GfxRect gfx_clip;
+extern bool gfx_recording;
+extern void gfx_record_glyph(const uint8_t* rows, int x, int y, uint32_t color);
+extern bool gfx_clip_rect(int* x, int* y, int* w, int* h);
+extern void gfx_damage(int x, int y, int w, int h);
+extern void gfx_fill_rect(int x, int y, int w, int h, uint32_t color);
+extern void gfx_blend_rect(int x, int y, int w, int h, uint32_t color, uint8_t alpha);
+extern void gfx_scroll_rect(int x, int y, int w, int h, int dy);
+extern void gfx_set_cursor(int x, int y);
+extern void gfx_lift_cursor();
+extern void gfx_clear(uint32_t color);
+extern void gfx_flush();
+
 static uint8_t font8x8_basic[128][8] = {
     {0}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {0},
     {0}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {0}, {0},
@@ -133,46 +178,130 @@ static uint8_t font8x8_basic[128][8] = {
     {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00} 
 };
 
+static inline void plot(int x, int y, uint32_t color) {
+    if(x < gfx_clip.x0 || x >= gfx_clip.x1 || y < gfx_clip.y0 || y >= gfx_clip.y1) return;
+    if(gfx_recording) {
+        gfx_fill_rect(x, y, 1, 1, color);
+        return;
+    }
+    gfx_buffer[(y - gfx_origin_y) * gfx_stride + (x - gfx_origin_x)] = color;
+}
+
 void put_pixel(int x, int y, uint32_t color) {
-    if(x < 0 || x >= (int)fb_width || y < 0 || y >= (int)fb_height) return;
-    fb_ptr[y * (fb_pitch / 4) + x] = color;
+    plot(x, y, color);
+    gfx_damage(x, y, 1, 1);
 }
 
 void draw_rect(int x, int y, int w, int h, uint32_t color) {
-    for(int j = 0; j < h; j++) {
-        for(int i = 0; i < w; i++) {
-            put_pixel(x + i, y + j, color);
-        }
-    }
+    gfx_fill_rect(x, y, w, h, color);
 }
 
 void draw_rounded_rect(int x, int y, int w, int h, uint32_t color) {
+    if(w >= 4 && h >= 4) {
+        gfx_fill_rect(x+2, y, w-4, 1, color);
+        gfx_fill_rect(x+1, y+1, w-2, 1, color);
+        gfx_fill_rect(x, y+2, w, h-4, color);
+        gfx_fill_rect(x+1, y+h-2, w-2, 1, color);
+        gfx_fill_rect(x+2, y+h-1, w-4, 1, color);
+        return;
+    }
     draw_rect(x+2, y, w-4, h, color);
     draw_rect(x, y+2, w, h-4, color);
-    put_pixel(x+1, y+1, color);
-    put_pixel(x+w-2, y+1, color);
-    put_pixel(x+1, y+h-2, color);
-    put_pixel(x+w-2, y+h-2, color);
+    plot(x+1, y+1, color);
+    plot(x+w-2, y+1, color);
+    plot(x+1, y+h-2, color);
+    plot(x+w-2, y+h-2, color);
+    gfx_damage(x, y, w, h);
 }
 
-void draw_char(char c, int x, int y, uint32_t color) {
-    if(c < 0 || c > 127) return;
-    for(int i=0; i<8; i++) {
-        for(int j=0; j<8; j++) {
-            if((font8x8_basic[(int)c][i] >> (7-j)) & 1) {
-                put_pixel(x+j, y+i, color);
-            }
+void draw_translucent_rounded_rect(int x, int y, int w, int h, uint32_t color, uint8_t alpha) {
+    if(w < 4 || h < 4) {
+        gfx_blend_rect(x, y, w, h, color, alpha);
+        return;
+    }
+    gfx_blend_rect(x+2, y, w-4, 1, color, alpha);
+    gfx_blend_rect(x+1, y+1, w-2, 1, color, alpha);
+    gfx_blend_rect(x, y+2, w, h-4, color, alpha);
+    gfx_blend_rect(x+1, y+h-2, w-2, 1, color, alpha);
+    gfx_blend_rect(x+2, y+h-1, w-4, 1, color, alpha);
+}
+
+struct GlyphRuns {
+    uint8_t count;
+    uint8_t start[4];
+    uint8_t len[4];
+};
+
+static GlyphRuns glyph_runs[256];
+static bool glyph_runs_ready = false;
+
+static void build_glyph_runs() {
+    for(int bits = 0; bits < 256; bits++) {
+        GlyphRuns* runs = &glyph_runs[bits];
+        runs->count = 0;
+        for(int j = 0; j < 8; j++) {
+            if(!((bits >> (7 - j)) & 1)) continue;
+            int start = j;
+            while(j < 8 && ((bits >> (7 - j)) & 1)) j++;
+            runs->start[runs->count] = start;
+            runs->len[runs->count] = j - start;
+            runs->count++;
         }
     }
+    glyph_runs_ready = true;
+}
+
+static void draw_glyph(char c, int x, int y, uint32_t color) {
+    if((unsigned char)c > 127) return;
+    if(!glyph_runs_ready) build_glyph_runs();
+    if(x >= gfx_clip.x1 || x + 8 <= gfx_clip.x0) return;
+    
+    const uint8_t* rows = font8x8_basic[(int)c];
+    if(gfx_recording) {
+        gfx_record_glyph(rows, x, y, color);
+        return;
+    }
+    for(int i = 0; i < 8; i++) {
+        int py = y + i;
+        if(py < gfx_clip.y0 || py >= gfx_clip.y1 || !rows[i]) continue;
+        const GlyphRuns* runs = &glyph_runs[rows[i]];
+        uint32_t* line = gfx_buffer + (py - gfx_origin_y) * gfx_stride;
+        for(int r = 0; r < runs->count; r++) {
+            int x0 = x + runs->start[r];
+            int x1 = x0 + runs->len[r];
+            if(x0 < gfx_clip.x0) x0 = gfx_clip.x0;
+            if(x1 > gfx_clip.x1) x1 = gfx_clip.x1;
+            for(int px = x0; px < x1; px++) line[px - gfx_origin_x] = color;
+        }
+    }
+}
+
+static void draw_glyph_scaled(char c, int x, int y, int scale_x, int scale_y, uint32_t color) {
+    if((unsigned char)c > 127) return;
+    if(!glyph_runs_ready) build_glyph_runs();
+    
+    const uint8_t* rows = font8x8_basic[(int)c];
+    for(int i = 0; i < 8; i++) {
+        const GlyphRuns* runs = &glyph_runs[rows[i]];
+        for(int r = 0; r < runs->count; r++) {
+            gfx_fill_rect(x + runs->start[r] * scale_x, y + i * scale_y, runs->len[r] * scale_x, scale_y, color);
+        }
+    }
+}
+
+void draw_char(char c, int x, int y, uint32_t color) {
+    draw_glyph(c, x, y, color);
+    gfx_damage(x, y, 8, 8);
 }
 
 void draw_string(const char* str, int x, int y, uint32_t color) {
     int offset = 0;
     while(*str) {
-        draw_char(*str, x + offset, y, color);
+        draw_glyph(*str, x + offset, y, color);
         offset += 8;
         str++;
     }
+    gfx_damage(x, y, offset, 8);
 }
 
 void draw_background_logo() {
@@ -181,11 +310,7 @@ void draw_background_logo() {
         int y = (i * 54321 + 67890) % fb_height;
         int size = (i % 3) + 1;
         
-        for(int dy = 0; dy < size; dy++) {
-            for(int dx = 0; dx < size; dx++) {
-                put_pixel(x + dx, y + dy, 0x1a1a2e);
-            }
-        }
+        draw_rect(x, y, size, size, 0x1a1a2e);
     }
 }
 
@@ -202,9 +327,7 @@ static inline uint8_t inb(uint16_t port) {
 }
 
 void draw_modern_boot_menu() {
-    for(uint64_t i = 0; i < fb_width * fb_height; i++) {
-        fb_ptr[i] = 0x000000;
-    }
+    gfx_clear(0x000000);
     
     int center_x = fb_width / 2;
     int center_y = fb_height / 2;
@@ -214,13 +337,7 @@ void draw_modern_boot_menu() {
     int logo_y = center_y - 100;
     
     for(int i = 0; logo[i]; i++) {
-        for(int dy = 0; dy < 24; dy++) {
-            for(int dx = 0; dx < 16; dx++) {
-                if((font8x8_basic[(int)logo[i]][dy / 3] >> (7 - dx / 2)) & 1) {
-                    put_pixel(logo_x + i * 20 + dx, logo_y + dy, 0xFFFFFF);
-                }
-            }
-        }
+        draw_glyph_scaled(logo[i], logo_x + i * 20, logo_y, 2, 3, 0xFFFFFF);
     }
     
     draw_rect(center_x - 150, logo_y + 50, 300, 2, 0x444444);
@@ -240,10 +357,9 @@ void draw_modern_boot_menu() {
 }
 
 bool check_boot_menu_input() {
-    uint8_t status = inb(0x64);
-    if(status & 0x01) {
-        uint8_t scancode = inb(0x60);
-        
+    input_poll_controller();
+    uint8_t scancode;
+    if(input_read_scancode(&scancode)) {
         if(scancode == 0x48) {
             if(boot_menu_selection > 0) {
                 boot_menu_selection--;
@@ -263,15 +379,15 @@ bool check_boot_menu_input() {
                 draw_system_info();
                 
                 while(true) {
-                    status = inb(0x64);
-                    if(status & 0x01) {
-                        scancode = inb(0x60);
+                    input_poll_controller();
+                    if(input_read_scancode(&scancode)) {
                         if(scancode == 0x21) {
                             draw_modern_boot_menu();
                             break;
                         }
                     }
-                    for(volatile int d = 0; d < 100000; d++);
+                    gfx_flush();
+                    input_wait();
                 }
             }
         }
@@ -280,9 +396,7 @@ bool check_boot_menu_input() {
 }
 
 void draw_boot_screen() {
-    for(uint64_t i = 0; i < fb_width * fb_height; i++) {
-        fb_ptr[i] = 0x000000;
-    }
+    gfx_clear(0x000000);
     
     const char* logo = "HALDEN";
     int logo_width = strlen(logo) * 16;
@@ -290,13 +404,7 @@ void draw_boot_screen() {
     int logo_y = fb_height / 2 - 40;
     
     for(int i = 0; logo[i]; i++) {
-        for(int dy = 0; dy < 20; dy++) {
-            for(int dx = 0; dx < 15; dx++) {
-                if((font8x8_basic[(int)logo[i]][dy / 2] >> (7 - dx / 2)) & 1) {
-                    put_pixel(logo_x + i * 16 + dx, logo_y + dy, 0x4A9EFF);
-                }
-            }
-        }
+        draw_glyph_scaled(logo[i], logo_x + i * 16, logo_y, 2, 2, 0x4A9EFF);
     }
 }
 
@@ -314,186 +422,237 @@ void update_boot_progress(int progress) {
     }
 }
 
-static int term_x = 0;
-static int term_y = 0;
-static char terminal_buffer[4096];
-static int terminal_buffer_len = 0;
+#define TERM_MAX_COLS 256
+#define TERM_SCROLLBACK 512
+#define TERM_LINE_HEIGHT 10
+#define TERM_FG 0xCCCCCC
+#define TERM_TEXT_BG 0x0f0f1e
+#define APP_PAGE_SCROLL 8
+
+static char term_lines[TERM_SCROLLBACK][TERM_MAX_COLS];
+static uint16_t term_line_len[TERM_SCROLLBACK];
+static int term_total_lines = 1;
+static int term_cursor_col = 0;
+static int term_view_offset = 0;
+static int term_dirty_first = -1;
+static int term_dirty_last = -1;
+static int term_rendered_top = 0;
+static int term_rendered_cols = 0;
+static int term_rendered_rows = 0;
+static bool term_full_redraw = true;
+
+static void get_text_area(int wx, int wy, int ww, int wh, int* x, int* y, int* cols, int* rows) {
+    *x = wx + 10;
+    *y = wy + 40;
+    *cols = (ww - 20) / 8;
+    *rows = (wh - 50) / TERM_LINE_HEIGHT;
+    if(*cols > TERM_MAX_COLS) *cols = TERM_MAX_COLS;
+    if(*cols < 1) *cols = 1;
+    if(*rows < 1) *rows = 1;
+}
 
-void terminal_init() {
-    term_x = 10;
-    term_y = 10;
-    memset(terminal_buffer, 0, 4096);
-    terminal_buffer_len = 0;
+static void get_terminal_viewport(int* x, int* y, int* cols, int* rows) {
+    if(!in_gui_mode) {
+        *x = 10;
+        *y = 10;
+        *cols = ((int)fb_width - 18) / 8;
+        *rows = ((int)fb_height - 20) / TERM_LINE_HEIGHT;
+        if(*cols > TERM_MAX_COLS) *cols = TERM_MAX_COLS;
+        return;
+    }
+    int wx = term_win.maximized ? 0 : term_win.x;
+    int wy = term_win.maximized ? 0 : term_win.y;
+    int ww = term_win.maximized ? (int)fb_width : term_win.w;
+    int wh = term_win.maximized ? (int)fb_height - 50 : term_win.h;
+    get_text_area(wx, wy, ww, wh, x, y, cols, rows);
 }
 
-void terminal_clear() {
-    if(in_gui_mode) {
-        draw_rect(50, 80, 700, 400, 0x1a1a2e);
-        term_x = 60;
-        term_y = 90;
-    } else {
-        for(uint64_t i = 0; i < fb_width * fb_height; i++) fb_ptr[i] = 0x0f0f1e; 
-        term_x = 10;
-        term_y = 10;
+static int terminal_oldest_line() {
+    return term_total_lines > TERM_SCROLLBACK ? term_total_lines - TERM_SCROLLBACK : 0;
+}
+
+static int terminal_view_top(int rows) {
+    int top = term_total_lines > rows ? term_total_lines - rows : 0;
+    top -= term_view_offset;
+    if(top < terminal_oldest_line()) top = terminal_oldest_line();
+    return top;
+}
+
+static void mark_line_dirty(int line) {
+    if(term_dirty_first < 0 || line < term_dirty_first) term_dirty_first = line;
+    if(line > term_dirty_last) term_dirty_last = line;
+}
+
+static void terminal_new_line() {
+    int slot = term_total_lines % TERM_SCROLLBACK;
+    term_line_len[slot] = 0;
+    term_total_lines++;
+    term_cursor_col = 0;
+    mark_line_dirty(term_total_lines - 1);
+}
+
+static void terminal_put_char(char c, int cols) {
+    if(c == '\n') {
+        terminal_new_line();
+        return;
     }
-    memset(terminal_buffer, 0, 4096);
-    terminal_buffer_len = 0;
+    if(term_cursor_col >= cols) terminal_new_line();
+    int slot = (term_total_lines - 1) % TERM_SCROLLBACK;
+    term_lines[slot][term_cursor_col++] = c;
+    term_line_len[slot] = term_cursor_col;
+    mark_line_dirty(term_total_lines - 1);
 }
 
-void terminal_write(const char* str) {
-    int max_x = in_gui_mode ? 740 : (int)fb_width - 8;
-    int max_y = in_gui_mode ? 470 : (int)fb_height - 10;
-    int start_x = in_gui_mode ? 60 : 10;
-    
-    while(*str && terminal_buffer_len < 4095) {
-        terminal_buffer[terminal_buffer_len++] = *str;
-        str++;
+static void draw_terminal_line(int line, int x, int y, int cols) {
+    int slot = line % TERM_SCROLLBACK;
+    int len = term_line_len[slot] < cols ? term_line_len[slot] : cols;
+    for(int i = 0; i < len; i++) draw_char(term_lines[slot][i], x + i * 8, y, TERM_FG);
+}
+
+static void draw_terminal_rows(int x, int y, int cols, int rows, int top, int first_row, int last_row) {
+    if(first_row < 0) first_row = 0;
+    if(last_row >= rows) last_row = rows - 1;
+    for(int row = first_row; row <= last_row; row++) {
+        int line = top + row;
+        if(line >= term_total_lines) break;
+        draw_terminal_line(line, x, y + row * TERM_LINE_HEIGHT, cols);
     }
-    terminal_buffer[terminal_buffer_len] = '\0';
-    
-    term_x = start_x;
-    term_y = in_gui_mode ? 90 : 10;
-    
-    for(int i = 0; i < terminal_buffer_len; i++) {
-        if(terminal_buffer[i] == '\n') {
-            term_x = start_x;
-            term_y += 10;
+}
+
+static void terminal_sync() {
+    int x, y, cols, rows;
+    get_terminal_viewport(&x, &y, &cols, &rows);
+    int top = terminal_view_top(rows);
+    int delta = top - term_rendered_top;
+    int area_w = cols * 8;
+    int area_h = rows * TERM_LINE_HEIGHT;
+    
+    int first_row = term_dirty_first < 0 ? rows : term_dirty_first - top;
+    int last_row = term_dirty_first < 0 ? -1 : term_dirty_last - top;
+    bool full = term_full_redraw || cols != term_rendered_cols || rows != term_rendered_rows;
+    full = full || delta >= rows || -delta >= rows;
+    
+    if(!full && delta) {
+        if(in_gui_mode) {
+            full = !scroll_window_rect(APP_TERMINAL, x, y, area_w, area_h, -delta * TERM_LINE_HEIGHT);
         } else {
-            if(term_x < max_x && term_y < max_y) {
-                draw_char(terminal_buffer[i], term_x, term_y, 0xCCCCCC);
-            }
-            term_x += 8;
-            if(term_x >= max_x) {
-                term_x = start_x;
-                term_y += 10;
-            }
+            gfx_scroll_rect(x, y, area_w, area_h, -delta * TERM_LINE_HEIGHT);
+        }
+        if(delta > 0) {
+            if(rows - delta < first_row) first_row = rows - delta;
+            last_row = rows - 1;
+        } else {
+            first_row = 0;
+            if(-delta - 1 > last_row) last_row = -delta - 1;
         }
     }
-}
-
-void terminal_redraw() {
-    if(!in_gui_mode) return;
-    
-    draw_rect(50, 80, 700, 400, 0x1a1a2e);
+    if(full) {
+        first_row = 0;
+        last_row = rows - 1;
+    }
+    if(first_row < 0) first_row = 0;
+    if(last_row >= rows) last_row = rows - 1;
     
-    int max_x = 740;
-    int max_y = 470;
-    int start_x = 60;
+    term_rendered_top = top;
+    term_rendered_cols = cols;
+    term_rendered_rows = rows;
+    term_full_redraw = false;
+    term_dirty_first = -1;
+    term_dirty_last = -1;
     
-    term_x = start_x;
-    term_y = 90;
+    if(first_row > last_row && !delta) return;
     
-    for(int i = 0; i < terminal_buffer_len; i++) {
-        if(terminal_buffer[i] == '\n') {
-            term_x = start_x;
-            term_y += 10;
-        } else {
-            if(term_x < max_x && term_y < max_y) {
-                draw_char(terminal_buffer[i], term_x, term_y, 0xCCCCCC);
-            }
-            term_x += 8;
-            if(term_x >= max_x) {
-                term_x = start_x;
-                term_y += 10;
-            }
-        }
+    int strip_y = y + first_row * TERM_LINE_HEIGHT;
+    int strip_h = (last_row - first_row + 1) * TERM_LINE_HEIGHT;
+    if(in_gui_mode) {
+        if(first_row <= last_row) invalidate_window_rect(APP_TERMINAL, x, strip_y, area_w, strip_h);
+        if(delta && !full) refresh_region(x, y, area_w, area_h);
+        else refresh_region(x, strip_y, area_w, strip_h);
+    } else if(first_row <= last_row) {
+        draw_rect(x, strip_y, area_w, strip_h, TERM_TEXT_BG);
+        draw_terminal_rows(x, y, cols, rows, top, first_row, last_row);
     }
 }
 
-uint32_t cursor_saved_pixels[16 * 11];
-int cursor_saved_x = -1;
-int cursor_saved_y = -1;
-bool cursor_saved = false;
+void terminal_init() {
+    term_total_lines = 1;
+    term_line_len[0] = 0;
+    term_cursor_col = 0;
+    term_view_offset = 0;
+    term_dirty_first = -1;
+    term_dirty_last = -1;
+    term_rendered_top = 0;
+    term_full_redraw = true;
+}
 
-void save_cursor_area(int x, int y) {
-    if(x < 0 || y < 0 || x >= (int)fb_width - 11 || y >= (int)fb_height - 16) return;
-    
-    cursor_saved_x = x;
-    cursor_saved_y = y;
-    cursor_saved = true;
-    
-    int idx = 0;
-    for(int dy = 0; dy < 16; dy++) {
-        for(int dx = 0; dx < 11; dx++) {
-            int px = x + dx;
-            int py = y + dy;
-            
-            if(px < 0 || px >= (int)fb_width || py < 0 || py >= (int)fb_height) {
-                cursor_saved_pixels[idx++] = 0x0f0f1e;
-            } else {
-                cursor_saved_pixels[idx++] = fb_ptr[py * (fb_pitch / 4) + px];
-            }
-        }
+void terminal_clear() {
+    terminal_init();
+    if(in_gui_mode) {
+        terminal_sync();
+    } else {
+        gfx_clear(TERM_TEXT_BG);
+        term_full_redraw = false;
     }
 }
 
-void restore_cursor_area() {
-    if(!cursor_saved) return;
-    if(cursor_saved_x < 0 || cursor_saved_y < 0) return;
-    
-    int idx = 0;
-    for(int dy = 0; dy < 16; dy++) {
-        for(int dx = 0; dx < 11; dx++) {
-            int px = cursor_saved_x + dx;
-            int py = cursor_saved_y + dy;
-            
-            if(px >= 0 && px < (int)fb_width && py >= 0 && py < (int)fb_height) {
-                fb_ptr[py * (fb_pitch / 4) + px] = cursor_saved_pixels[idx];
-            }
-            idx++;
-        }
+void terminal_write(const char* str) {
+    int x, y, cols, rows;
+    get_terminal_viewport(&x, &y, &cols, &rows);
+    for(; *str; str++) terminal_put_char(*str, cols);
+    term_view_offset = 0;
+    terminal_sync();
+}
+
+static void terminal_backspace() {
+    if(term_cursor_col == 0) {
+        if(term_total_lines - 1 <= terminal_oldest_line()) return;
+        term_total_lines--;
+        term_cursor_col = term_line_len[(term_total_lines - 1) % TERM_SCROLLBACK];
+        term_full_redraw = true;
     }
-    
-    cursor_saved = false;
+    if(term_cursor_col == 0) return;
+    term_cursor_col--;
+    term_line_len[(term_total_lines - 1) % TERM_SCROLLBACK] = term_cursor_col;
+    mark_line_dirty(term_total_lines - 1);
+    term_view_offset = 0;
+    terminal_sync();
 }
 
-void draw_cursor(int x, int y) {
-    if(x < 0 || y < 0 || x >= (int)fb_width - 11 || y >= (int)fb_height - 16) return;
-    
-    const int cursor_data[16] = {
-        0b1100000000000000,
-        0b1110000000000000,
-        0b1111000000000000,
-        0b1111100000000000,
-        0b1111110000000000,
-        0b1111111000000000,
-        0b1111111100000000,
-        0b1111111110000000,
-        0b1111111111000000,
-        0b1111111000000000,
-        0b1110110000000000,
-        0b1100011000000000,
-        0b1000001100000000,
-        0b0000001100000000,
-        0b0000000110000000,
-        0b0000000000000000
-    };
-    
-    restore_cursor_area();
-    save_cursor_area(x, y);
-    
-    for(int dy = 0; dy < 16; dy++) {
-        for(int dx = 0; dx < 11; dx++) {
-            int px = x + dx;
-            int py = y + dy;
-            
-            if(px < 0 || px >= (int)fb_width || py < 0 || py >= (int)fb_height) continue;
-            
-            if((cursor_data[dy] >> (15 - dx)) & 1) {
-                if(dx == 0 || dy == 0) {
-                    put_pixel(px, py, 0x000000);
-                } else {
-                    put_pixel(px, py, 0xFFFFFF);
-                }
-            }
-        }
+static void terminal_scroll_view(int lines) {
+    int x, y, cols, rows;
+    get_terminal_viewport(&x, &y, &cols, &rows);
+    int max_offset = (term_total_lines > rows ? term_total_lines - rows : 0) - terminal_oldest_line();
+    term_view_offset += lines;
+    if(term_view_offset > max_offset) term_view_offset = max_offset;
+    if(term_view_offset < 0) term_view_offset = 0;
+    terminal_sync();
+}
+
+void terminal_redraw(int x, int y, int w, int h) {
+    int tx, ty, cols, rows;
+    get_text_area(x, y, w, h, &tx, &ty, &cols, &rows);
+    int top = terminal_view_top(rows);
+    int first_row = (gfx_clip.y0 - ty) / TERM_LINE_HEIGHT;
+    int last_row = (gfx_clip.y1 - 1 - ty) / TERM_LINE_HEIGHT;
+    if(gfx_clip.y1 - 1 < ty) return;
+    if(first_row <= 0 && last_row >= rows - 1) {
+        term_rendered_top = top;
+        term_rendered_cols = cols;
+        term_rendered_rows = rows;
     }
+    draw_terminal_rows(tx, ty, cols, rows, top, first_row, last_row);
+}
+
+void restore_cursor_area() {
+    gfx_lift_cursor();
+}
+
+void draw_cursor(int x, int y) {
+    gfx_set_cursor(x, y);
 }
 
 char kbd_buffer[128];
 int kbd_idx = 0;
-static uint8_t mouse_cycle = 0;
-static int8_t mouse_byte[3];
 static bool mouse_left_btn = false;
 static bool mouse_right_btn = false;
 static bool shift_pressed = false;
@@ -507,6 +666,7 @@ enum KeyboardLayout {
 KeyboardLayout current_layout = LAYOUT_QWERTY;
 
 extern void handle_app_keyboard(char c);
+extern void handle_app_scroll(int delta);
 extern bool is_app_focused();
 extern void update_window_drag(int mouse_x, int mouse_y);
 extern void stop_window_drag();
@@ -559,140 +719,135 @@ char scancode_to_ascii(uint8_t sc, bool shift) {
     return scancode_to_ascii_qwerty(sc, shift);
 }
 
-void mouse_handler() {
-    if(!boot_complete) return;
+static void apply_mouse_motion(int dx, int dy, bool left_btn) {
+    int new_x = mouse_x + dx;
+    int new_y = mouse_y + dy;
     
-    uint8_t status = inb(0x64);
+    if(new_x < 0) new_x = 0;
+    if(new_x >= (int)fb_width - 11) new_x = (int)fb_width - 11;
+    if(new_y < 0) new_y = 0;
+    if(new_y >= (int)fb_height - 16) new_y = (int)fb_height - 16;
     
-    if(status & 0x20) {
-        uint8_t b = inb(0x60);
+    if(mouse_x != new_x || mouse_y != new_y) {
+        mouse_x = new_x;
+        mouse_y = new_y;
         
-        if(mouse_cycle == 0) {
-            if(!(b & 0x08)) return;
-            mouse_byte[0] = b;
-            mouse_cycle = 1;
-        } else if(mouse_cycle == 1) {
-            mouse_byte[1] = b;
-            mouse_cycle = 2;
-        } else if(mouse_cycle == 2) {
-            mouse_byte[2] = b;
-            mouse_cycle = 0;
-            
-            if(in_gui_mode) {
-                int8_t dx = mouse_byte[1];
-                int8_t dy = -mouse_byte[2];
-                
-                if(dx < -50) dx = -50;
-                if(dx > 50) dx = 50;
-                if(dy < -50) dy = -50;
-                if(dy > 50) dy = 50;
-                
-                int new_x = mouse_x + dx;
-                int new_y = mouse_y + dy;
-                
-                if(new_x < 0) new_x = 0;
-                if(new_x >= (int)fb_width - 11) new_x = (int)fb_width - 11;
-                if(new_y < 0) new_y = 0;
-                if(new_y >= (int)fb_height - 16) new_y = (int)fb_height - 16;
-                
-                bool left_btn = mouse_byte[0] & 0x01;
-                bool right_btn = mouse_byte[0] & 0x02;
-                
-                if(mouse_x != new_x || mouse_y != new_y) {
-                    mouse_x = new_x;
-                    mouse_y = new_y;
-                    
-                    if(left_btn && mouse_left_btn) {
-                        update_window_drag(mouse_x, mouse_y);
-                    } else {
-                        draw_cursor(mouse_x, mouse_y);
-                    }
-                }
-                
-                if(left_btn && !mouse_left_btn) {
-                    handle_gui_click(mouse_x, mouse_y, false);
-                }
-                if(!left_btn && mouse_left_btn) {
-                    stop_window_drag();
-                }
-                if(right_btn && !mouse_right_btn) {
-                    handle_gui_click(mouse_x, mouse_y, true);
-                }
-                
-                mouse_left_btn = left_btn;
-                mouse_right_btn = right_btn;
-            }
+        if(left_btn && mouse_left_btn) {
+            update_window_drag(mouse_x, mouse_y);
+        } else {
+            draw_cursor(mouse_x, mouse_y);
         }
-    } else {
-        if(status & 0x01) {
-            uint8_t b = inb(0x60);
-            
-            if(b == 0x2A || b == 0x36) {
-                shift_pressed = true;
-            } else if(b == 0xAA || b == 0xB6) {
-                shift_pressed = false;
-            } else if(b == 0x1D) {
-                ctrl_pressed = true;
-            } else if(b == 0x9D) {
-                ctrl_pressed = false;
+    }
+}
+
+static void apply_mouse_buttons(bool left_btn, bool right_btn) {
+    if(left_btn && !mouse_left_btn) {
+        handle_gui_click(mouse_x, mouse_y, false);
+    }
+    if(!left_btn && mouse_left_btn) {
+        stop_window_drag();
+    }
+    if(right_btn && !mouse_right_btn) {
+        handle_gui_click(mouse_x, mouse_y, true);
+    }
+    
+    mouse_left_btn = left_btn;
+    mouse_right_btn = right_btn;
+}
+
+static void handle_scancode(uint8_t b) {
+    if(b == 0x2A || b == 0x36) {
+        shift_pressed = true;
+    } else if(b == 0xAA || b == 0xB6) {
+        shift_pressed = false;
+    } else if(b == 0x1D) {
+        ctrl_pressed = true;
+    } else if(b == 0x9D) {
+        ctrl_pressed = false;
+    }
+    
+    if(b < 0x80) {
+        char c = scancode_to_ascii(b, shift_pressed);
+        
+        if(in_gui_mode && is_app_focused()) {
+            if(b == 0x49 || b == 0x51) handle_app_scroll(b == 0x49 ? APP_PAGE_SCROLL : -APP_PAGE_SCROLL);
+            else handle_app_keyboard(c);
+            return;
+        }
+        
+        if(b == 0x49 || b == 0x51) {
+            int x, y, cols, rows;
+            get_terminal_viewport(&x, &y, &cols, &rows);
+            terminal_scroll_view(b == 0x49 ? rows / 2 : -(rows / 2));
+            return;
+        }
+        
+        if(c == '\b') {
+            if(kbd_idx > 0) {
+                kbd_idx--;
+                kbd_buffer[kbd_idx] = 0;
+                terminal_backspace();
             }
+        } else if(c == '\n') {
+            terminal_write("\n");
+            process_command(kbd_buffer);
+            kbd_idx = 0;
+            memset(kbd_buffer, 0, 128);
             
-            if(b < 0x80) {
-                char c = scancode_to_ascii(b, shift_pressed);
-                
-                if(in_gui_mode && is_app_focused()) {
-                    handle_app_keyboard(c);
-                    return;
-                }
-                
-                if(c == '\b') {
-                    if(kbd_idx > 0) {
-                        kbd_idx--;
-                        kbd_buffer[kbd_idx] = 0;
-                        if(terminal_buffer_len > 0) terminal_buffer_len--;
-                        terminal_buffer[terminal_buffer_len] = 0;
-                        
-                        if(in_gui_mode) {
-                            draw_rect(50, 80, 700, 400, 0x1a1a2e);
-                        }
-                        
-                        term_x = in_gui_mode ? 60 : 10;
-                        term_y = in_gui_mode ? 90 : 10;
-                        
-                        for(int i = 0; i < terminal_buffer_len; i++) {
-                            if(terminal_buffer[i] == '\n') {
-                                term_x = in_gui_mode ? 60 : 10;
-                                term_y += 10;
-                            } else {
-                                draw_char(terminal_buffer[i], term_x, term_y, 0xCCCCCC);
-                                term_x += 8;
-                            }
-                        }
-                    }
-                } else if(c == '\n') {
-                    if(terminal_buffer_len < 4095) {
-                        terminal_buffer[terminal_buffer_len++] = '\n';
-                        terminal_buffer[terminal_buffer_len] = '\0';
-                    }
-                    process_command(kbd_buffer);
-                    kbd_idx = 0;
-                    memset(kbd_buffer, 0, 128);
-                    
-                    terminal_write("root@halden:");
-                    terminal_write(current_directory);
-                    terminal_write("# ");
-                } else if(c) {
-                    if(kbd_idx < 127) {
-                        kbd_buffer[kbd_idx++] = c;
-                        char tmp[2] = {c, 0};
-                        terminal_write(tmp);
-                    }
-                }
+            terminal_write("root@halden:");
+            terminal_write(current_directory);
+            terminal_write("# ");
+        } else if(c) {
+            if(kbd_idx < 127) {
+                kbd_buffer[kbd_idx++] = c;
+                char tmp[2] = {c, 0};
+                terminal_write(tmp);
             }
         }
     }
 }
 
+void mouse_handler() {
+    if(!boot_complete) return;
+    
+    input_poll_controller();
+    
+    MousePacket packet;
+    int pending_dx = 0;
+    int pending_dy = 0;
+    while(input_read_mouse(&packet)) {
+        if(!in_gui_mode) continue;
+        
+        int dx = packet.dx;
+        int dy = -packet.dy;
+        
+        if(dx < -50) dx = -50;
+        if(dx > 50) dx = 50;
+        if(dy < -50) dy = -50;
+        if(dy > 50) dy = 50;
+        
+        pending_dx += dx;
+        pending_dy += dy;
+        
+        bool left_btn = packet.buttons & 0x01;
+        bool right_btn = packet.buttons & 0x02;
+        if(left_btn != mouse_left_btn || right_btn != mouse_right_btn) {
+            apply_mouse_motion(pending_dx, pending_dy, left_btn);
+            pending_dx = 0;
+            pending_dy = 0;
+            apply_mouse_buttons(left_btn, right_btn);
+        }
+    }
+    if(pending_dx || pending_dy) {
+        apply_mouse_motion(pending_dx, pending_dy, mouse_left_btn);
+    }
+    
+    uint8_t scancode;
+    while(input_read_scancode(&scancode)) {
+        handle_scancode(scancode);
+    }
+}
+
 static void mouse_wait(uint8_t type) {
     uint32_t timeout = 100000;
     if(type == 0) {
@@ -721,7 +876,7 @@ void mouse_init() {
     mouse_wait(1);
     outb(0x64, 0x20);
     mouse_wait(0);
-    status = (inb(0x60) | 2);
+    status = (inb(0x60) | 3);
     mouse_wait(1);
     outb(0x64, 0x60);
     mouse_wait(1);
@@ -733,7 +888,7 @@ void mouse_init() {
 }
 
 void draw_system_info() {
-    for(uint64_t i = 0; i < fb_width * fb_height; i++) fb_ptr[i] = 0x0a0a0a;
+    gfx_clear(0x0a0a0a);
     
     int start_y = 60;
     int start_x = 100;
@@ -0,0 +1,177 @@
+#include <stdint.h>
+#include <stddef.h>
+
+struct InterruptFrame;
+typedef InterruptFrame* (*InterruptHandler)(InterruptFrame* frame);
+
+extern void register_interrupt_handler(uint8_t vector, InterruptHandler handler);
+extern bool lapic_init();
+extern void lapic_timer_stop();
+extern void lapic_timer_start(uint8_t vector, uint32_t count, bool periodic);
+extern void lapic_timer_deadline_mode(uint8_t vector);
+extern uint32_t lapic_timer_current();
+extern uint32_t smp_current_cpu();
+extern InterruptFrame* sched_tick(InterruptFrame* frame);
+
+#define TIMER_VECTOR 0x30
+#define NS_PER_SEC 1000000000ULL
+#define PIT_FREQUENCY 1193182
+#define CALIBRATE_MS 50
+#define MSR_TSC_DEADLINE 0x6E0
+
+uint64_t tsc_hz = 0;
+uint64_t lapic_timer_hz = 0;
+uint64_t timer_ticks = 0;
+bool timer_ready = false;
+bool timer_has_tsc_deadline = false;
+bool timer_has_invariant_tsc = false;
+
+static uint64_t tsc_boot = 0;
+static uint64_t ns_per_cycle_mult = 0;
+static uint64_t cycles_per_ns_mult = 0;
+static uint64_t lapic_per_ns_mult = 0;
+
+static inline void outb(uint16_t port, uint8_t val) {
+    __asm__ volatile("outb %0, %1" : : "a"(val), "Nd"(port));
+}
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t ret;
+    __asm__ volatile("inb %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ volatile("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+static inline void cpuid(uint32_t leaf, uint32_t* eax, uint32_t* ebx, uint32_t* ecx, uint32_t* edx) {
+    __asm__ volatile("cpuid" : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx) : "a"(leaf), "c"(0));
+}
+
+uint64_t rdtsc() {
+    uint32_t low, high;
+    __asm__ volatile("rdtsc" : "=a"(low), "=d"(high));
+    return ((uint64_t)high << 32) | low;
+}
+
+uint64_t tsc_to_ns(uint64_t cycles) {
+    return ((unsigned __int128)cycles * ns_per_cycle_mult) >> 32;
+}
+
+uint64_t ns_to_tsc(uint64_t ns) {
+    return ((unsigned __int128)ns * cycles_per_ns_mult) >> 24;
+}
+
+uint64_t clock_ns() {
+    return tsc_to_ns(rdtsc() - tsc_boot);
+}
+
+uint64_t clock_tsc_at(uint64_t ns) {
+    return tsc_boot + ns_to_tsc(ns);
+}
+
+void timer_record_boot() {
+    tsc_boot = rdtsc();
+}
+
+void udelay(uint64_t us) {
+    if(!tsc_hz) {
+        for(uint64_t i = 0; i < us; i++) inb(0x80);
+        return;
+    }
+    uint64_t target = rdtsc() + ns_to_tsc(us * 1000);
+    while(rdtsc() < target) __asm__ volatile("pause");
+}
+
+static void pit_calibrate(uint64_t* tsc_delta, uint32_t* lapic_delta) {
+    uint32_t latch = PIT_FREQUENCY * CALIBRATE_MS / 1000;
+
+    outb(0x61, (inb(0x61) & ~0x02) | 0x01);
+    outb(0x43, 0xB0);
+    outb(0x42, latch & 0xFF);
+    outb(0x42, latch >> 8);
+
+    lapic_timer_start(TIMER_VECTOR, 0xFFFFFFFF, false);
+    uint64_t tsc_start = rdtsc();
+    uint32_t lapic_start = lapic_timer_current();
+
+    while(!(inb(0x61) & 0x20)) __asm__ volatile("pause");
+
+    uint64_t tsc_end = rdtsc();
+    uint32_t lapic_end = lapic_timer_current();
+    lapic_timer_stop();
+
+    *tsc_delta = tsc_end - tsc_start;
+    *lapic_delta = lapic_start - lapic_end;
+}
+
+uint64_t timer_uptime_seconds() {
+    return clock_ns() / NS_PER_SEC;
+}
+
+static InterruptFrame* timer_interrupt(InterruptFrame* frame) {
+    if(smp_current_cpu() == 0) {
+        timer_ticks++;
+    }
+    return sched_tick(frame);
+}
+
+void timer_stop() {
+    if(!timer_ready) return;
+    if(timer_has_tsc_deadline) wrmsr(MSR_TSC_DEADLINE, 0);
+    else lapic_timer_stop();
+}
+
+void timer_arm_oneshot(uint64_t deadline_ns) {
+    if(!timer_ready) return;
+    if(timer_has_tsc_deadline) {
+        lapic_timer_deadline_mode(TIMER_VECTOR);
+        __asm__ volatile("mfence" ::: "memory");
+        wrmsr(MSR_TSC_DEADLINE, clock_tsc_at(deadline_ns));
+        return;
+    }
+
+    uint64_t now = clock_ns();
+    uint64_t delta = deadline_ns > now ? deadline_ns - now : 0;
+    uint64_t count = ((unsigned __int128)delta * lapic_per_ns_mult) >> 32;
+    if(count == 0) count = 1;
+    if(count > 0xFFFFFFFF) count = 0xFFFFFFFF;
+    lapic_timer_start(TIMER_VECTOR, count, false);
+}
+
+bool timer_init() {
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    timer_has_tsc_deadline = (ecx >> 24) & 1;
+
+    cpuid(0x80000000, &eax, &ebx, &ecx, &edx);
+    if(eax >= 0x80000007) {
+        cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+        timer_has_invariant_tsc = (edx >> 8) & 1;
+    }
+
+    if(!lapic_init()) return false;
+
+    uint64_t tsc_delta;
+    uint32_t lapic_delta;
+    pit_calibrate(&tsc_delta, &lapic_delta);
+    if(tsc_delta == 0 || lapic_delta == 0) return false;
+
+    tsc_hz = tsc_delta * 1000 / CALIBRATE_MS;
+    lapic_timer_hz = (uint64_t)lapic_delta * 1000 / CALIBRATE_MS;
+
+    cpuid(0, &eax, &ebx, &ecx, &edx);
+    if(eax >= 0x15) {
+        cpuid(0x15, &eax, &ebx, &ecx, &edx);
+        if(eax && ebx && ecx) tsc_hz = (uint64_t)ecx * ebx / eax;
+    }
+
+    ns_per_cycle_mult = (NS_PER_SEC << 32) / tsc_hz;
+    cycles_per_ns_mult = (tsc_hz << 24) / NS_PER_SEC;
+    lapic_per_ns_mult = (lapic_timer_hz << 32) / NS_PER_SEC;
+
+    register_interrupt_handler(TIMER_VECTOR, timer_interrupt);
+    timer_ready = true;
+    return true;
+}
@@ -1,26 +1,252 @@
 #include <stdint.h>
 #include <stddef.h>
 
-void* memcpy(void *dest, const void *src, size_t n) {
-    uint8_t *p = (uint8_t *)dest;
-    const uint8_t *q = (const uint8_t *)src;
-    for (size_t i = 0; i < n; i++) p[i] = q[i];
+extern bool fpu_usable();
+extern bool fpu_ready;
+extern bool fpu_has_avx;
+extern void* memcpy_sse2(void* dest, const void* src, size_t n);
+extern void* memset_sse2(void* dest, int c, size_t n);
+extern void* memcpy_avx(void* dest, const void* src, size_t n);
+extern void* memset_avx(void* dest, int c, size_t n);
+extern size_t strlen_sse2(const char* str);
+extern void* memchr_sse2(const void* s, int c, size_t n);
+
+#define MEM_SMALL_SIZE 64
+#define MEM_IMPL_WORDS 0
+#define MEM_IMPL_ERMS 1
+#define MEM_IMPL_SSE2 2
+#define MEM_IMPL_AVX 3
+
+#define WORD_ONES 0x0101010101010101ULL
+#define WORD_HIGHS 0x8080808080808080ULL
+#define WORD_HAS_ZERO(w) (((w) - WORD_ONES) & ~(w) & WORD_HIGHS)
+
+typedef uint64_t unaligned_u64 __attribute__((may_alias, aligned(1)));
+typedef uint64_t aliased_u64 __attribute__((may_alias));
+
+struct MemImpl {
+    const char* name;
+    void* (*copy)(void* dest, const void* src, size_t n);
+    void* (*set)(void* dest, int c, size_t n);
+    bool simd;
+    bool available;
+};
+
+static void* memcpy_words(void* dest, const void* src, size_t n) {
+    void* d = dest;
+    const void* s = src;
+    size_t words = n >> 3;
+    size_t bytes = n & 7;
+    __asm__ volatile("rep movsq" : "+D"(d), "+S"(s), "+c"(words) : : "memory");
+    __asm__ volatile("rep movsb" : "+D"(d), "+S"(s), "+c"(bytes) : : "memory");
+    return dest;
+}
+
+static void* memset_words(void* dest, int c, size_t n) {
+    void* d = dest;
+    uint64_t pattern = 0x0101010101010101ULL * (uint8_t)c;
+    size_t words = n >> 3;
+    size_t bytes = n & 7;
+    __asm__ volatile("rep stosq" : "+D"(d), "+c"(words) : "a"(pattern) : "memory");
+    __asm__ volatile("rep stosb" : "+D"(d), "+c"(bytes) : "a"(pattern) : "memory");
+    return dest;
+}
+
+static void* memcpy_erms(void* dest, const void* src, size_t n) {
+    void* d = dest;
+    __asm__ volatile("rep movsb" : "+D"(d), "+S"(src), "+c"(n) : : "memory");
+    return dest;
+}
+
+static void* memset_erms(void* dest, int c, size_t n) {
+    void* d = dest;
+    __asm__ volatile("rep stosb" : "+D"(d), "+c"(n) : "a"(c) : "memory");
     return dest;
 }
 
+static MemImpl mem_impls[] = {
+    {"words", memcpy_words, memset_words, false, true},
+    {"erms", memcpy_erms, memset_erms, false, false},
+    {"sse2", memcpy_sse2, memset_sse2, true, false},
+    {"avx", memcpy_avx, memset_avx, true, false},
+};
+#define MEM_IMPL_COUNT (int)(sizeof(mem_impls) / sizeof(mem_impls[0]))
+
+static MemImpl* mem_active = &mem_impls[MEM_IMPL_WORDS];
+static bool mem_fsrm = false;
+static bool mem_simd = false;
+
+static inline MemImpl* mem_impl_for_context(MemImpl* impl) {
+    if(impl->simd && !fpu_usable()) return &mem_impls[MEM_IMPL_WORDS];
+    return impl;
+}
+
+static inline void copy_small(uint8_t* d, const uint8_t* s, size_t n) {
+    if(n >= 8) {
+        uint64_t tail = *(const unaligned_u64*)(s + n - 8);
+        for(size_t i = 0; i + 8 < n; i += 8) *(unaligned_u64*)(d + i) = *(const unaligned_u64*)(s + i);
+        *(unaligned_u64*)(d + n - 8) = tail;
+        return;
+    }
+    for(size_t i = 0; i < n; i++) d[i] = s[i];
+}
+
+void* memcpy(void *dest, const void *src, size_t n) {
+    if(n < MEM_SMALL_SIZE && !mem_fsrm) {
+        copy_small((uint8_t*)dest, (const uint8_t*)src, n);
+        return dest;
+    }
+    return mem_impl_for_context(mem_active)->copy(dest, src, n);
+}
+
 void* memset(void *s, int c, size_t n) {
-    uint8_t *p = (uint8_t *)s;
-    for (size_t i = 0; i < n; i++) p[i] = (uint8_t)c;
-    return s;
+    if(n < MEM_SMALL_SIZE) {
+        uint8_t* p = (uint8_t*)s;
+        if(n >= 8) {
+            uint64_t pattern = 0x0101010101010101ULL * (uint8_t)c;
+            for(size_t i = 0; i + 8 < n; i += 8) *(unaligned_u64*)(p + i) = pattern;
+            *(unaligned_u64*)(p + n - 8) = pattern;
+            return s;
+        }
+        for(size_t i = 0; i < n; i++) p[i] = (uint8_t)c;
+        return s;
+    }
+    return mem_impl_for_context(mem_active)->set(s, c, n);
+}
+
+void* memmove(void *dest, const void *src, size_t n) {
+    uint8_t* d = (uint8_t*)dest;
+    const uint8_t* s = (const uint8_t*)src;
+    if(d == s || n == 0) return dest;
+    if(d + n <= s || s + n <= d) return memcpy(dest, src, n);
+
+    if(d < s) {
+        __asm__ volatile("rep movsb" : "+D"(d), "+S"(s), "+c"(n) : : "memory");
+        return dest;
+    }
+    while(n & 7) {
+        n--;
+        d[n] = s[n];
+    }
+    while(n) {
+        n -= 8;
+        *(unaligned_u64*)(d + n) = *(const unaligned_u64*)(s + n);
+    }
+    return dest;
+}
+
+void mem_init() {
+    uint32_t eax, ebx, ecx, edx;
+    __asm__ volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(0), "c"(0));
+    if(eax >= 7) {
+        __asm__ volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(7), "c"(0));
+        mem_impls[MEM_IMPL_ERMS].available = (ebx >> 9) & 1;
+        mem_fsrm = (edx >> 4) & 1;
+    }
+    mem_impls[MEM_IMPL_SSE2].available = fpu_ready;
+    mem_impls[MEM_IMPL_AVX].available = mem_impls[MEM_IMPL_SSE2].available && fpu_has_avx;
+
+    if(mem_impls[MEM_IMPL_ERMS].available) mem_active = &mem_impls[MEM_IMPL_ERMS];
+    else if(mem_impls[MEM_IMPL_AVX].available) mem_active = &mem_impls[MEM_IMPL_AVX];
+    else if(mem_impls[MEM_IMPL_SSE2].available) mem_active = &mem_impls[MEM_IMPL_SSE2];
+    mem_fsrm = mem_fsrm && mem_active == &mem_impls[MEM_IMPL_ERMS];
+    mem_simd = mem_impls[MEM_IMPL_SSE2].available;
+}
+
+int mem_get_impl_count() {
+    return MEM_IMPL_COUNT;
+}
+
+bool mem_get_impl_info(int index, const char** name_out, bool* available_out, bool* active_out) {
+    if(index < 0 || index >= MEM_IMPL_COUNT) return false;
+    *name_out = mem_impls[index].name;
+    *available_out = mem_impls[index].available;
+    *active_out = mem_active == &mem_impls[index];
+    return true;
+}
+
+void* mem_impl_copy(int index, void* dest, const void* src, size_t n) {
+    if(index < 0 || index >= MEM_IMPL_COUNT || !mem_impls[index].available) return nullptr;
+    return mem_impl_for_context(&mem_impls[index])->copy(dest, src, n);
+}
+
+void* mem_impl_set(int index, void* dest, int c, size_t n) {
+    if(index < 0 || index >= MEM_IMPL_COUNT || !mem_impls[index].available) return nullptr;
+    return mem_impl_for_context(&mem_impls[index])->set(dest, c, n);
+}
+
+int memcmp(const void *s1, const void *s2, size_t n) {
+    const uint8_t* a = (const uint8_t*)s1;
+    const uint8_t* b = (const uint8_t*)s2;
+    while(n >= 8 && *(const unaligned_u64*)a == *(const unaligned_u64*)b) {
+        a += 8; b += 8; n -= 8;
+    }
+    for(; n; n--, a++, b++) {
+        if(*a != *b) return *a - *b;
+    }
+    return 0;
+}
+
+void* memchr(const void *s, int c, size_t n) {
+    if(mem_simd && n >= 16 && fpu_usable()) return memchr_sse2(s, c, n);
+    const uint8_t* p = (const uint8_t*)s;
+    uint64_t pattern = WORD_ONES * (uint8_t)c;
+    while(n >= 8) {
+        uint64_t w = *(const unaligned_u64*)p ^ pattern;
+        if(WORD_HAS_ZERO(w)) break;
+        p += 8; n -= 8;
+    }
+    for(; n; n--, p++) {
+        if(*p == (uint8_t)c) return (void*)p;
+    }
+    return nullptr;
+}
+
+void* memmem(const void *haystack, size_t haystack_len, const void *needle, size_t needle_len) {
+    if(needle_len == 0) return (void*)haystack;
+    if(needle_len > haystack_len) return nullptr;
+    const uint8_t* h = (const uint8_t*)haystack;
+    const uint8_t* n = (const uint8_t*)needle;
+    const uint8_t* last = h + haystack_len - needle_len;
+    uint8_t first = n[0];
+    uint8_t tail = n[needle_len - 1];
+    while(h <= last) {
+        h = (const uint8_t*)memchr(h, first, last - h + 1);
+        if(!h) return nullptr;
+        if(h[needle_len - 1] == tail && memcmp(h + 1, n + 1, needle_len - 1) == 0) return (void*)h;
+        h++;
+    }
+    return nullptr;
 }
 
 size_t strlen(const char *str) {
-    size_t len = 0;
-    while (str[len]) len++;
-    return len;
+    if(mem_simd && fpu_usable()) return strlen_sse2(str);
+    const char* p = str;
+    while((uintptr_t)p & 7) {
+        if(!*p) return p - str;
+        p++;
+    }
+    const aliased_u64* w = (const aliased_u64*)p;
+    while(!WORD_HAS_ZERO(*w)) w++;
+    p = (const char*)w;
+    while(*p) p++;
+    return p - str;
 }
 
 int strcmp(const char *s1, const char *s2) {
+    if((((uintptr_t)s1 ^ (uintptr_t)s2) & 7) == 0) {
+        while((uintptr_t)s1 & 7) {
+            if(!*s1 || *s1 != *s2) return *(const unsigned char *)s1 - *(const unsigned char *)s2;
+            s1++; s2++;
+        }
+        const aliased_u64* a = (const aliased_u64*)s1;
+        const aliased_u64* b = (const aliased_u64*)s2;
+        while(*a == *b && !WORD_HAS_ZERO(*a)) {
+            a++; b++;
+        }
+        s1 = (const char*)a;
+        s2 = (const char*)b;
+    }
     while (*s1 && (*s1 == *s2)) {
         s1++; s2++;
     }